@@ -0,0 +1,57 @@
+//
+// AmoreCampaignMessenger.hh
+//
+// UI commands for decay campaigns (/amore/campaign/).
+// A campaign is a list of segments of (isotope, excitation level, decay rate, events).
+// /amore/campaign/run processes the segments one after another in the same job, so the
+// geometry and the physics tables are built only once. Every segment is a run of its own
+// with its own output file, <output>_<label>.
+//
+#ifndef __AmoreCampaignMessenger_hh__
+#define __AmoreCampaignMessenger_hh__ 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+#include <vector>
+
+class G4UIcommand;
+class G4UIdirectory;
+class AmoreRootNtuple;
+
+class AmoreCampaignMessenger : public G4UImessenger {
+  public:
+    AmoreCampaignMessenger(AmoreRootNtuple *aRecorder);
+    ~AmoreCampaignMessenger();
+
+    void SetNewValue(G4UIcommand *command, G4String newValues);
+    G4String GetCurrentValue(G4UIcommand *command);
+
+  private:
+    struct Segment {
+        G4String fIsotope;
+        G4double fExcitation; // [MeV]
+        G4double fRate; // [Hz]
+        G4int fNEvents;
+        G4String fLabel;
+    };
+
+    G4bool AddSegment(const G4String &aLine);
+    G4bool LoadSegments(const G4String &aFileName);
+    void PrintSegments() const;
+    void RunCampaign();
+
+    AmoreRootNtuple *fRecorder;
+    std::vector<Segment> fSegments;
+    G4String fOutputBaseName;
+
+    G4UIdirectory *fCampaignDir;
+    G4UIcommand *fAddCmd;
+    G4UIcommand *fLoadCmd;
+    G4UIcommand *fOutputCmd;
+    G4UIcommand *fListCmd;
+    G4UIcommand *fClearCmd;
+    G4UIcommand *fRunCmd;
+};
+
+#endif
@@ -0,0 +1,88 @@
+//
+// AmoreCompactStep.hh
+//
+// Compact step records (/ntuple/compactStep). Instead of one TStep with the particle, process
+// and volume names per step, the steps of an event are stored as columns of numbers in the
+// main tree. The particle is given by its PDG code, the process by a dense ID and the volume
+// by its ID in the VolumeTable tree, whose CopyFrom tells which copy number the CopyNo column
+// holds.
+// Ions have their full code 100ZZZAAAI, whose last digit numbers the isomer levels. Geant4
+// gives 9 to every other excited state, so those states take a code of 2000000000 or more made
+// from their name instead, which is the same in every thread and job.
+// The dictionaries from the IDs to the names are written once per file as the trees
+// StepParticles and StepProcesses.
+//
+#ifndef __AmoreCompactStep_hh__
+#define __AmoreCompactStep_hh__ 1
+
+#include "globals.hh"
+
+#include "Rtypes.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class G4ParticleDefinition;
+class G4Step;
+class G4VProcess;
+class TTree;
+class AmoreVolumeTable;
+
+// The step columns of one event
+struct AmoreCompactSteps {
+    std::vector<Int_t> fTrackID;
+    std::vector<Int_t> fParentID;
+    std::vector<Int_t> fStepNo;
+    std::vector<Int_t> fPDG;
+    std::vector<Short_t> fProcessID;
+    std::vector<Int_t> fVolumeID;
+    std::vector<Int_t> fCopyNo;
+    std::vector<Float_t> fKineticEnergy;
+    std::vector<Float_t> fEnergyDeposit;
+    std::vector<Float_t> fX;
+    std::vector<Float_t> fY;
+    std::vector<Float_t> fZ;
+    std::vector<Double_t> fGlobalTime; // decay times exceed the precision of Float_t
+    std::vector<Float_t> fLocalTime;
+
+    void Branch(TTree *aTree);
+    void Clear();
+};
+
+// The IDs of one thread. Processes are numbered in a fixed order given by the physics list,
+// so every thread and every process of a job gives the same IDs.
+class AmoreStepDictionary {
+  public:
+    AmoreStepDictionary(AmoreVolumeTable *aVolumeTable)
+        : fVolumeTable(aVolumeTable), fBuilt(false){};
+    ~AmoreStepDictionary(){};
+
+    void Build();
+    inline G4bool IsBuilt() const { return fBuilt; }
+
+    G4int GetPDGCode(const G4ParticleDefinition *aParticle);
+    G4int GetProcessID(const G4VProcess *aProcess);
+
+    void Fill(const G4Step *aStep, AmoreCompactSteps &aSteps);
+
+    // Writes the dictionaries to the current directory
+    void Write() const;
+    // Codes of the excited ions without an isomer level
+    enum { kExcitedIonBase = 2000000000, kExcitedIonRange = 100000000 };
+
+    // Merged files have the dictionaries of every part. Keeps one entry per ID.
+    static G4bool Deduplicate(const G4String &aFileName);
+
+  private:
+    AmoreVolumeTable *fVolumeTable;
+    G4bool fBuilt;
+
+    std::map<G4String, G4int> fProcessIDsByName;
+    std::unordered_map<const G4VProcess *, G4int> fProcessIDs;
+
+    std::unordered_map<const G4ParticleDefinition *, G4int> fPDGCodes;
+    std::map<G4int, G4String> fParticleNames;
+};
+
+#endif
@@ -13,7 +13,10 @@
 
 #ifndef AmoreDetectorConstruction_HH
 #define AmoreDetectorConstruction_HH 1
+#include <map>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "G4GeometryTolerance.hh"
 #include "G4NavigationHistory.hh"
@@ -42,10 +45,24 @@ class AmoreDetectorConstruction : public CupDetectorConstruction {
 		G4bool fRockgammaMode;
 		G4bool fAdditionalPE;
 		G4bool fDbgMsgOn;
-		G4bool OverlapCheck;
+		G4bool OverlapCheck; // of each placement, kept off (see AmoreOverlapValidator)
+
+		// Overlap validation of the built world
+		G4bool fOverlapValidation;
+		G4bool fOverlapAutoCheck;
+		G4int fOverlapNThreads;
+		G4int fOverlapResolution;
+		G4String fOverlapRecordDir;
 
 		std::set<AmoreModuleSDInfo> fModuleSDInfos;
 
+		// Geometry snapshot (see Amore_GeometrySnapshot.cc)
+		G4bool fGeomSnapshotOn;
+		G4String fGeomSnapshotDir;
+		G4String fGeomSnapshotKey;
+		G4String fGeomSnapshotEntry;
+		std::vector<std::pair<G4String, G4VPhysicalVolume *>> fPMTOpticalModelPVs;
+
 	protected:
 		using CrystalModuleInfo = AmoreDetectorStaticInfo::CrystalModuleInfo;
 
@@ -247,8 +264,14 @@ class AmoreDetectorConstruction : public CupDetectorConstruction {
 		inline void SetNeutronMode(G4bool a) { fNeutronMode = a; }
 		inline void SetRockgammaMode(G4bool a) { fRockgammaMode = a; }
 		inline void SetAdditionalPE(G4bool a) { fAdditionalPE = a; }
-		inline void SetOverlapCheck(G4bool a) { OverlapCheck = a; }
+		inline void SetOverlapCheck(G4bool a) { fOverlapValidation = a; }
+		inline void SetOverlapAutoCheck(G4bool a) { fOverlapAutoCheck = a; }
+		inline void SetOverlapNThreads(G4int a) { fOverlapNThreads = a; }
+		inline void SetOverlapResolution(G4int a) { fOverlapResolution = a; }
+		inline void SetOverlapRecordDir(const G4String &a) { fOverlapRecordDir = a; }
 		inline void SetDebugMessage(G4bool a) { fDbgMsgOn = a; }
+		inline void SetGeometrySnapshot(G4bool a) { fGeomSnapshotOn = a; }
+		inline void SetGeometrySnapshotDir(const G4String &a) { fGeomSnapshotDir = a; }
 
 		inline G4bool GetEnableOriginalGeometry() const { return fEnable_OriginalGeom; }
 		inline G4bool GetEnableScintillator() const { return fEnable_Scintillator; }
@@ -260,8 +283,14 @@ class AmoreDetectorConstruction : public CupDetectorConstruction {
 		inline G4bool GetNeutronMode() const { return fNeutronMode; }
 		inline G4bool GetRockgammaMode() const { return fRockgammaMode; }
 		inline G4bool GetAdditionalPE() const { return fAdditionalPE; }
-		inline G4bool GetOverlapCheck() const { return OverlapCheck; }
+		inline G4bool GetOverlapCheck() const { return fOverlapValidation; }
+		inline G4bool GetOverlapAutoCheck() const { return fOverlapAutoCheck; }
+		inline G4int GetOverlapNThreads() const { return fOverlapNThreads; }
+		inline G4int GetOverlapResolution() const { return fOverlapResolution; }
+		inline const G4String &GetOverlapRecordDir() const { return fOverlapRecordDir; }
 		inline G4bool GetDebugMessage() const { return fDbgMsgOn; } 
+		inline G4bool GetGeometrySnapshot() const { return fGeomSnapshotOn; }
+		inline const G4String &GetGeometrySnapshotDir() const { return fGeomSnapshotDir; }
 
 		// For common uses
 		inline bool JudgeBorderIncident(const G4Step *aStep, const G4VPhysicalVolume *const *aTargetPV,
@@ -290,6 +319,7 @@ class AmoreDetectorConstruction : public CupDetectorConstruction {
 		inline G4VPhysicalVolume *GetFloorPEPV() const { return f200_FloorPEPhysical; }
 		inline G4VPhysicalVolume *GetCeilingPEPV() const { return f200_CeilingPEPhysical; }
 		inline G4VPhysicalVolume *GetRealPEPV() const { return f200_RealPEPhysical; }
+		inline G4VPhysicalVolume *GetOVCPV() const { return f200_OVCPhysical; }
 
 		// For AMoRE I (can be moved to common section in the future)
 		inline void Set_I_EnableSuperConductingShield(G4bool a) { fI_Enable_SuperConductingShield = a; }
@@ -367,6 +397,19 @@ class AmoreDetectorConstruction : public CupDetectorConstruction {
 
 		void ConstructMyDetector();              ///< make the MyDetector
 
+		/// Places the PMT optical model on the region of aEnvelopePV and keeps it for the snapshot
+		void AddPMTOpticalModel(const G4String &aName, G4VPhysicalVolume *aEnvelopePV);
+
+		// The world of the current /detGeometry/ and settings_*.dat configuration is written as
+		// GDML with a binding table for the members used by SDs, regions and border judges.
+		G4String MakeGeometrySnapshotKey();
+		G4bool RestoreGeometrySnapshot(); ///< returns false if there is no usable snapshot
+		void StoreGeometrySnapshot();
+		void CollectGeometrySnapshotSlots(std::map<G4String, G4LogicalVolume **> &aLVs,
+				std::map<G4String, G4VPhysicalVolume **> &aPVs,
+				std::map<G4String, G4int *> &aInts,
+				std::map<G4String, std::set<G4LogicalVolume *> *> &aLVSets);
+
 		void ConstructAMoREPilot(); ///< make the AMoRE-Pilot detector RUN6 setting
 		void ConstructAMoREPilotRUN5(); ///< make the AMoRE-Pilot detector RUN6 setting
 
@@ -459,6 +502,9 @@ bool AmoreDetectorConstruction::DoesNavHistContainPV(const G4NavigationHistory *
 bool AmoreDetectorConstruction::JudgeBorderIncident(const G4Step *aStep,
 		const G4VPhysicalVolume *const *aTargetPV,
 		G4int aNumOfTarget) const {
+	// A step enters a volume only when it ends on a geometry boundary
+	if (aStep->GetPostStepPoint()->GetStepStatus() != fGeomBoundary) return false;
+
 	G4bool tPreContainsTargetPV = false;
 	G4StepPoint *tPreStepPt     = aStep->GetPreStepPoint();
 	if (tPreStepPt != nullptr)
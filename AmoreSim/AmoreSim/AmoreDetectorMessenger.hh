@@ -29,6 +29,8 @@ class AmoreDetectorMessenger : public G4UImessenger {
     G4UIdirectory *Amore200_DetectorDir;
     G4UIdirectory *AmorePilot_DetectorDir;
     G4UIdirectory *AmorePilotRUN5_DetectorDir;
+    G4UIdirectory *GeomSnapshotDir;
+    G4UIdirectory *OverlapDir;
 
     G4UIcommand *DetGeometrySelectCmd;
 
@@ -44,6 +46,14 @@ class AmoreDetectorMessenger : public G4UImessenger {
 		G4UIcommand *DebugModeCmd;
 		G4UIcommand *OverlapCheckCmd;
 
+    G4UIcommand *GeomSnapshotCmd;
+    G4UIcommand *GeomSnapshotDirCmd;
+
+    G4UIcommand *OverlapAutoCmd;
+    G4UIcommand *OverlapThreadsCmd;
+    G4UIcommand *OverlapResolutionCmd;
+    G4UIcommand *OverlapRecordDirCmd;
+
     // For AMoRE I
     G4UIcommand *EnableSuperMagneticShieldCmd;
     G4UIcommand *EnableCrystalArray;
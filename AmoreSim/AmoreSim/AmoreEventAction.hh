@@ -15,6 +15,7 @@
 #include "globals.hh"
 
 #include "fstream"
+#include <chrono>
 
 #include "AmoreSim/AmoreRootNtuple.hh"
 #include "CupSim/CupVEventAction.hh"
@@ -44,7 +45,7 @@ class AmoreEventAction : public CupVEventAction {
   public:
     // constructor, destructor
     //  AmoreEventAction();
-    AmoreEventAction(AmoreRootNtuple *r = 0); // EJ
+    AmoreEventAction(AmoreRootNtuple *r = 0, G4bool aOwnRecorder = false); // EJ
     ~AmoreEventAction();
 
     // overrides for G4UserEventAction methods
@@ -61,6 +62,9 @@ class AmoreEventAction : public CupVEventAction {
   private: // EJ
     // Save the CupRecorderBase object to be called by the UserEventAction.
     AmoreRootNtuple *recorder; // EJ
+    G4bool fOwnRecorder;       // true for the per-worker recorder in MT mode
+    std::chrono::steady_clock::time_point fEventStart;
+    // Written once by the detector construction on the master, read-only during event loops
     static G4ThreeVector fgPrimPosSkew;
     G4bool fPrimSkewEnable;
     G4UIcommand *fPrimSkewEnableCmd;
@@ -0,0 +1,98 @@
+//
+// AmoreEventFilter.hh
+//
+// Selection of the recorded events (/ntuple/eventFilter), e.g.
+//   nCrystalHit >= 1 && vetoEdep < 1*MeV && Etot in [2.9, 3.1]*MeV
+// The expression is compiled once into a postfix program, which is run at the end of each
+// event on AmoreEventSummary. Identifiers other than the variables below are Geant4 units.
+//   nCrystalHit, nVetoHit : number of crystals / veto cells with an energy deposit
+//   Etot, EtotQ           : energy deposit in the crystals, without / with quenching
+//   vetoEdep              : energy deposit in the veto cells
+//   hit(i)                : 1 if crystal i has an energy deposit
+// Operators: || && ! < <= > >= == != + - * / ( ) and "x in [a, b]" (with an optional unit
+// factor after the bracket applied to both bounds).
+//
+#ifndef __AmoreEventFilter_hh__
+#define __AmoreEventFilter_hh__ 1
+
+#include "globals.hh"
+
+#include <vector>
+
+// Per-event quantities of the crystal and veto cells, taken from the hit collections
+struct AmoreEventSummary {
+    G4bool fValid = false; // False if the event has no hit collection of crystals
+    G4int fNCrystalHit     = 0;
+    G4int fNVetoHit        = 0;
+    G4double fCrystalEdep  = 0.;
+    G4double fCrystalQEdep = 0.;
+    G4double fVetoEdep     = 0.;
+    std::vector<G4bool> fCrystalHits; // Hit mask by crystal index
+
+    void Clear() {
+        fValid       = false;
+        fNCrystalHit = fNVetoHit = 0;
+        fCrystalEdep = fCrystalQEdep = fVetoEdep = 0.;
+        fCrystalHits.clear();
+    }
+    inline void AddCrystal(G4double aEdep, G4double aQEdep) {
+        fCrystalHits.push_back(aEdep > 0.);
+        if (aEdep > 0.) fNCrystalHit++;
+        fCrystalEdep += aEdep;
+        fCrystalQEdep += aQEdep;
+    }
+    inline void AddVeto(G4double aEdep) {
+        if (aEdep > 0.) fNVetoHit++;
+        fVetoEdep += aEdep;
+    }
+};
+
+class AmoreEventFilter {
+  public:
+    AmoreEventFilter(){};
+    ~AmoreEventFilter(){};
+
+    // Keeps the current program and returns false if aExpression has an error
+    G4bool Compile(const G4String &aExpression);
+    inline const G4String &GetExpression() const { return fExpression; }
+    inline G4bool IsCompiled() const { return !fProgram.empty(); }
+
+    G4bool Accept(const AmoreEventSummary &aSummary);
+
+  private:
+    enum eOperation {
+        kConstant,
+        kVariable,
+        kHit,
+        kAdd,
+        kSubtract,
+        kMultiply,
+        kDivide,
+        kNegate,
+        kNot,
+        kAnd,
+        kOr,
+        kLess,
+        kLessEqual,
+        kGreater,
+        kGreaterEqual,
+        kEqual,
+        kNotEqual,
+        kInRange
+    };
+    enum eVariable { kNCrystalHit, kNVetoHit, kEtot, kEtotQ, kVetoEdep };
+    struct Instruction {
+        eOperation fOperation;
+        G4double fValue; // Constant, or the variable as eVariable
+    };
+    using Program = std::vector<Instruction>;
+
+    // Recursive descent parser, each level returning the program of its part
+    class Parser;
+
+    G4String fExpression;
+    Program fProgram;
+    std::vector<G4double> fStack;
+};
+
+#endif
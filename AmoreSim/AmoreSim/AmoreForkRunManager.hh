@@ -0,0 +1,48 @@
+//
+// AmoreForkRunManager.hh
+//
+// Multi-process mode of amoresim (--fork N). The geometry and the physics tables are built
+// once by the sequential run manager. At the first /run/beamOn the process forks N children
+// which share these pages copy-on-write. Every child executes the rest of the macro and, for
+// every run, processes its own range of events with its own seeds into its own output file.
+// The parent processes no events. It waits for the children and merges their outputs when
+// the recorder closes the file.
+//
+#ifndef __AmoreForkRunManager_hh__
+#define __AmoreForkRunManager_hh__ 1
+
+#include "G4RunManager.hh"
+#include "globals.hh"
+
+#include <sys/types.h>
+#include <vector>
+
+class AmoreRootNtuple;
+
+class AmoreForkRunManager : public G4RunManager {
+  public:
+    AmoreForkRunManager(G4int aNProcesses);
+    virtual ~AmoreForkRunManager(){};
+
+    virtual void BeamOn(G4int n_event, const char *macroFile = 0, G4int n_select = -1);
+    virtual G4Event *GenerateEvent(G4int i_event);
+
+    inline void SetRecorder(AmoreRootNtuple *a) { fRecorder = a; }
+    inline G4bool IsChild() const { return fChildIndex >= 0; }
+    inline G4int GetNumberOfProcesses() const { return fNProcesses; }
+
+    // Returns false if any child has failed
+    G4bool WaitForChildren();
+
+  private:
+    void ForkChildren();
+    void ReseedChild();
+
+    G4int fNProcesses;
+    G4int fChildIndex; // -1 in the parent process
+    G4int fEventOffset;
+    std::vector<pid_t> fChildren;
+    AmoreRootNtuple *fRecorder;
+};
+
+#endif
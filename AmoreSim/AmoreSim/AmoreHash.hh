@@ -0,0 +1,23 @@
+//
+// AmoreHash.hh
+//
+// Names of the entries of the on-disk caches and records (physics tables, geometry snapshots,
+// overlap records), made from their text keys. FNV-1a is used since, unlike std::hash, it
+// gives the same value for every build.
+//
+#ifndef __AmoreHash_hh__
+#define __AmoreHash_hh__ 1
+
+#include "globals.hh"
+
+#include <cstdint>
+#include <string>
+
+namespace AmoreHash {
+    // 64-bit FNV-1a of aText
+    std::uint64_t Digest(const std::string &aText);
+    // The same as 16 hexadecimal digits
+    G4String HexDigest(const std::string &aText);
+} // namespace AmoreHash
+
+#endif
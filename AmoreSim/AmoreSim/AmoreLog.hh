@@ -0,0 +1,74 @@
+//
+// AmoreLog.hh
+//
+// Logging of the per-event and per-hit messages (/amore/log/). Every message belongs to a
+// category and has a level, and is only formatted if the category is enabled at that level:
+//   AMORE_LOG(kHit, kDebug) << "edep= " << edep;
+// The line ends by itself. The lines are collected in a buffer of the thread and written to
+// G4cout when the buffer is full, at the end of each run, and by Flush().
+//
+#ifndef __AmoreLog_hh__
+#define __AmoreLog_hh__ 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+#include <atomic>
+#include <sstream>
+
+class G4UIcommand;
+class G4UIdirectory;
+
+class AmoreLog : public G4UImessenger {
+  public:
+    enum eCategory { kEvent, kHit, kNtuple, kNCategories };
+    enum eLevel { kSilent, kWarning, kInfo, kDebug };
+
+    static AmoreLog *GetInstance();
+    ~AmoreLog();
+
+    void SetNewValue(G4UIcommand *command, G4String newValue);
+    G4String GetCurrentValue(G4UIcommand *command);
+
+    static inline G4bool IsEnabled(eCategory aCategory, eLevel aLevel) {
+        return aLevel <= fgLevels[aCategory].load(std::memory_order_relaxed);
+    }
+    // Writes the buffered lines of the calling thread
+    static void Flush();
+
+    class Line {
+      public:
+        Line() : fStream(GetStream()) {}
+        ~Line();
+        template <typename T>
+        inline Line &operator<<(const T &aValue) {
+            fStream << aValue;
+            return *this;
+        }
+
+      private:
+        std::ostringstream &fStream;
+    };
+
+  private:
+    AmoreLog();
+    static std::ostringstream &GetStream();
+    void PrintLevels() const;
+
+    static AmoreLog *fgInstance;
+    static std::atomic<G4int> fgLevels[kNCategories];
+    static std::atomic<G4int> fgBufferSize;
+
+    G4UIdirectory *fLogDir;
+    G4UIcommand *fLevelCmd;
+    G4UIcommand *fBufferSizeCmd;
+    G4UIcommand *fListCmd;
+};
+
+// The message is not evaluated at all if the category is disabled at that level
+#define AMORE_LOG(aCategory, aLevel)                                                             \
+    if (!AmoreLog::IsEnabled(AmoreLog::aCategory, AmoreLog::aLevel)) {                           \
+    } else                                                                                       \
+        AmoreLog::Line()
+
+#endif
@@ -57,10 +57,15 @@ class AmoreModuleHit : public G4VHit {
     virtual std::vector<G4AttValue> *CreateAttValues() const;
     virtual void Print();
 
-    inline void SetCrystalEdep(G4double aE) { fEdepOnCrystal = aE; }
-    inline void SetCrystalQEdep(G4double aE) { fQuenchedEdepOnCrystal = aE; }
-    inline void SetGeWaferEdep(G4double aE) { fEdepOnGeWafer = aE; }
-    inline void SetGeWaferQEdep(G4double aE) { fQuenchedEdepOnGeWafer = aE; }
+    // Hits kept by the SD across events are put in aList when they get a deposit
+    inline void SetTouchedHitList(std::vector<AmoreModuleHit *> *aList) { fTouchedHits = aList; }
+    inline G4bool IsTouched() const { return fTouched; }
+    inline void Clear();
+
+    inline void SetCrystalEdep(G4double aE) { fEdepOnCrystal = aE; MarkTouched(aE); }
+    inline void SetCrystalQEdep(G4double aE) { fQuenchedEdepOnCrystal = aE; MarkTouched(aE); }
+    inline void SetGeWaferEdep(G4double aE) { fEdepOnGeWafer = aE; MarkTouched(aE); }
+    inline void SetGeWaferQEdep(G4double aE) { fQuenchedEdepOnGeWafer = aE; MarkTouched(aE); }
 
     inline G4bool SetGeWaferGoldFilmEdep(G4int aIdx, G4double aE);
     inline G4bool SetCrystalGoldFilmEdep(G4int aIdx, G4double aE);
@@ -81,10 +86,10 @@ class AmoreModuleHit : public G4VHit {
     inline G4bool ResetGeWaferGoldFilmEdep(G4int aIdx) { return SetGeWaferGoldFilmEdep(aIdx, 0); };
     inline G4bool ResetCrystalGoldFilmEdep(G4int aIdx) { return SetCrystalGoldFilmEdep(aIdx, 0); };
 
-    inline void AddCrystalEdep(G4double aE) { fEdepOnCrystal += aE; }
-    inline void AddCrystalQEdep(G4double aE) { fQuenchedEdepOnCrystal += aE; }
-    inline void AddGeWaferEdep(G4double aE) { fEdepOnGeWafer += aE; }
-    inline void AddGeWaferQEdep(G4double aE) { fQuenchedEdepOnGeWafer += aE; }
+    inline void AddCrystalEdep(G4double aE) { fEdepOnCrystal += aE; MarkTouched(aE); }
+    inline void AddCrystalQEdep(G4double aE) { fQuenchedEdepOnCrystal += aE; MarkTouched(aE); }
+    inline void AddGeWaferEdep(G4double aE) { fEdepOnGeWafer += aE; MarkTouched(aE); }
+    inline void AddGeWaferQEdep(G4double aE) { fQuenchedEdepOnGeWafer += aE; MarkTouched(aE); }
     inline G4bool AddGeWaferGoldFilmEdep(G4int aIdx, G4double aE);
     inline G4bool AddCrystalGoldFilmEdep(G4int aIdx, G4double aE);
 
@@ -114,15 +119,23 @@ class AmoreModuleHit : public G4VHit {
         aYIdx = fModuleSDInfo->fCrystalPosIdx[1];
     }
 
+    static constexpr G4int kMaxGoldFilmNum = 4;
+
   private:
+    inline void MarkTouched(G4double aE);
+
     G4double fEdepOnCrystal;
     G4double fQuenchedEdepOnCrystal;
     G4double fEdepOnGeWafer;
     G4double fQuenchedEdepOnGeWafer;
-    std::vector<G4double> fEdepOnGeWaferGoldFilm;
-    std::vector<G4double> fEdepOnCrystalGoldFilm;
+    G4double fEdepOnGeWaferGoldFilm[kMaxGoldFilmNum];
+    G4double fEdepOnCrystalGoldFilm[kMaxGoldFilmNum];
+    G4int fGeWaferGoldFilmNum;
+    G4int fCrystalGoldFilmNum;
 
     const AmoreModuleSDInfo *fModuleSDInfo;
+    G4bool fTouched;
+    std::vector<AmoreModuleHit *> *fTouchedHits;
 
   protected:
     static G4int fgGeWaferGoldFilmNum;
@@ -135,7 +148,17 @@ class AmoreModuleHit : public G4VHit {
     static inline G4int GetCrystalGoldFilmNum() { return fgCrystalGoldFilmNum; }
 };
 
-typedef G4THitsCollection<AmoreModuleHit> AmoreModuleHitsCollection;
+// The hits belong to AmoreModuleSD, which keeps them across events, so the collection does
+// not delete them
+class AmoreModuleHitsCollection : public G4THitsCollection<AmoreModuleHit> {
+  public:
+    AmoreModuleHitsCollection(G4String aDetName, G4String aColName)
+        : G4THitsCollection<AmoreModuleHit>(aDetName, aColName) {}
+    virtual ~AmoreModuleHitsCollection() { GetVector()->clear(); }
+};
+// G4THitsCollection allocates its objects with the size of G4HitsCollection
+static_assert(sizeof(AmoreModuleHitsCollection) == sizeof(G4HitsCollection),
+              "AmoreModuleHitsCollection must not add data members");
 
 #if G4VERSION_NUMBER <= 999
 extern G4Allocator<AmoreModuleHit> *AmoreModuleHitAllocator;
@@ -154,77 +177,95 @@ inline void AmoreModuleHit::operator delete(void *aHit) {
     AmoreModuleHitAllocator->FreeSingle((AmoreModuleHit *)aHit);
 }
 
+inline void AmoreModuleHit::MarkTouched(G4double aE) {
+    if (fTouched || aE == 0.) return;
+    fTouched = true;
+    if (fTouchedHits != nullptr) fTouchedHits->push_back(this);
+}
+
+inline void AmoreModuleHit::Clear() {
+    fEdepOnCrystal         = 0.;
+    fQuenchedEdepOnCrystal = 0.;
+    fEdepOnGeWafer         = 0.;
+    fQuenchedEdepOnGeWafer = 0.;
+    ResetGeWaferGoldFilmEdepAll();
+    ResetCrystalGoldFilmEdepAll();
+    fTouched = false;
+}
+
 inline void AmoreModuleHit::SetCrystalGoldFilmNum(G4int aNum) {
-    if (aNum >= 1)
-        fgCrystalGoldFilmNum = aNum;
-    else
+    if (aNum < 1)
         fgCrystalGoldFilmNum = 1;
+    else if (aNum > kMaxGoldFilmNum)
+        fgCrystalGoldFilmNum = kMaxGoldFilmNum;
+    else
+        fgCrystalGoldFilmNum = aNum;
 }
 
 inline void AmoreModuleHit::ResetCrystalGoldFilmEdepAll() {
-    for (auto &nowVal : fEdepOnCrystalGoldFilm)
-        nowVal = 0;
+    for (G4int i = 0; i < fCrystalGoldFilmNum; i++)
+        fEdepOnCrystalGoldFilm[i] = 0;
 }
 
 inline G4bool AmoreModuleHit::SetCrystalGoldFilmEdep(G4int aIdx, G4double aE) {
-    if (fEdepOnCrystalGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnCrystalGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fCrystalGoldFilmNum)) {
         fEdepOnCrystalGoldFilm[aIdx] = aE;
+        MarkTouched(aE);
         return true;
     } else
         return false;
 }
 
 inline G4bool AmoreModuleHit::AddCrystalGoldFilmEdep(G4int aIdx, G4double aE) {
-    if (fEdepOnCrystalGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnCrystalGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fCrystalGoldFilmNum)) {
         fEdepOnCrystalGoldFilm[aIdx] += aE;
+        MarkTouched(aE);
         return true;
     } else
         return false;
 }
 
 inline void AmoreModuleHit::SetGeWaferGoldFilmNum(G4int aNum) {
-    if (aNum >= 1)
-        fgGeWaferGoldFilmNum = aNum;
-    else
+    if (aNum < 1)
         fgGeWaferGoldFilmNum = 1;
+    else if (aNum > kMaxGoldFilmNum)
+        fgGeWaferGoldFilmNum = kMaxGoldFilmNum;
+    else
+        fgGeWaferGoldFilmNum = aNum;
 }
 
 inline void AmoreModuleHit::ResetGeWaferGoldFilmEdepAll() {
-    for (auto &nowVal : fEdepOnGeWaferGoldFilm)
-        nowVal = 0;
+    for (G4int i = 0; i < fGeWaferGoldFilmNum; i++)
+        fEdepOnGeWaferGoldFilm[i] = 0;
 }
 
 inline G4bool AmoreModuleHit::SetGeWaferGoldFilmEdep(G4int aIdx, G4double aE) {
-    if (fEdepOnGeWaferGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnGeWaferGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fGeWaferGoldFilmNum)) {
         fEdepOnGeWaferGoldFilm[aIdx] = aE;
+        MarkTouched(aE);
         return true;
     } else
         return false;
 }
 
 inline G4bool AmoreModuleHit::AddGeWaferGoldFilmEdep(G4int aIdx, G4double aE) {
-    if (fEdepOnGeWaferGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnGeWaferGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fGeWaferGoldFilmNum)) {
         fEdepOnGeWaferGoldFilm[aIdx] += aE;
+        MarkTouched(aE);
         return true;
     } else
         return false;
 }
 
 inline G4double AmoreModuleHit::GetCrystalGoldFilmEdep(G4int aIdx) const {
-    if (fEdepOnGeWaferGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnCrystalGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fCrystalGoldFilmNum)) {
         return fEdepOnCrystalGoldFilm[aIdx];
     } else
         return -1;
 }
 
 inline G4double AmoreModuleHit::GetGeWaferGoldFilmEdep(G4int aIdx) const {
-    if (fEdepOnGeWaferGoldFilm.size() > 0 &&
-        MACRO_IS_IN_RANGE_OF(0, aIdx, (G4int)fEdepOnGeWaferGoldFilm.size())) {
+    if (MACRO_IS_IN_RANGE_OF(0, aIdx, fGeWaferGoldFilmNum)) {
         return fEdepOnGeWaferGoldFilm[aIdx];
     } else
         return -1;
@@ -2,11 +2,15 @@
 #ifndef AmoreModuleSD_h
 #define AmoreModuleSD_h 1
 #include <set>
+#include <unordered_map>
 
 #include "AmoreSim/AmoreDetectorStaticInfo.hh"
 #include "AmoreSim/AmoreModuleHit.hh"
+#include "G4TouchableHandle.hh"
 #include "G4VSensitiveDetector.hh"
 
+class G4ParticleDefinition;
+class AmoreQuenchingBuffer;
 class G4Step;
 class G4HCofThisEvent;
 class G4TouchableHistory;
@@ -23,8 +27,36 @@ class AmoreModuleSD : public G4VSensitiveDetector {
     virtual G4bool ProcessHits(G4Step *aStep, G4TouchableHistory *aTHist);
     virtual void EndOfEvent(G4HCofThisEvent *HCE);
 
+    // The crystal steps are quenched at the end of the event if a buffer is given
+    inline void SetQuenchingBuffer(AmoreQuenchingBuffer *aBuffer) { fQuenchingBuffer = aBuffer; }
+    // Hits touched in the current event, in the order of their first deposit
+    inline const std::vector<AmoreModuleHit *> &GetTouchedHits() const { return fTouchedHits; }
+
   private:
+    enum eComponent { kCrystal, kGeWafer, kCrystalGoldFilm, kGeWaferGoldFilm, kNoComponent };
+    // Place of a sensitive PV in its module, taken from the geometry at construction
+    struct ComponentInfo {
+        eComponent fComponent;
+        G4int fEnvelopeDepth; // Touchable depth of the module envelope, -1 if not unique
+        G4int fCopyNo;
+    };
+
+    void BuildComponentTable();
+    void CollectComponents(const AmoreModuleSDInfo &aSDInfo, G4LogicalVolume *aMotherLV,
+                           G4int aDepth);
+    static eComponent GetComponentOf(const AmoreModuleSDInfo &aSDInfo,
+                                     const G4LogicalVolume *aLV);
+    static eComponent GetComponentOf(const AmoreModuleHit *aHit, const G4LogicalVolume *aLV);
+    static G4int FindEnvelopeCopyNo(const G4TouchableHandle &aTouchable);
+    static G4double GetVisibleEnergy(const G4Step *aStep);
+
+    std::unordered_map<const G4VPhysicalVolume *, ComponentInfo> fComponentTable;
+    const G4ParticleDefinition *fOpticalPhoton;
+    AmoreQuenchingBuffer *fQuenchingBuffer;
     AmoreModuleHitsCollection *fHitsColl;
+    // One hit per module, kept across events and cleared when touched by the last event
+    std::vector<AmoreModuleHit *> fModuleHits;
+    std::vector<AmoreModuleHit *> fTouchedHits;
     G4int fHitCollID;
     G4int fModulesNumber;
     std::set<AmoreModuleSDInfo> &fModuleSDInfoList;
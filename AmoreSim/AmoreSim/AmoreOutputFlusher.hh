@@ -0,0 +1,73 @@
+//
+// AmoreOutputFlusher.hh
+//
+// Periodic flushes of the output files (/ntuple/io/). The recorders write their baskets every
+// /ntuple/flushPeriod events and then synchronize the file with the disk. Compressing and
+// writing the baskets and the synchronization can stall the event loop for a long time on
+// network file systems. With /ntuple/io/async a background thread does all of it while the
+// event loop simulates the next events. The recorder guards its own uses of the tree (Fill,
+// closing) with the mutex given to Flush(), which the thread holds while it writes the baskets.
+// The requests wait in a bounded queue: when it is full the event loop either waits for the
+// thread (block) or leaves the tree to the next flush (skip).
+// Baskets can also be compressed in parallel by the implicit multi-threading of ROOT.
+//
+#ifndef __AmoreOutputFlusher_hh__
+#define __AmoreOutputFlusher_hh__ 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class G4UIcommand;
+class G4UIdirectory;
+class TTree;
+
+class AmoreOutputFlusher : public G4UImessenger {
+  public:
+    static AmoreOutputFlusher *GetInstance();
+    ~AmoreOutputFlusher();
+
+    void SetNewValue(G4UIcommand *command, G4String newValue);
+    G4String GetCurrentValue(G4UIcommand *command);
+
+    // Writes the baskets of aTree and synchronizes its file, in the background if enabled
+    void Flush(TTree *aTree, std::mutex &aTreeMutex);
+    // Returns once the queued flushes of aTree are done. Called before the tree is closed.
+    void Wait(const TTree *aTree);
+
+  private:
+    AmoreOutputFlusher();
+    struct Request {
+        TTree *fTree;
+        std::mutex *fTreeMutex;
+    };
+    static void FlushNow(TTree *aTree, std::mutex &aTreeMutex);
+    void ProcessQueue();
+    void EnableImplicitMT(G4int aNThreads);
+
+    static AmoreOutputFlusher *fgInstance;
+
+    G4bool fAsync;
+    G4int fQueueSize;
+    G4bool fBlockWhenFull;
+    G4int fNSkipped;
+
+    std::thread fThread;
+    std::mutex fMutex;
+    std::condition_variable fCondition;
+    std::deque<Request> fPending;
+    const TTree *fFlushingTree; // Tree of the request taken by the thread
+    G4bool fStopping;
+
+    G4UIdirectory *fIODir;
+    G4UIcommand *fAsyncCmd;
+    G4UIcommand *fQueueSizeCmd;
+    G4UIcommand *fWhenFullCmd;
+    G4UIcommand *fIMTCmd;
+};
+
+#endif
@@ -0,0 +1,51 @@
+//
+// AmoreOverlapValidator.hh
+//
+// Checks every placement of a built world for overlaps with its mother and its sisters,
+// spreading the placements over threads. The check samples points on the surface of each
+// placement like G4PVPlacement::CheckOverlaps does, but without printing from the threads.
+// The points are sampled once per solid before the threads start, since GetPointOnSurface()
+// may fill caches of the solid, which is shared by all of its placements.
+// The result is recorded per hash of the built world (solids, materials and placements), so
+// jobs with an unchanged geometry can skip the check.
+//
+#ifndef __AmoreOverlapValidator_hh__
+#define __AmoreOverlapValidator_hh__ 1
+
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+
+#include <map>
+#include <vector>
+
+class G4LogicalVolume;
+class G4VPhysicalVolume;
+class G4VSolid;
+
+class AmoreOverlapValidator {
+  public:
+    AmoreOverlapValidator(G4int aResolution, G4int aNThreads);
+    ~AmoreOverlapValidator(){};
+
+    // Checks aWorld unless aRecordDir has a record of the same geometry without overlaps, with at
+    // least the same resolution, and aForce is false. Returns the number of overlaps found.
+    G4int Validate(const G4VPhysicalVolume *aWorld, const G4String &aRecordDir, G4bool aForce);
+
+    G4String MakeGeometryHash(const G4VPhysicalVolume *aWorld) const;
+
+  private:
+    struct Placement {
+        const G4LogicalVolume *fMother;
+        const G4VPhysicalVolume *fDaughter;
+    };
+
+    using SurfacePoints = std::map<const G4VSolid *, std::vector<G4ThreeVector>>;
+
+    void CheckPlacement(const Placement &aPlacement, const SurfacePoints &aSurfacePoints,
+                        std::vector<G4String> &aOverlaps) const;
+
+    G4int fResolution;
+    G4int fNThreads;
+};
+
+#endif
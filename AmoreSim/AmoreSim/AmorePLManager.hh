@@ -12,6 +12,7 @@
 #include "CupSim/CupStrParam.hh"
 
 class G4UIcommand;
+class AmorePhysicsTableCache;
 
 #if G4VERSION_NUMBER >= 1000
 class AmoreCPLDummyMessenger : public G4UImessenger {
@@ -145,6 +146,10 @@ class AmorePLManager {
 
     bool fUseCupPL;
 
+    bool fUseTableCache;
+    std::string fTableCacheDir;
+    AmorePhysicsTableCache *fTableCache;
+
     std::string fRefPLName;
     std::string fEMPhysName;
 
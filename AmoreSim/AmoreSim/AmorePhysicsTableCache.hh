@@ -0,0 +1,51 @@
+//
+// AmorePhysicsTableCache.hh
+//
+// Keeps the physics tables of AmorePLManager in a cache directory across jobs.
+// At the first run, a key is made from the Geant4 version, the physics list, the processes
+// of every particle, the EM parameters, the production cuts of every region and the material
+// table. If a cache entry with the same key exists, the tables are retrieved from it instead
+// of being built. Otherwise they are stored into a new entry once they have been built.
+// A retrieval is checked once the tables are built: the physics list builds the tables it
+// could not read with only a warning, so such an entry is stored again.
+// Any change of those inputs gives a new key, so stale entries are never used.
+//
+#ifndef __AmorePhysicsTableCache_hh__
+#define __AmorePhysicsTableCache_hh__ 1
+
+#include "G4VStateDependent.hh"
+#include "globals.hh"
+
+class G4VExceptionHandler;
+class G4VUserPhysicsList;
+
+class AmorePhysicsTableCache : public G4VStateDependent {
+  public:
+    AmorePhysicsTableCache(G4VUserPhysicsList *aPhysicsList, const G4String &aCacheDir,
+                           const G4String &aListLabel);
+    virtual ~AmorePhysicsTableCache(){};
+
+    virtual G4bool Notify(G4ApplicationState requestedState);
+
+  private:
+    G4String MakeKey() const;
+    void LookUp();
+    void Store();
+
+    G4VUserPhysicsList *fPhysicsList;
+    G4String fCacheDir;
+    G4String fListLabel;
+
+    G4String fKey;
+    G4String fEntryDir;
+    G4bool fChecked;
+    G4bool fRetrieving;
+    G4bool fStorePending;
+
+    // Installed while retrieving, to count the failures reported by the physics list
+    G4VExceptionHandler *fFailureCounter;
+    G4VExceptionHandler *fPreviousHandler;
+    G4int fNRetrieveFailures;
+};
+
+#endif
@@ -0,0 +1,85 @@
+//
+// AmoreQuenchingBuffer.hh
+//
+// Deferred Birks quenching of the crystal deposits (/ntuple/quenching/). AmoreModuleSD appends
+// a few numbers of each crystal step to the buffer instead of quenching it with G4EmSaturation,
+// and the steps of the event are quenched together when the event ends.
+// With /ntuple/quenching/keepSteps the buffer is also written as Quenching_* columns of the
+// main tree, from which the crystal deposits can be quenched again with any Birks constant kB:
+//   visible = Eloss / (1 + kB Eloss / Length) + Niel / (1 + kB Niel / NielRange)
+// As in G4EmSaturation, a gamma deposit has Length = the electron range of its energy, and the
+// whole deposit of a neutron step, of a step of no length or of a step whose non-ionizing part
+// exceeds it is Niel. A NielRange of 0 leaves Niel unquenched. Every kept step is checked to
+// give back its quenched energy with the kB of the run. The steps of the sub-events run by
+// other threads are not kept.
+//
+#ifndef __AmoreQuenchingBuffer_hh__
+#define __AmoreQuenchingBuffer_hh__ 1
+
+#include "globals.hh"
+
+#include "Rtypes.h"
+
+#include <vector>
+
+class G4MaterialCutsCouple;
+class G4ParticleDefinition;
+class G4Step;
+class TTree;
+class AmoreModuleHit;
+
+// The kept steps of one event
+struct AmoreQuenchingSteps {
+    std::vector<Int_t> fModuleID;
+    std::vector<Double_t> fEloss; // Ionizing part of the energy deposit
+    std::vector<Double_t> fLength;
+    std::vector<Double_t> fNiel;
+    std::vector<Double_t> fNielRange;
+
+    void Branch(TTree *aTree);
+    void Clear();
+};
+
+class AmoreQuenchingBuffer {
+  public:
+    AmoreQuenchingBuffer() : fKeepSteps(false), fMismatchReported(false){};
+    ~AmoreQuenchingBuffer(){};
+
+    inline void SetKeepSteps(G4bool a) { fKeepSteps = a; }
+    inline G4bool GetKeepSteps() const { return fKeepSteps; }
+    inline AmoreQuenchingSteps &GetSteps() { return fSteps; }
+
+    void Add(G4int aModuleID, const G4Step *aStep);
+    // Adds the quenched energy of every buffered step to the hit of its module, indexed by the
+    // module ID, and empties the buffer
+    void Quench(const std::vector<AmoreModuleHit *> &aHits);
+    void Clear();
+
+    static inline G4double Quench(G4double aKB, G4double aEloss, G4double aLength) {
+        return (aEloss > 0. && aLength > 0.) ? aEloss / (1. + aKB * aEloss / aLength) : 0.;
+    }
+    // Visible energy of a kept step, by the formula above
+    static inline G4double Requench(G4double aKB, G4double aEloss, G4double aLength,
+                                    G4double aNiel, G4double aNielRange) {
+        return Quench(aKB, aEloss, aLength) +
+               (aNielRange > 0. ? Quench(aKB, aNiel, aNielRange) : aNiel);
+    }
+
+  private:
+    struct Entry {
+        G4int fModuleID;
+        const G4ParticleDefinition *fParticle;
+        const G4MaterialCutsCouple *fCouple;
+        G4double fEdep;
+        G4double fNiel;
+        G4double fLength;
+    };
+    void KeepStep(const Entry &aEntry, G4double aKB, G4double aVisible);
+
+    G4bool fKeepSteps;
+    G4bool fMismatchReported;
+    std::vector<Entry> fEntries;
+    AmoreQuenchingSteps fSteps;
+};
+
+#endif
@@ -14,9 +14,14 @@
 #include "TStopwatch.h"
 #include "TTree.h"
 
+#include "AmoreSim/AmoreCompactStep.hh"
 #include "AmoreSim/AmoreDetectorConstruction.hh"
+#include "AmoreSim/AmoreEventFilter.hh"
+#include "AmoreSim/AmoreQuenchingBuffer.hh"
 #include "AmoreSim/AmoreRootNtupleMessenger.hh"
+#include "AmoreSim/AmoreStepFilter.hh"
 #include "AmoreSim/AmoreTrajectoryPoint.hh"
+#include "AmoreSim/AmoreVolumeTable.hh"
 #include "CupSim/CupRootNtuple.hh"
 
 #include "MCObjs/DetectorArray_Amore.hh"
@@ -33,7 +38,10 @@
 #include "MCObjs/TGSD.hh"
 #include "MCObjs/Vertex.hh"
 
+#include "G4Threading.hh"
+
 #include <map>
+#include <mutex>
 #include <vector>
 // Forward declarations for ROOT.
 // class TFile;
@@ -51,6 +59,33 @@ class AmoreRootNtuple : public CupRootNtuple {
     G4int fRecordedEvt;
     G4bool fRecordWithCut;
     G4bool fRecordPrimary;
+    G4bool fCompactStep;
+
+    // Layout of the output trees (/ntuple/compression, /ntuple/basketSize, ...)
+    G4int fCompressionSettings; // -1 keeps the default of ROOT
+    G4int fBasketSize;          // 0 keeps the size given to each branch
+    G4int fAutoBasketEvents;    // Baskets are sized after this many entries if positive
+    G4bool fBasketsOptimized;
+    Long64_t fAutoFlush; // 0 keeps the default of ROOT, entries if positive, bytes if negative
+    G4int fEvtMod;
+    G4int fEvtModForPrim;
+    // Guards the trees against the flushes of AmoreOutputFlusher (/ntuple/io/async)
+    std::mutex fOutputMutex;
+
+    // Per-step volume lookups, written to the output as VolumeTable
+    AmoreVolumeTable fVolumeTable;
+    // Steps as columns of IDs instead of TStep objects (/ntuple/compactStep)
+    AmoreCompactSteps fCompactSteps;
+    AmoreStepDictionary fStepDictionary;
+    // Selection of the recorded steps (/ntuple/stepFilter/)
+    AmoreStepFilter fStepFilter;
+    // Selection of the recorded events (/ntuple/eventFilter), judged on the summary
+    AmoreEventSummary fEventSummary;
+    AmoreEventFilter fEventFilter;
+    // Crystal steps quenched at the end of the event (/ntuple/quenching/)
+    G4bool fDeferredQuenching;
+    G4bool fKeepQuenchingSteps;
+    AmoreQuenchingBuffer fQuenchingBuffer;
 
     AmoreRootNtupleMessenger *myAmoreNtupleMessenger;
 
@@ -63,6 +98,20 @@ class AmoreRootNtuple : public CupRootNtuple {
     G4int fPrimFillCntAtOVC;
 
     DetectorArray_Amore *fModuleArray;
+    std::vector<G4int> fWrittenModuleIDs; // Modules of fModuleArray set by the last event
+
+    // Multi-threaded mode: the recorder given to AmoreActionInitialization stays on the master
+    // and hands out one recorder per worker thread. Workers unregister themselves on deletion.
+    AmoreRootNtuple *fMasterRecorder;
+    std::vector<AmoreRootNtuple *> fWorkerRecorders;
+    G4String fOutputBaseName; // Name given by /event/output_file, without thread suffix
+    G4bool fOutputMode;
+
+    // Fork mode (--fork N): the parent process only remembers the outputs and merges the part
+    // files of its children when it closes the file. A child writes "<output>_f<index>".
+    G4int fForkChildren;
+    G4String fForkSuffix;
+    std::vector<G4String> fForkOutputs;
 
   protected:
     using eDetGeometry  = AmoreDetectorConstruction::eDetGeometry;
@@ -70,6 +119,12 @@ class AmoreRootNtuple : public CupRootNtuple {
     using eVetoGeometry = AmoreDetectorConstruction::eVetoGeometry;
 		using ePhaseAMoRE200 = AmoreDetectorConstruction::ePhaseAMoRE200;
     std::vector<TTrack *> *EndTrackList;
+    // EndTrack records of past events, reused by RecordET. A record belongs to the recorder
+    // whose list or pool holds it, so those handed over by sub-events join the parent's pool.
+    std::vector<TTrack *> fEndTrackPool;
+    // Records kept in the pool past an event, so that a rare large event does not hold its
+    // records for the rest of the run
+    static constexpr size_t fgcMaxPooledEndTracks = 100000;
 
     G4int fEvtInfo_EvtID;
     G4double fEvtInfo_EdepOV[2];
@@ -86,32 +141,44 @@ class AmoreRootNtuple : public CupRootNtuple {
     std::map<G4int, G4int> fTIDListForPrimAtOVC;
 
     void ClearEvent();
+    void SummarizeEvent(const G4Event *aEvent);
+    void OptimizeBasketSizes();
+    static void DeduplicateMetadata(const G4String &aFileName, G4bool aCompactStep);
 
   public:
     AmoreRootNtuple();
     ~AmoreRootNtuple();
 
+    AmoreRootNtuple *CreateWorkerRecorder();
+    inline G4bool IsWorkerRecorder() const { return fMasterRecorder != nullptr; }
+    G4String GetOutputBaseName() const;
+
+    inline void SetForkParent(G4int aNChildren) { fForkChildren = aNChildren; }
+    inline G4bool IsForkParent() const { return fForkChildren > 0; }
+    void BecomeForkChild(G4int aIndex);
+
     virtual void RecordBeginOfEvent(const G4Event *);
     virtual void RecordEndOfEvent(const G4Event *);
     virtual void SetTGSD(const G4Event *a_event);
     virtual void SetMDSD(const G4Event *a_event);
     virtual void OpenFile(const G4String filename, G4bool outputMode);
     virtual void CloseFile();
+    static G4bool MergeOutputFiles(const G4String &aTarget, const std::vector<G4String> &aParts,
+                                   G4int aCompressionSettings = -1);
 
     virtual void CreateTree();
 
     virtual bool RecordCut();
-    virtual int CountHittedCMOs();
+    virtual int CountHittedCMOs() const;
     virtual void RecordStep(const G4Step *);
     virtual void RecordTrack(const G4Track *);
     virtual void RecordET(const G4Track *);
     virtual void RecordPrimaryAtBorder(const G4Step *aStep);
     virtual void RecordPrimaryEvtInfos(const G4Event *aEvent);
-    void ClearET() {
-        for (auto i : *EndTrackList)
-            i->Delete();
-        EndTrackList->clear();
-    };
+    void ClearET();
+    inline std::vector<TTrack *> *GetEndTrackList() { return EndTrackList; }
+    // Drops the records of the current event without filling them, used for sub-events
+    inline void DiscardEvent() { ClearEvent(); }
 
     inline void SetRecordCut(G4bool a) { fRecordWithCut = a; }
     inline G4bool GetRecordCut() { return fRecordWithCut; }
@@ -126,6 +193,38 @@ class AmoreRootNtuple : public CupRootNtuple {
     }
     inline G4bool GetRecordPrim() { return fRecordPrimary; }
 
+    inline void SetCompactStep(G4bool a) { fCompactStep = a; }
+    inline G4bool GetCompactStep() { return fCompactStep; }
+
+    inline AmoreStepFilter &GetStepFilter() { return fStepFilter; }
+
+    inline void SetDeferredQuenching(G4bool a) { fDeferredQuenching = a; }
+    inline G4bool GetDeferredQuenching() { return fDeferredQuenching; }
+    // Keeping the steps defers the quenching as well
+    inline void SetKeepQuenchingSteps(G4bool a) {
+        fKeepQuenchingSteps = a;
+        if (a) fDeferredQuenching = true;
+    }
+    inline G4bool GetKeepQuenchingSteps() { return fKeepQuenchingSteps; }
+
+    // Compiles the expression and turns the cut on
+    void SetEventFilter(const G4String &aExpression);
+    inline const G4String &GetEventFilter() const { return fEventFilter.GetExpression(); }
+
+    void SetCompression(const G4String &aAlgorithm, G4int aLevel);
+    inline void SetBasketSize(G4int aSize, G4int aAutoEvents) {
+        fBasketSize       = aSize;
+        fAutoBasketEvents = aAutoEvents;
+    }
+    inline G4int GetBasketSize() { return fBasketSize; }
+    inline G4int GetAutoBasketEvents() { return fAutoBasketEvents; }
+    inline void SetAutoFlush(Long64_t a) { fAutoFlush = a; }
+    inline Long64_t GetAutoFlush() { return fAutoFlush; }
+    inline void SetFlushPeriod(G4int a) { fEvtMod = a; }
+    inline G4int GetFlushPeriod() { return fEvtMod; }
+    inline void SetPrimFlushPeriod(G4int a) { fEvtModForPrim = a; }
+    inline G4int GetPrimFlushPeriod() { return fEvtModForPrim; }
+
     enum {
         max_primary_particles   = 16,
         max_hits_for_ROOT       = 200000,
@@ -142,6 +241,7 @@ class AmoreRootNtuple : public CupRootNtuple {
         max_neutronCaptureSecondary = 100,
         max_correlBKG               = 1000000
     };
+    // Default periods of the basket flushes (/ntuple/flushPeriod, /ntuple/primFlushPeriod)
     enum { kEvtMod = 1000, kEvtModForPrim = 100000 };
 };
 #endif
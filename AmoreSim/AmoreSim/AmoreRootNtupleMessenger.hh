@@ -23,8 +23,28 @@ class AmoreRootNtupleMessenger : public CupRootNtupleMessenger {
 
     G4UIdirectory *AmoreRootNtupleDir;
     G4UIcommand *CUTCmd;
+    G4UIcommand *EventFilterCmd;
 
     G4UIcommand *PrimCmd;
+    G4UIcommand *CompactStepCmd;
+
+    G4UIcommand *CompressionCmd;
+    G4UIcommand *BasketSizeCmd;
+    G4UIcommand *ClusterSizeCmd;
+    G4UIcommand *FlushPeriodCmd;
+    G4UIcommand *PrimFlushPeriodCmd;
+
+    G4UIdirectory *QuenchingDir;
+    G4UIcommand *DeferredQuenchingCmd;
+    G4UIcommand *KeepQuenchingStepsCmd;
+
+    G4UIdirectory *StepFilterDir;
+    G4UIcommand *StepFilterVolumeCmd;
+    G4UIcommand *StepFilterRegionCmd;
+    G4UIcommand *StepFilterParticleCmd;
+    G4UIcommand *StepFilterMinEdepCmd;
+    G4UIcommand *StepFilterClearCmd;
+    G4UIcommand *StepFilterListCmd;
 };
 
 #endif
@@ -0,0 +1,54 @@
+//
+// AmoreRunAction.hh
+//
+// Run action of AmoreSim. On top of CupRunAction it measures how long each thread spends
+// inside events, and the master prints the busy and idle time of every worker at the end of
+// a run so that the load balancing of the MT and tasking backends can be checked.
+//
+#ifndef __AmoreRunAction_hh__
+#define __AmoreRunAction_hh__ 1
+
+#include "CupSim/CupRunAction.hh"
+#include "globals.hh"
+
+#include <chrono>
+#include <vector>
+
+class G4Run;
+class AmoreRootNtuple;
+
+class AmoreRunAction : public CupRunAction {
+  public:
+    AmoreRunAction(AmoreRootNtuple *aRecorder);
+    virtual ~AmoreRunAction(){};
+
+    virtual void BeginOfRunAction(const G4Run *aRun);
+    virtual void EndOfRunAction(const G4Run *aRun);
+
+    // Called by AmoreEventAction at the end of each event with the time spent in it
+    static void AddEventTime(G4double aSeconds) {
+        fgBusyTime += aSeconds;
+        fgEventCount++;
+    }
+
+    static void SetReportThreadLoad(G4bool a) { fgReportThreadLoad = a; }
+    static G4bool GetReportThreadLoad() { return fgReportThreadLoad; }
+
+  private:
+    struct ThreadLoad {
+        G4int fThreadID;
+        G4int fEventCount;
+        G4double fBusyTime;
+    };
+
+    void PrintThreadLoads(G4double aWallTime) const;
+
+    std::chrono::steady_clock::time_point fRunStart;
+
+    static std::vector<ThreadLoad> fgThreadLoads;
+    static G4ThreadLocal G4double fgBusyTime;
+    static G4ThreadLocal G4int fgEventCount;
+    static G4bool fgReportThreadLoad;
+};
+
+#endif
@@ -0,0 +1,34 @@
+//
+// AmoreRunMessenger.hh
+//
+// UI commands for the run manager backend of amoresim (/amore/run/).
+//
+#ifndef __AmoreRunMessenger_hh__
+#define __AmoreRunMessenger_hh__ 1
+
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class G4UIcommand;
+class G4UIdirectory;
+class G4RunManager;
+
+class AmoreRunMessenger : public G4UImessenger {
+  public:
+    AmoreRunMessenger(G4RunManager *aRunManager);
+    ~AmoreRunMessenger();
+
+    void SetNewValue(G4UIcommand *command, G4String newValues);
+    G4String GetCurrentValue(G4UIcommand *command);
+
+  private:
+    G4RunManager *fRunManager;
+    G4int fEventsPerTask;
+
+    G4UIdirectory *fAmoreDir;
+    G4UIdirectory *fRunDir;
+    G4UIcommand *fEventsPerTaskCmd;
+    G4UIcommand *fReportThreadLoadCmd;
+};
+
+#endif
@@ -3,7 +3,12 @@
 
 #include "CupSim/CupScintSD.hh"
 
+#include <unordered_set>
+
+class G4HCofThisEvent;
+class G4ParticleDefinition;
 class G4TouchableHistory;
+class G4VPhysicalVolume;
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo....
 
@@ -13,7 +18,15 @@ class AmoreScintSD : public CupScintSD {
     ~AmoreScintSD();
 
   public:
+    virtual void Initialize(G4HCofThisEvent *HCE);
     virtual G4bool ProcessHits(G4Step *aStep, G4TouchableHistory *ROhist);
+
+  private:
+    const G4ParticleDefinition *fOpticalPhoton;
+    // PVs with "Envelope" in their names, whose copy number is the one of their daughter cells.
+    // Collected at the first event, since the SD is made before the geometry is complete.
+    std::unordered_set<const G4VPhysicalVolume *> fEnvelopePVs;
+    G4bool fEnvelopesCollected;
 };
 
 #endif
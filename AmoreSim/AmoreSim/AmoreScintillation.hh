@@ -2,6 +2,11 @@
 #define AmoreScintillation_h 1
 
 #include "CupSim/CupScintillation.hh"
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
+
+#include <cmath>
+#include <vector>
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo....
 
@@ -13,11 +18,57 @@ class AmoreScintillation : public CupScintillation {
 
   public:
     G4VParticleChange *PostStepDoIt(const G4Track &aTrack, const G4Step &aStep);
+    // Also takes the material properties used by PostStepDoIt
+    void BuildPhysicsTable(const G4ParticleDefinition &aParticleType);
 
     static G4double GetTotEdepQuenched() { return TotalEnergyDepositQuenched; }
 
   private:
-    static G4double TotalEnergyDepositQuenched;
+    // Yield vectors of /process/optical/scintillation by particle type
+    enum eYieldType {
+        kProtonYield,
+        kDeuteronYield,
+        kTritonYield,
+        kAlphaYield,
+        kIonYield,
+        kElectronYield,
+        kNYieldTypes
+    };
+    // The properties of one material, so that no property is looked up by name per step.
+    // Missing constants are NaN and are looked up again when used, so the table reports them.
+    struct MaterialParameters {
+        const G4MaterialPropertiesTable *fTable               = nullptr; // Null if no scintillation
+        G4MaterialPropertyVector *fFastIntensity              = nullptr;
+        G4MaterialPropertyVector *fSlowIntensity              = nullptr;
+        G4MaterialPropertyVector *fYieldVectors[kNYieldTypes] = {}; // Electron one if not given
+
+        G4double fYield           = 0.;
+        G4double fResolutionScale = 0.;
+        G4double fYieldRatio      = 0.;
+        G4double fFastTime        = 0.;
+        G4double fSlowTime        = 0.;
+        G4double fFastRiseTime    = 0.;
+        G4double fSlowRiseTime    = 0.;
+
+        inline G4double Get(G4double aValue, const char *aKey) const {
+            return std::isnan(aValue) ? fTable->GetConstProperty(aKey) : aValue;
+        }
+    };
+
+    void BuildMaterialParameters();
+    inline const MaterialParameters *GetMaterialParameters(const G4Material *aMaterial) {
+        if (aMaterial->GetIndex() >= fMaterialParameters.size()) BuildMaterialParameters();
+        const MaterialParameters &nowParameters = fMaterialParameters[aMaterial->GetIndex()];
+        return nowParameters.fTable != nullptr ? &nowParameters : nullptr;
+    }
+    eYieldType GetYieldType(const G4ParticleDefinition *aParticle);
+
+    std::vector<MaterialParameters> fMaterialParameters; // By material index
+    const G4ParticleDefinition *fLastParticle;
+    eYieldType fLastYieldType;
+
+    // Quenched deposit of the last step handed to AmoreScintSD; one copy per worker thread
+    static G4ThreadLocal G4double TotalEnergyDepositQuenched;
 };
 
 #endif
@@ -0,0 +1,34 @@
+//
+// AmoreStackingAction.hh
+//
+// Moves secondaries of huge events to sub-events (see AmoreSubEventManager) and pushes the
+// bundles nobody has picked up back to the stack when the stack of the event runs dry.
+//
+#ifndef AmoreStackingAction_h
+#define AmoreStackingAction_h 1
+
+#include "G4UserStackingAction.hh"
+#include "globals.hh"
+
+class G4ParticleDefinition;
+class AmoreSubEventManager;
+
+class AmoreStackingAction : public G4UserStackingAction {
+  public:
+    AmoreStackingAction();
+    virtual ~AmoreStackingAction(){};
+
+    virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track *aTrack);
+    virtual void NewStage();
+    virtual void PrepareNewEvent();
+
+  private:
+    AmoreSubEventManager *fSubEventManager;
+    const G4ParticleDefinition *fOpticalPhoton;
+    G4int fNewTracks;
+    G4bool fOffloadEvent; // Sub-event mode is on and this event is not a sub-event itself
+    G4bool fReclaiming;
+    G4bool fHasWaitingTrack; // A track of this stage is on the waiting stack
+};
+
+#endif
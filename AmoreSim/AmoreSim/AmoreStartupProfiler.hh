@@ -0,0 +1,70 @@
+//
+// AmoreStartupProfiler.hh
+//
+// Records the wall time and the peak RSS of the startup stages of amoresim.
+// A stage is timed by a Scope object living for the duration of the stage:
+//
+//     AmoreStartupProfiler::Scope nowScope("ConstructMaterials");
+//
+// Stages of the master thread nest as the scopes do. /run/initialize and the initialization
+// of the first run, where Geant4 builds the physics tables and voxelizes the geometry, are
+// timed through the application state changes. The report is written in JSON next to the
+// output file when it is closed.
+//
+#ifndef __AmoreStartupProfiler_hh__
+#define __AmoreStartupProfiler_hh__ 1
+
+#include "G4VStateDependent.hh"
+#include "globals.hh"
+
+#include <chrono>
+#include <vector>
+
+class AmoreStartupProfiler : public G4VStateDependent {
+  public:
+    class Scope {
+      public:
+        explicit Scope(const G4String &aName)
+            : fIndex(AmoreStartupProfiler::GetInstance()->Begin(aName)) {}
+        ~Scope() { AmoreStartupProfiler::GetInstance()->End(fIndex); }
+
+      private:
+        G4int fIndex;
+    };
+
+    // The first call has to be made on the master thread
+    static AmoreStartupProfiler *GetInstance();
+
+    G4int Begin(const G4String &aName);
+    void End(G4int aIndex);
+
+    void WriteReport(const G4String &aFileName) const;
+
+    virtual G4bool Notify(G4ApplicationState requestedState);
+
+  private:
+    AmoreStartupProfiler();
+    virtual ~AmoreStartupProfiler(){};
+
+    struct Stage {
+        G4String fName;
+        G4int fThreadID; // -1 for the master thread
+        G4int fDepth;
+        G4double fStart; // [s] since the start of the job
+        G4double fWallTime; // [s], negative while the stage is open
+        G4double fPeakRSS; // [MB] at the end of the stage
+    };
+
+    G4double SecondsSinceStart() const;
+
+    std::chrono::steady_clock::time_point fStartTime;
+    std::vector<Stage> fStages;
+    G4int fOpenDepth;
+    G4int fInitializeStage;
+    G4int fRunInitStage;
+    G4bool fRunInitDone;
+
+    static AmoreStartupProfiler *fgInstance;
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// AmoreStepFilter.hh
+//
+// Selection of the recorded steps (/ntuple/stepFilter/). A step is recorded if
+//   - its volume is one of the given volumes, inside one of them, or in one of the given
+//     regions (any volume if none is given),
+//   - its particle is one of the given particles (any particle if none is given),
+//   - its energy deposit is at least the minimum.
+// The names are resolved once per thread against AmoreVolumeTable, so a step is judged with
+// pointer lookups only.
+//
+#ifndef __AmoreStepFilter_hh__
+#define __AmoreStepFilter_hh__ 1
+
+#include "globals.hh"
+
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+class G4LogicalVolume;
+class G4ParticleDefinition;
+class G4Step;
+class AmoreVolumeTable;
+
+class AmoreStepFilter {
+  public:
+    AmoreStepFilter() : fMinEdep(0.), fResolved(false){};
+    ~AmoreStepFilter(){};
+
+    void AddVolume(const G4String &aName);
+    void AddRegion(const G4String &aName);
+    void AddParticle(const G4String &aName);
+    void SetMinEnergyDeposit(G4double aEdep);
+    inline G4double GetMinEnergyDeposit() const { return fMinEdep; }
+    void Clear();
+    void Print() const;
+
+    inline G4bool IsActive() const {
+        return fMinEdep > 0. || !fVolumeNames.empty() || !fRegionNames.empty() ||
+               !fParticleNames.empty();
+    }
+    G4bool Accept(const G4Step *aStep, AmoreVolumeTable &aVolumeTable);
+
+  private:
+    void Resolve(AmoreVolumeTable &aVolumeTable);
+    void AcceptInside(const G4LogicalVolume *aLV, AmoreVolumeTable &aVolumeTable,
+                      std::set<const G4LogicalVolume *> &aDone);
+
+    std::set<G4String> fVolumeNames;
+    std::set<G4String> fRegionNames;
+    std::set<G4String> fParticleNames;
+    G4double fMinEdep;
+
+    // Resolved names, indexed by the IDs of AmoreVolumeTable
+    G4bool fResolved;
+    std::vector<char> fAcceptedVolumes;
+    std::unordered_set<const G4ParticleDefinition *> fAcceptedParticles;
+};
+
+#endif
@@ -0,0 +1,149 @@
+//
+// AmoreSubEventManager.hh
+//
+// Sub-event parallelism for events with a huge number of secondaries (muon showers).
+//
+// Once an event has put more than a threshold of non-optical tracks on its stack,
+// AmoreStackingAction takes the following secondaries off the stack and packs them into
+// bundles. Worker threads without events of their own pick the bundles up and track them as
+// sub-events (see AmoreWorkerRunManager). At the end of the parent event, AmoreEventAction
+// waits for the sub-events and merges their MDSD/TGSD hits and EndTrack records into the
+// parent before it is recorded. Bundles nobody has picked up when the stack of the parent
+// runs dry are pushed back to the parent's own stack.
+//
+// Only the module (MDSD) and target (TGSD) hit collections and the EndTrack list are merged.
+// Step/track arrays, photon/scintillation counters, muon SD hits and primary-at-border
+// records of offloaded tracks are not kept.
+//
+#ifndef __AmoreSubEventManager_hh__
+#define __AmoreSubEventManager_hh__ 1
+
+#include "G4ThreeVector.hh"
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class G4Event;
+class G4LogicalVolume;
+class G4ParticleDefinition;
+class G4Track;
+class G4UIcommand;
+class G4UIdirectory;
+class TTrack;
+
+// A secondary taken off the stack of the parent event
+struct AmoreSubEventTrack {
+    const G4ParticleDefinition *fDefinition;
+    const G4ParticleDefinition *fMotherDefinition;
+    G4ThreeVector fPosition;
+    G4ThreeVector fMomentumDirection;
+    G4ThreeVector fPolarization;
+    G4double fKineticEnergy;
+    G4double fGlobalTime;
+    G4double fWeight;
+    G4int fTrackID;
+    G4int fParentID;
+};
+
+struct AmoreSubEventModuleDeposit {
+    G4double fCrystalEdep;
+    G4double fCrystalQEdep;
+    G4double fGeWaferEdep;
+    G4double fGeWaferQEdep;
+    std::vector<G4double> fCrystalGoldFilmEdep;
+    std::vector<G4double> fGeWaferGoldFilmEdep;
+};
+
+struct AmoreSubEventCellDeposit {
+    const G4LogicalVolume *fLogV;
+    G4double fEdep;
+    G4double fEdepQuenched;
+};
+
+struct AmoreSubEventBundle {
+    enum eState { kOpen, kPending, kRunning, kDone, kReclaimed };
+
+    eState fState;
+    G4int fParentEventID;
+    // Track IDs of the sub-event above the number of its primaries are shifted by this offset
+    G4int fTrackIDOffset;
+    std::vector<AmoreSubEventTrack> fTracks;
+
+    // Results, filled by the thread which has tracked the bundle
+    std::vector<AmoreSubEventModuleDeposit> fModuleDeposits;
+    std::vector<AmoreSubEventCellDeposit> fCellDeposits;
+    std::vector<TTrack *> fEndTracks;
+};
+
+class AmoreSubEventManager : public G4UImessenger {
+  public:
+    static AmoreSubEventManager *GetInstance();
+    ~AmoreSubEventManager();
+
+    virtual void SetNewValue(G4UIcommand *command, G4String newValue);
+    virtual G4String GetCurrentValue(G4UIcommand *command);
+
+    // Set by main() when the worker run managers are able to process sub-events
+    inline void SetWorkerSupport(G4bool a) { fWorkerSupport = a; }
+    inline G4bool IsEnabled() const { return fEnabled; }
+    inline G4int GetThreshold() const { return fThreshold; }
+
+    // The sub-event which is being tracked by this thread, nullptr for ordinary events
+    static inline AmoreSubEventBundle *GetCurrentSubEvent() { return fgCurrentSubEvent; }
+    static inline void SetCurrentSubEvent(AmoreSubEventBundle *a) { fgCurrentSubEvent = a; }
+
+    // Parent side. These are called on the thread processing the parent event.
+    void BeginParentEvent(const G4Event *aEvent);
+    G4bool Offload(const G4Track *aTrack);
+    void FlushOpenBundle();
+    void ReclaimPending(std::vector<AmoreSubEventTrack> &aTracks);
+    void EndParentEvent(const G4Event *aEvent, std::vector<TTrack *> *aEndTracks);
+
+    // Sub-event side
+    std::shared_ptr<AmoreSubEventBundle> ClaimBundle(G4bool aWait);
+    void FinishSubEvent(const G4Event *aEvent, std::vector<TTrack *> *aEndTracks);
+
+    // Track IDs of the n-th bundle of an event start from kTrackIDBase + n * kTrackIDStride
+    enum { kTrackIDBase = 100000000, kTrackIDStride = 10000000, kMaxBundlesLimit = 200 };
+
+  private:
+    AmoreSubEventManager();
+
+    struct ParentContext {
+        G4bool fActive;
+        G4int fEventID;
+        std::shared_ptr<AmoreSubEventBundle> fOpenBundle;
+        std::vector<std::shared_ptr<AmoreSubEventBundle>> fBundles;
+    };
+    static ParentContext &GetParentContext();
+    void MergeResults(const G4Event *aEvent, AmoreSubEventBundle &aBundle,
+                      std::vector<TTrack *> *aEndTracks);
+
+    static AmoreSubEventManager *fgInstance;
+    static G4ThreadLocal ParentContext *fgParent;
+    static G4ThreadLocal AmoreSubEventBundle *fgCurrentSubEvent;
+
+    G4bool fEnabled;
+    G4bool fWorkerSupport;
+    G4int fThreshold;
+    G4int fBundleSize;
+    G4int fMaxBundles;
+
+    std::mutex fMutex;
+    std::condition_variable fCondition;
+    std::deque<std::shared_ptr<AmoreSubEventBundle>> fPending;
+    G4int fActiveParents;
+
+    G4UIdirectory *fSubEventDir;
+    G4UIcommand *fEnableCmd;
+    G4UIcommand *fThresholdCmd;
+    G4UIcommand *fBundleSizeCmd;
+    G4UIcommand *fMaxBundlesCmd;
+};
+
+#endif
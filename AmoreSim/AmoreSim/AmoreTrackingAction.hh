@@ -36,6 +36,7 @@
 #include "globals.hh"
 
 class CupRecorderBase;
+class G4ParticleDefinition;
 
 class AmoreTrackingAction : public CupTrackingAction {
 
@@ -49,6 +50,7 @@ class AmoreTrackingAction : public CupTrackingAction {
   private:
     unsigned long tracknum;
     AmoreRootNtuple *recorder;
+    const G4ParticleDefinition *fOpticalPhoton;
     G4TrackingManager *fManager;
 };
 
@@ -0,0 +1,109 @@
+//
+// AmoreVolumeTable.hh
+//
+// Flat table of the physical volumes for the per-step lookups of the recorder.
+// It is built once per thread at the start of the first event, and afterwards a volume is
+// found by its pointer only. Each entry has
+//   ID       : index of the volume in the physical volume store
+//   NameID   : index of the volume name in VolTbl (BirthPVIdx of the primary records)
+//   ModuleID : detector module the volume belongs to, -1 if none or if shared by modules
+//   Flags    : bit set of eVolumeFlag
+//   CopyFrom : 0 own copy number, 1 mother's (physCMOCell of AMoRE-200),
+//              2 envelope's at the root of the region (*_Crystal_PV of AMoRE-I)
+// The table is written to the output file as the tree VolumeTable.
+//
+#ifndef __AmoreVolumeTable_hh__
+#define __AmoreVolumeTable_hh__ 1
+
+#include "G4TouchableHandle.hh"
+#include "globals.hh"
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class G4LogicalVolume;
+class G4Step;
+class G4VPhysicalVolume;
+class AmoreDetectorConstruction;
+
+class AmoreVolumeTable {
+  public:
+    enum eVolumeFlag {
+        kSensitive       = 1 << 0, // The logical volume has a sensitive detector
+        kWorldRegion     = 1 << 1, // In the default region of the world
+        kModule          = 1 << 2, // Envelope of a detector module
+        kInsideCavern    = 1 << 3, // The cavern or a volume inside it
+        kInsideOVC       = 1 << 4, // The OVC of AMoRE-200 or a volume inside it
+        kCavernAmbiguous = 1 << 5, // Placed both inside and outside of the cavern
+        kOVCAmbiguous    = 1 << 6  // Placed both inside and outside of the OVC
+    };
+    enum eCopyFrom { kOwnCopy = 0, kMotherCopy = 1, kEnvelopeCopy = 2 };
+
+    struct Entry {
+        G4int fID;
+        G4int fNameID;
+        G4int fModuleID;
+        G4int fFlags;
+        G4int fCopyFrom;
+        G4int fCopyLevel;   // Touchable level of the copy number, -1 until the first use
+        size_t fCopyNameAt; // Where "_<copy>" goes into the name for kEnvelopeCopy
+    };
+
+    AmoreVolumeTable() : fDetCons(nullptr), fCavernPV(nullptr), fOVCPV(nullptr){};
+    ~AmoreVolumeTable(){};
+
+    void Build(const AmoreDetectorConstruction *aDetCons);
+    inline G4bool IsBuilt() const { return !fEntries.empty(); }
+
+    // nullptr for volumes created after Build()
+    inline Entry *Find(const G4VPhysicalVolume *aVolume) {
+        auto found = fIDs.find(aVolume);
+        return (found != fIDs.end()) ? &fEntries[found->second] : nullptr;
+    }
+    inline const std::map<std::string, int> &GetNameIDs() const { return fNameIDs; }
+    inline size_t GetNVolumes() const { return fVolumes.size(); }
+    inline const G4VPhysicalVolume *GetVolume(G4int aID) const { return fVolumes[aID]; }
+
+    G4int GetCopyNo(Entry &aEntry, const G4TouchableHandle &aTouchable);
+    // Volume name of TStep, e.g. physCMOCell3 or M_2_Crystal_PV
+    G4String GetStepVolumeName(const G4VPhysicalVolume *aVolume,
+                               const G4TouchableHandle &aTouchable);
+
+    // Same as Judge_CavernBorder and Judge_200_OVCBorder of AmoreDetectorConstruction
+    inline G4bool EntersCavern(const G4Step *aStep) {
+        return EntersBorder(aStep, fCavernPV, kInsideCavern, kCavernAmbiguous);
+    }
+    inline G4bool EntersOVC(const G4Step *aStep) {
+        return EntersBorder(aStep, fOVCPV, kInsideOVC, kOVCAmbiguous);
+    }
+
+    // Writes the table to the current directory
+    void Write() const;
+    // Merged files have one table per part. Keeps the first one.
+    static G4bool Deduplicate(const G4String &aFileName);
+
+  private:
+    G4bool EntersBorder(const G4Step *aStep, const G4VPhysicalVolume *aBorderPV,
+                        G4int aInsideFlag, G4int aAmbiguousFlag);
+    void MarkInside(const G4LogicalVolume *aLV, G4int aFlag,
+                    std::set<const G4LogicalVolume *> &aDone);
+    void MarkOutside(const G4LogicalVolume *aLV, const G4VPhysicalVolume *aBorderPV,
+                     G4int aInsideFlag, G4int aAmbiguousFlag,
+                     std::set<const G4LogicalVolume *> &aDone);
+    void MarkModule(const G4LogicalVolume *aLV, G4int aModuleID,
+                    std::set<const G4LogicalVolume *> &aDone);
+
+    const AmoreDetectorConstruction *fDetCons;
+    const G4VPhysicalVolume *fCavernPV;
+    const G4VPhysicalVolume *fOVCPV;
+
+    std::unordered_map<const G4VPhysicalVolume *, G4int> fIDs;
+    std::vector<const G4VPhysicalVolume *> fVolumes;
+    std::vector<Entry> fEntries;
+    std::map<std::string, int> fNameIDs;
+};
+
+#endif
@@ -0,0 +1,50 @@
+//
+// AmoreWorkerRunManager.hh
+//
+// Worker run manager of the MT backend which also processes sub-events (see
+// AmoreSubEventManager). Waiting sub-events are taken before new events of the run, and a
+// worker which has run out of events keeps tracking sub-events as long as another worker is
+// still busy with an event which can hand them out.
+//
+#ifndef __AmoreWorkerRunManager_hh__
+#define __AmoreWorkerRunManager_hh__ 1
+
+#include "G4Version.hh"
+
+#if G4VERSION_NUMBER >= 1000
+
+#include "G4UserWorkerThreadInitialization.hh"
+#include "G4WorkerRunManager.hh"
+#include "globals.hh"
+
+#include <memory>
+
+struct AmoreSubEventBundle;
+
+class AmoreWorkerRunManager : public G4WorkerRunManager {
+  public:
+    AmoreWorkerRunManager();
+    virtual ~AmoreWorkerRunManager(){};
+
+    virtual void DoEventLoop(G4int n_event, const char *macroFile = 0, G4int n_select = -1);
+    virtual G4Event *GenerateEvent(G4int i_event);
+    // Sub-events are not events of the run and are not counted in it
+    virtual void AnalyzeEvent(G4Event *anEvent);
+
+  private:
+    G4Event *BuildSubEvent();
+
+    std::shared_ptr<AmoreSubEventBundle> fSubEvent;
+    G4bool fMasterEventsDone;
+};
+
+class AmoreWorkerThreadInitialization : public G4UserWorkerThreadInitialization {
+  public:
+    virtual G4WorkerRunManager *CreateWorkerRunManager() const {
+        return new AmoreWorkerRunManager;
+    }
+};
+
+#endif
+
+#endif
@@ -4,22 +4,32 @@
 
 #include "AmoreSim/AmoreActionInitialization.hh"
 #include "CupSim/CupPrimaryGeneratorAction.hh"
-#include "CupSim/CupRunAction.hh"
 #include "AmoreSim/AmoreSteppingAction.hh"
 #include "AmoreSim/AmoreTrackingAction.hh"
 #include "AmoreSim/AmoreEventAction.hh"
+#include "AmoreSim/AmoreRootNtuple.hh"
+#include "AmoreSim/AmoreRunAction.hh"
+#include "AmoreSim/AmoreStackingAction.hh"
+
+#include "G4Threading.hh"
 
 void AmoreActionInitialization::BuildForMaster() const {
-    SetUserAction(new CupRunAction(fRecorders));
+    SetUserAction(new AmoreRunAction(fRecorders));
 }
 
 void AmoreActionInitialization::Build() const {
+    // Worker threads get their own recorder which is owned by the event action of the thread.
+    // In the sequential mode the recorder given by main() is used directly.
+    G4bool isWorker              = G4Threading::IsWorkerThread();
+    AmoreRootNtuple *nowRecorder = isWorker ? fRecorders->CreateWorkerRecorder() : fRecorders;
+
     auto p = new CupPrimaryGeneratorAction(fDetConstruction);
     SetUserAction(p);
-    SetUserAction(new CupRunAction(fRecorders));
-    SetUserAction(new AmoreEventAction(fRecorders));
-    SetUserAction(new AmoreTrackingAction(fRecorders));
-    SetUserAction(new AmoreSteppingAction(fRecorders, p));
+    SetUserAction(new AmoreRunAction(nowRecorder));
+    SetUserAction(new AmoreEventAction(nowRecorder, isWorker));
+    SetUserAction(new AmoreTrackingAction(nowRecorder));
+    SetUserAction(new AmoreSteppingAction(nowRecorder, p));
+    SetUserAction(new AmoreStackingAction);
 }
 
 #endif
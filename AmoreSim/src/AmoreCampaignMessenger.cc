@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////
+// AmoreCampaignMessenger
+////////////////////////////////////////////////////////////////
+
+#include "AmoreSim/AmoreCampaignMessenger.hh"
+#include "AmoreSim/AmoreRootNtuple.hh"
+
+#include "G4UIcommand.hh"
+#include "G4UIcommandStatus.hh"
+#include "G4UIdirectory.hh"
+#include "G4UImanager.hh"
+#include "G4ios.hh"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+    // The generator and the vertex of the decay macros (mac/*_dc_*.mac)
+    const char *kRatesCommand  = "/generator/rates 3 ";
+    const char *kVertexCommand = "/generator/vtx/set 17 ";
+} // namespace
+
+AmoreCampaignMessenger::AmoreCampaignMessenger(AmoreRootNtuple *aRecorder)
+    : fRecorder(aRecorder) {
+    fCampaignDir = new G4UIdirectory("/amore/campaign/");
+    fCampaignDir->SetGuidance("Run decays of several isotopes in one job.");
+    fCampaignDir->SetGuidance("Every segment is a run with its own output file, and the geometry");
+    fCampaignDir->SetGuidance("and the physics are initialized only once for all segments.");
+
+    fAddCmd = new G4UIcommand("/amore/campaign/add", this);
+    fAddCmd->SetGuidance("Add a segment to the campaign.");
+    fAddCmd->SetGuidance("The output of the segment is <output>_<label>.");
+    fAddCmd->SetGuidance("The label is the isotope, followed by the excitation level if any.");
+    fAddCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fAddCmd->SetParameter(new G4UIparameter("isotope", 's', false));
+    G4UIparameter *nowParam = new G4UIparameter("excitation", 'd', false);
+    nowParam->SetGuidance("Excitation level in MeV");
+    nowParam->SetParameterRange("excitation >= 0");
+    fAddCmd->SetParameter(nowParam);
+    nowParam = new G4UIparameter("rate", 'd', false);
+    nowParam->SetGuidance("Decay rate (ln2/half life) in Hz");
+    nowParam->SetParameterRange("rate > 0");
+    fAddCmd->SetParameter(nowParam);
+    nowParam = new G4UIparameter("events", 'i', false);
+    nowParam->SetParameterRange("events > 0");
+    fAddCmd->SetParameter(nowParam);
+    fAddCmd->SetParameter(new G4UIparameter("label", 's', true));
+
+    fLoadCmd = new G4UIcommand("/amore/campaign/load", this);
+    fLoadCmd->SetGuidance("Add the segments listed in a file.");
+    fLoadCmd->SetGuidance("Each line is \"isotope excitation rate events [label]\" as for add.");
+    fLoadCmd->SetGuidance("Empty lines and lines starting with # are skipped.");
+    fLoadCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fLoadCmd->SetParameter(new G4UIparameter("file", 's', false));
+
+    fOutputCmd = new G4UIcommand("/amore/campaign/output", this);
+    fOutputCmd->SetGuidance("Set the base name of the segment outputs.");
+    fOutputCmd->SetGuidance("By default the name given by /event/output_file is used.");
+    fOutputCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fOutputCmd->SetParameter(new G4UIparameter("base", 's', false));
+
+    fListCmd = new G4UIcommand("/amore/campaign/list", this);
+    fListCmd->SetGuidance("Print the segments of the campaign.");
+
+    fClearCmd = new G4UIcommand("/amore/campaign/clear", this);
+    fClearCmd->SetGuidance("Remove every segment of the campaign.");
+    fClearCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    fRunCmd = new G4UIcommand("/amore/campaign/run", this);
+    fRunCmd->SetGuidance("Run the segments one after another.");
+    fRunCmd->SetGuidance("Each one sets /generator/rates 3 and /generator/vtx/set 17 like the");
+    fRunCmd->SetGuidance("decay macros, opens its output file and calls /run/beamOn.");
+    fRunCmd->AvailableForStates(G4State_Idle);
+}
+
+AmoreCampaignMessenger::~AmoreCampaignMessenger() {
+    delete fAddCmd;
+    delete fLoadCmd;
+    delete fOutputCmd;
+    delete fListCmd;
+    delete fClearCmd;
+    delete fRunCmd;
+    delete fCampaignDir;
+}
+
+void AmoreCampaignMessenger::SetNewValue(G4UIcommand *command, G4String newValues) {
+    if (command == fAddCmd) {
+        AddSegment(newValues);
+    } else if (command == fLoadCmd) {
+        LoadSegments(newValues);
+    } else if (command == fOutputCmd) {
+        fOutputBaseName = newValues;
+    } else if (command == fListCmd) {
+        PrintSegments();
+    } else if (command == fClearCmd) {
+        fSegments.clear();
+    } else if (command == fRunCmd) {
+        RunCampaign();
+    }
+}
+
+G4String AmoreCampaignMessenger::GetCurrentValue(G4UIcommand *command) {
+    if (command == fOutputCmd) return fOutputBaseName;
+    return G4String();
+}
+
+G4bool AmoreCampaignMessenger::AddSegment(const G4String &aLine) {
+    std::istringstream line(aLine);
+    Segment newSegment;
+    G4String excitationText;
+    line >> newSegment.fIsotope >> excitationText >> newSegment.fRate >> newSegment.fNEvents;
+    if (line.fail() || newSegment.fRate <= 0 || newSegment.fNEvents <= 0) {
+        G4Exception(__PRETTY_FUNCTION__, "CAMPAIGN_BADSEGMENT", JustWarning,
+                    ("Invalid campaign segment \"" + aLine + "\"").c_str());
+        return false;
+    }
+    newSegment.fExcitation = StoD(excitationText);
+    if (!(line >> newSegment.fLabel)) {
+        newSegment.fLabel = newSegment.fIsotope;
+        if (newSegment.fExcitation > 0) newSegment.fLabel += "_" + excitationText;
+    }
+    fSegments.push_back(newSegment);
+    return true;
+}
+
+G4bool AmoreCampaignMessenger::LoadSegments(const G4String &aFileName) {
+    std::ifstream listFile(aFileName.c_str());
+    if (!listFile) {
+        G4Exception(__PRETTY_FUNCTION__, "CAMPAIGN_NOFILE", JustWarning,
+                    ("Cannot open the campaign list " + aFileName).c_str());
+        return false;
+    }
+    G4bool allAdded = true;
+    std::string nowLine;
+    while (std::getline(listFile, nowLine)) {
+        size_t firstChar = nowLine.find_first_not_of(" \t\r");
+        if (firstChar == std::string::npos || nowLine[firstChar] == '#') continue;
+        allAdded = AddSegment(nowLine) && allAdded;
+    }
+    return allAdded;
+}
+
+void AmoreCampaignMessenger::PrintSegments() const {
+    G4cout << "Campaign of " << fSegments.size() << " segments:" << G4endl;
+    for (const auto &nowSegment : fSegments)
+        G4cout << "  " << nowSegment.fLabel << ": " << nowSegment.fIsotope << " at "
+               << nowSegment.fExcitation << " MeV, " << nowSegment.fRate << " Hz, "
+               << nowSegment.fNEvents << " events" << G4endl;
+}
+
+// In the fork mode the first /run/beamOn forks the children, which go on with this loop on
+// their own. The parent only collects the output names and merges them at the end of the job.
+void AmoreCampaignMessenger::RunCampaign() {
+    G4String outputBase =
+        fOutputBaseName.empty() ? fRecorder->GetOutputBaseName() : fOutputBaseName;
+    if (fSegments.empty() || outputBase.empty()) {
+        G4Exception(__PRETTY_FUNCTION__, "CAMPAIGN_EMPTY", JustWarning,
+                    "The campaign needs segments and an output name "
+                    "(/amore/campaign/output before the first run).");
+        return;
+    }
+
+    G4UImanager *UImanager = G4UImanager::GetUIpointer();
+    for (size_t i = 0; i < fSegments.size(); i++) {
+        const Segment &nowSegment = fSegments[i];
+        G4cout << "Campaign segment " << i + 1 << "/" << fSegments.size() << ": "
+               << nowSegment.fLabel << G4endl;
+
+        std::ostringstream vertex;
+        vertex.precision(10);
+        vertex << "\"" << nowSegment.fIsotope << " " << nowSegment.fExcitation << " 0 0 0  0\"";
+        std::vector<G4String> commands = {
+            "/event/output_file " + outputBase + "_" + nowSegment.fLabel,
+            kRatesCommand + DtoS(nowSegment.fRate), kVertexCommand + vertex.str(),
+            "/run/beamOn " + ItoS(nowSegment.fNEvents)};
+
+        // The previous segment is finished, so its file is closed (and merged in MT mode)
+        if (!fRecorder->IsForkParent()) fRecorder->CloseFile();
+        for (const auto &nowCommand : commands) {
+            if (UImanager->ApplyCommand(nowCommand) != fCommandSucceeded) {
+                G4Exception(__PRETTY_FUNCTION__, "CAMPAIGN_FAIL", JustWarning,
+                            ("\"" + nowCommand + "\" has been failed. Stopping the campaign.")
+                                .c_str());
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include "AmoreSim/AmoreCompactStep.hh"
+#include "AmoreSim/AmoreHash.hh"
+#include "AmoreSim/AmoreVolumeTable.hh"
+
+#include "G4IonTable.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ProcessTable.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VProcess.hh"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+    // ID -> name of one dictionary tree
+    using DictionaryEntries = std::map<G4int, std::string>;
+
+    struct DictionaryTree {
+        const char *fName;
+        const char *fTitle;
+    };
+    const DictionaryTree kParticleTree = {"StepParticles", "PDG code -> particle name"};
+    const DictionaryTree kProcessTree  = {"StepProcesses", "Process ID -> process name"};
+
+    void WriteDictionary(const DictionaryTree &aTree, const DictionaryEntries &aEntries) {
+        Int_t id = 0;
+        std::string name;
+        TTree *tree = new TTree(aTree.fName, aTree.fTitle);
+        tree->Branch("ID", &id, "ID/I");
+        tree->Branch("Name", &name);
+        for (auto &nowEntry : aEntries) {
+            id   = nowEntry.first;
+            name = nowEntry.second;
+            tree->Fill();
+        }
+        tree->Write();
+        delete tree;
+    }
+} // namespace
+
+void AmoreCompactSteps::Branch(TTree *aTree) {
+    aTree->Branch("CompactStep_TrackID", &fTrackID);
+    aTree->Branch("CompactStep_ParentID", &fParentID);
+    aTree->Branch("CompactStep_StepNo", &fStepNo);
+    aTree->Branch("CompactStep_PDG", &fPDG);
+    aTree->Branch("CompactStep_ProcessID", &fProcessID);
+    aTree->Branch("CompactStep_VolumeID", &fVolumeID);
+    aTree->Branch("CompactStep_CopyNo", &fCopyNo);
+    aTree->Branch("CompactStep_KineticEnergy", &fKineticEnergy);
+    aTree->Branch("CompactStep_EnergyDeposit", &fEnergyDeposit);
+    aTree->Branch("CompactStep_X", &fX);
+    aTree->Branch("CompactStep_Y", &fY);
+    aTree->Branch("CompactStep_Z", &fZ);
+    aTree->Branch("CompactStep_GlobalTime", &fGlobalTime);
+    aTree->Branch("CompactStep_LocalTime", &fLocalTime);
+}
+
+void AmoreCompactSteps::Clear() {
+    fTrackID.clear();
+    fParentID.clear();
+    fStepNo.clear();
+    fPDG.clear();
+    fProcessID.clear();
+    fVolumeID.clear();
+    fCopyNo.clear();
+    fKineticEnergy.clear();
+    fEnergyDeposit.clear();
+    fX.clear();
+    fY.clear();
+    fZ.clear();
+    fGlobalTime.clear();
+    fLocalTime.clear();
+}
+
+// Process names are compared here once, never per step
+void AmoreStepDictionary::Build() {
+    G4ProcTblNameVector *processNames = G4ProcessTable::GetProcessTable()->GetNameList();
+    std::vector<G4String> sortedNames(processNames->begin(), processNames->end());
+    std::sort(sortedNames.begin(), sortedNames.end());
+    sortedNames.erase(std::unique(sortedNames.begin(), sortedNames.end()), sortedNames.end());
+    fProcessIDsByName.clear();
+    fProcessIDs.clear();
+    for (size_t i = 0; i < sortedNames.size(); i++)
+        fProcessIDsByName[sortedNames[i]] = i;
+    fBuilt = true;
+}
+
+// Two ions never share a code. An ion whose code is already taken by another name, which is
+// very unlikely, is moved to the next free code of the excited ions.
+G4int AmoreStepDictionary::GetPDGCode(const G4ParticleDefinition *aParticle) {
+    auto found = fPDGCodes.find(aParticle);
+    if (found != fPDGCodes.end()) return found->second;
+
+    const G4String &name = aParticle->GetParticleName();
+    G4int pdgCode        = aParticle->GetPDGEncoding();
+    if (G4IonTable::IsIon(aParticle)) {
+        auto isTaken = [this, &name](G4int aCode) {
+            auto taken = fParticleNames.find(aCode);
+            return taken != fParticleNames.end() && taken->second != name;
+        };
+        if (pdgCode % 10 == 9 || isTaken(pdgCode)) {
+            pdgCode = kExcitedIonBase + AmoreHash::Digest(name) % kExcitedIonRange;
+            while (isTaken(pdgCode))
+                pdgCode = kExcitedIonBase + (pdgCode - kExcitedIonBase + 1) % kExcitedIonRange;
+        }
+    }
+    fPDGCodes[aParticle]    = pdgCode;
+    fParticleNames[pdgCode] = name;
+    return pdgCode;
+}
+
+G4int AmoreStepDictionary::GetProcessID(const G4VProcess *aProcess) {
+    if (aProcess == nullptr) return -1;
+    auto found = fProcessIDs.find(aProcess);
+    if (found != fProcessIDs.end()) return found->second;
+
+    auto foundName = fProcessIDsByName.find(aProcess->GetProcessName());
+    G4int processID = (foundName != fProcessIDsByName.end()) ? foundName->second : -1;
+    fProcessIDs[aProcess] = processID;
+    return processID;
+}
+
+void AmoreStepDictionary::Fill(const G4Step *aStep, AmoreCompactSteps &aSteps) {
+    const G4Track *theTrack              = aStep->GetTrack();
+    const G4StepPoint *postStep          = aStep->GetPostStepPoint();
+    const G4ThreeVector &pos             = postStep->GetPosition();
+    const G4TouchableHandle &theTouchable = aStep->GetPreStepPoint()->GetTouchableHandle();
+    AmoreVolumeTable::Entry *volumeEntry = fVolumeTable->Find(theTrack->GetVolume());
+
+    aSteps.fTrackID.push_back(theTrack->GetTrackID());
+    aSteps.fParentID.push_back(theTrack->GetParentID());
+    aSteps.fStepNo.push_back(theTrack->GetCurrentStepNumber());
+    aSteps.fPDG.push_back(GetPDGCode(theTrack->GetDefinition()));
+    aSteps.fProcessID.push_back(GetProcessID(postStep->GetProcessDefinedStep()));
+    if (volumeEntry != nullptr) {
+        aSteps.fVolumeID.push_back(volumeEntry->fID);
+        aSteps.fCopyNo.push_back(fVolumeTable->GetCopyNo(*volumeEntry, theTouchable));
+    } else {
+        aSteps.fVolumeID.push_back(-1);
+        aSteps.fCopyNo.push_back(theTouchable->GetCopyNumber());
+    }
+    aSteps.fKineticEnergy.push_back(postStep->GetKineticEnergy());
+    aSteps.fEnergyDeposit.push_back(aStep->GetTotalEnergyDeposit());
+    aSteps.fX.push_back(pos.x());
+    aSteps.fY.push_back(pos.y());
+    aSteps.fZ.push_back(pos.z());
+    aSteps.fGlobalTime.push_back(postStep->GetGlobalTime());
+    aSteps.fLocalTime.push_back(postStep->GetLocalTime());
+}
+
+void AmoreStepDictionary::Write() const {
+    DictionaryEntries particles(fParticleNames.begin(), fParticleNames.end()), processes;
+    for (auto &nowProcess : fProcessIDsByName)
+        processes[nowProcess.second] = nowProcess.first;
+    WriteDictionary(kParticleTree, particles);
+    WriteDictionary(kProcessTree, processes);
+}
+
+G4bool AmoreStepDictionary::Deduplicate(const G4String &aFileName) {
+    TFile theFile(aFileName.c_str(), "UPDATE");
+    if (theFile.IsZombie()) return false;
+    for (auto &nowDictionary : {kParticleTree, kProcessTree}) {
+        TTree *nowTree = dynamic_cast<TTree *>(theFile.Get(nowDictionary.fName));
+        if (nowTree == nullptr) continue;
+
+        Int_t id          = 0;
+        std::string *name = nullptr;
+        nowTree->SetBranchAddress("ID", &id);
+        nowTree->SetBranchAddress("Name", &name);
+        DictionaryEntries entries;
+        for (Long64_t i = 0; i < nowTree->GetEntries(); i++) {
+            nowTree->GetEntry(i);
+            entries[id] = *name;
+        }
+        G4bool hasDuplicates = static_cast<size_t>(nowTree->GetEntries()) != entries.size();
+        delete nowTree;
+        delete name;
+        if (!hasDuplicates) continue;
+
+        theFile.Delete((G4String(nowDictionary.fName) + ";*").c_str());
+        theFile.cd();
+        WriteDictionary(nowDictionary, entries);
+    }
+    theFile.Close();
+    return true;
+}
@@ -8,6 +8,8 @@
 #include "CupSim/CupInputDataReader.hh"
 
 #include "AmoreSim/AmoreDetectorMessenger.hh"
+#include "AmoreSim/AmoreOverlapValidator.hh"
+#include "AmoreSim/AmoreStartupProfiler.hh"
 #include "CupSim/CupParam.hh"
 
 #include "G4Box.hh"
@@ -66,7 +68,14 @@ AmoreDetectorConstruction::AmoreDetectorConstruction() : CupDetectorConstruction
     fEnable_NeutronShield = true;
 
     fDbgMsgOn      = true;
-		OverlapCheck  = true;
+		OverlapCheck  = false;
+    fOverlapValidation = false;
+    fOverlapAutoCheck  = true;
+    fOverlapNThreads   = 0;
+    fOverlapResolution = 1000;
+    fOverlapRecordDir  = "overlap_records";
+    fGeomSnapshotOn  = false;
+    fGeomSnapshotDir = "geometry_snapshot";
     fNeutronMode   = false;
 		fRockgammaMode = false;
 
@@ -103,11 +112,13 @@ AmoreDetectorConstruction::AmoreDetectorConstruction() : CupDetectorConstruction
     fI_TopScint_BoxLogical       = nullptr;
     fI_SideFBScint_BoxLogical    = nullptr;
     fI_MufflerFBScint_BoxLogical = nullptr;
+    fI_MufflerLRScint_BoxLogical = nullptr;
     fI_SideLRScint_BoxLogical    = nullptr;
 
     fI_TopScint_FlatTrapLogical             = nullptr;
     fI_SideFBScint_FlatTrapLogical          = nullptr;
     fI_MufflerFBScint_FlatTrapLogical       = nullptr;
+    fI_MufflerLRScint_FlatTrapLogical       = nullptr;
     fI_SideLRScint_FlatTrapLogical          = nullptr;
 
     fI_TopScint_PMTTrapLogical       = nullptr;
@@ -163,6 +174,11 @@ AmoreDetectorConstruction::AmoreDetectorConstruction() : CupDetectorConstruction
     f200_RealPEPhysical       = nullptr;
     f200_VetoMaterialPhysical = nullptr;
     f200_AirBufferPhysical    = nullptr;
+    f200_OVCPhysical          = nullptr;
+
+    fCavernPhysical = nullptr;
+    fRockPhysical   = nullptr;
+    fFloorPhysical  = nullptr;
 }
 
 AmoreDetectorConstruction::~AmoreDetectorConstruction() { delete fPilot_logiCMOCell; }
@@ -193,10 +209,8 @@ G4bool
 }
 
 G4VPhysicalVolume *AmoreDetectorConstruction::Construct() {
-    // make materials if needed
-    if (!materials_built) {
-        ConstructMaterials();
-    }
+    AmoreStartupProfiler::Scope constructScope("Construct");
+    G4bool useSnapshot = fGeomSnapshotOn && whichDetector == kDetector_AmoreDetector;
 
     // delete the old detector if we are constructing a new one
     if (world_phys) {
@@ -204,16 +218,41 @@ G4VPhysicalVolume *AmoreDetectorConstruction::Construct() {
         world_phys = NULL;
     }
 
-    // construct the new detector
-    switch (whichDetector) {
-        case kDetector_AmoreDetector:
-            ConstructAmoreDetector();
-            break;
-        default:
-            CupDetectorConstruction::Construct();
-            break;
+    // restore the world from the snapshot of this configuration if there is one
+    G4bool restored = false;
+    if (useSnapshot) {
+        AmoreStartupProfiler::Scope nowScope("RestoreGeometrySnapshot");
+        restored = RestoreGeometrySnapshot();
     }
+    if (!restored) {
+        // make materials if needed
+        if (!materials_built) {
+            AmoreStartupProfiler::Scope nowScope("ConstructMaterials");
+            ConstructMaterials();
+        }
 
+        // construct the new detector
+        switch (whichDetector) {
+            case kDetector_AmoreDetector:
+                ConstructAmoreDetector();
+                break;
+            default:
+                CupDetectorConstruction::Construct();
+                break;
+        }
+
+        if (useSnapshot && world_phys != nullptr) {
+            AmoreStartupProfiler::Scope nowScope("StoreGeometrySnapshot");
+            StoreGeometrySnapshot();
+        }
+    }
+
+    // check overlaps in validation mode, or if this geometry has not been checked before
+    if (world_phys != nullptr && (fOverlapValidation || fOverlapAutoCheck)) {
+        AmoreStartupProfiler::Scope nowScope("OverlapValidation");
+        AmoreOverlapValidator validator(fOverlapResolution, fOverlapNThreads);
+        validator.Validate(world_phys, fOverlapRecordDir, fOverlapValidation);
+    }
     return world_phys;
 }
 // end of AmoreDetectorConstruction::Construct()
@@ -648,25 +687,38 @@ void AmoreDetectorConstruction::ConstructAmoreDetector() {
     // add spherical-geometry-specific parameters to parameter list
 
     switch (whichDetGeometry) {
-        case kDetector_AMoRE200:
-            if (getenv("AmoreDATA") != NULL)
-                db.ReadFile((G4String(getenv("AmoreDATA")) + "/settings_amore200.dat").c_str());
-            else
-                db.ReadFile("data/settings_amore200.dat");
+        case kDetector_AMoRE200: {
+            {
+                AmoreStartupProfiler::Scope nowScope("CupParam::ReadFile settings_amore200.dat");
+                if (getenv("AmoreDATA") != NULL)
+                    db.ReadFile(
+                        (G4String(getenv("AmoreDATA")) + "/settings_amore200.dat").c_str());
+                else
+                    db.ReadFile("data/settings_amore200.dat");
+            }
+            AmoreStartupProfiler::Scope nowScope("ConstructAMoRE200");
             ConstructAMoRE200();
             break;
-        case kDetector_AMoREPilot:
+        }
+        case kDetector_AMoREPilot: {
+            AmoreStartupProfiler::Scope nowScope("ConstructAMoREPilot");
             ConstructAMoREPilot();
             break;
-        case kDetector_AMoREPilotRUN5:
+        }
+        case kDetector_AMoREPilotRUN5: {
+            AmoreStartupProfiler::Scope nowScope("ConstructAMoREPilotRUN5");
             ConstructAMoREPilotRUN5();
             break;
+        }
         case kDetector_AMoRE_I: {
             using namespace AmoreDetectorStaticInfo::AMoRE_I;
-            if (getenv("AmoreDATA") != NULL)
-                db.ReadFile((G4String(getenv("AmoreDATA")) + "/settings_amoreI.dat").c_str());
-            else
-                db.ReadFile("data/settings_amoreI.dat");
+            {
+                AmoreStartupProfiler::Scope nowScope("CupParam::ReadFile settings_amoreI.dat");
+                if (getenv("AmoreDATA") != NULL)
+                    db.ReadFile((G4String(getenv("AmoreDATA")) + "/settings_amoreI.dat").c_str());
+                else
+                    db.ReadFile("data/settings_amoreI.dat");
+            }
 
             size_t totalArraySize = maxModuleNumInTower * totalNumOfTower;
 
@@ -679,15 +731,20 @@ void AmoreDetectorConstruction::ConstructAmoreDetector() {
             CheckSanity_CrystalModuleInfoArray(*crystalIArray, totalArraySize);
             delete[] crystalIArray;
 
+            AmoreStartupProfiler::Scope nowScope("ConstructAMoRE_I");
             ConstructAMoRE_I();
             break;
         }
-        case kDetector_AMoRE10:
+        case kDetector_AMoRE10: {
+            AmoreStartupProfiler::Scope nowScope("ConstructAMoRE10");
             ConstructAMoRE10();
             break;
-        case kDetector_MyDetector:
+        }
+        case kDetector_MyDetector: {
+            AmoreStartupProfiler::Scope nowScope("ConstructMyDetector");
             ConstructMyDetector();
             break;
+        }
         default:
             G4cerr << "ERROR: INVALID VALUE for AmoreDetectorConstruction.whichDetGeometry"
                    << G4endl;
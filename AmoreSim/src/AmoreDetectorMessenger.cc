@@ -61,7 +61,9 @@ AmoreDetectorMessenger::AmoreDetectorMessenger(AmoreDetectorConstruction *Amored
     DebugModeCmd->SetParameter(new G4UIparameter("enable", 'b', true));
 
     OverlapCheckCmd = new G4UIcommand("/detGeometry/OverlapCheck", this);
-    OverlapCheckCmd->SetGuidance("Select enable overlap check");
+    OverlapCheckCmd->SetGuidance("Select enable overlap validation mode.");
+    OverlapCheckCmd->SetGuidance("The placements of the built world are checked in parallel,");
+    OverlapCheckCmd->SetGuidance("even if the same geometry has been checked before.");
     OverlapCheckCmd->AvailableForStates(G4State_PreInit);
     OverlapCheckCmd->SetParameter(new G4UIparameter("enable", 'b', true));
 
@@ -152,6 +154,48 @@ AmoreDetectorMessenger::AmoreDetectorMessenger(AmoreDetectorConstruction *Amored
     EnableCrystalArray->SetGuidance("Select enable crystal array for AMoRE-I");
     EnableCrystalArray->AvailableForStates(G4State_PreInit);
     EnableCrystalArray->SetParameter(new G4UIparameter("enable", 'b', true));
+
+    GeomSnapshotDir = new G4UIdirectory("/detGeometry/snapshot/");
+    GeomSnapshotDir->SetGuidance("Reuse the built world of the same geometry configuration.");
+
+    GeomSnapshotCmd = new G4UIcommand("/detGeometry/snapshot/enable", this);
+    GeomSnapshotCmd->SetGuidance("Restore the world from a snapshot made by an earlier job with");
+    GeomSnapshotCmd->SetGuidance("the same /detGeometry/ settings and settings_*.dat files.");
+    GeomSnapshotCmd->SetGuidance("If there is none, the world is built and a snapshot is stored.");
+    GeomSnapshotCmd->AvailableForStates(G4State_PreInit);
+    GeomSnapshotCmd->SetParameter(new G4UIparameter("enable", 'b', true));
+
+    GeomSnapshotDirCmd = new G4UIcommand("/detGeometry/snapshot/directory", this);
+    GeomSnapshotDirCmd->SetGuidance("Set the directory of the geometry snapshots.");
+    GeomSnapshotDirCmd->AvailableForStates(G4State_PreInit);
+    GeomSnapshotDirCmd->SetParameter(new G4UIparameter("path", 's', false));
+
+    OverlapDir = new G4UIdirectory("/detGeometry/overlap/");
+    OverlapDir->SetGuidance("Overlap check of the built world, recorded per geometry hash.");
+
+    OverlapAutoCmd = new G4UIcommand("/detGeometry/overlap/auto", this);
+    OverlapAutoCmd->SetGuidance("Check the overlaps if there is no record of this geometry.");
+    OverlapAutoCmd->AvailableForStates(G4State_PreInit);
+    OverlapAutoCmd->SetParameter(new G4UIparameter("enable", 'b', true));
+
+    OverlapThreadsCmd = new G4UIcommand("/detGeometry/overlap/threads", this);
+    OverlapThreadsCmd->SetGuidance("Set the number of threads of the check (0: all cores).");
+    OverlapThreadsCmd->AvailableForStates(G4State_PreInit);
+    G4UIparameter *nowParam = new G4UIparameter("threads", 'i', false);
+    nowParam->SetParameterRange("threads >= 0");
+    OverlapThreadsCmd->SetParameter(nowParam);
+
+    OverlapResolutionCmd = new G4UIcommand("/detGeometry/overlap/resolution", this);
+    OverlapResolutionCmd->SetGuidance("Set the number of surface points sampled per placement.");
+    OverlapResolutionCmd->AvailableForStates(G4State_PreInit);
+    nowParam = new G4UIparameter("points", 'i', false);
+    nowParam->SetParameterRange("points > 0");
+    OverlapResolutionCmd->SetParameter(nowParam);
+
+    OverlapRecordDirCmd = new G4UIcommand("/detGeometry/overlap/recordDir", this);
+    OverlapRecordDirCmd->SetGuidance("Set the directory of the overlap check records.");
+    OverlapRecordDirCmd->AvailableForStates(G4State_PreInit);
+    OverlapRecordDirCmd->SetParameter(new G4UIparameter("path", 's', false));
 }
 
 AmoreDetectorMessenger::~AmoreDetectorMessenger() {
@@ -176,11 +220,19 @@ AmoreDetectorMessenger::~AmoreDetectorMessenger() {
     delete NeutShieldConfCmd;
 		delete OverlapCheckCmd;
 		delete DebugModeCmd;
+    delete GeomSnapshotCmd;
+    delete GeomSnapshotDirCmd;
+    delete OverlapAutoCmd;
+    delete OverlapThreadsCmd;
+    delete OverlapResolutionCmd;
+    delete OverlapRecordDirCmd;
 
     delete AmoreDetectorDir;
     delete Amore200_DetectorDir;
     delete AmorePilot_DetectorDir;
     delete AmorePilotRUN5_DetectorDir;
+    delete GeomSnapshotDir;
+    delete OverlapDir;
 }
 
 void AmoreDetectorMessenger::SetNewValue(G4UIcommand *command, G4String newValues) {
@@ -329,6 +381,20 @@ void AmoreDetectorMessenger::SetNewValue(G4UIcommand *command, G4String newValue
     } else if (command == OverlapCheckCmd) {
         G4bool inp = StoB(newValues);
         AmoreDetector->SetOverlapCheck(inp);
+    } else if (command == GeomSnapshotCmd) {
+        G4bool inp = StoB(newValues);
+        AmoreDetector->SetGeometrySnapshot(inp);
+    } else if (command == GeomSnapshotDirCmd) {
+        AmoreDetector->SetGeometrySnapshotDir(newValues);
+    } else if (command == OverlapAutoCmd) {
+        G4bool inp = StoB(newValues);
+        AmoreDetector->SetOverlapAutoCheck(inp);
+    } else if (command == OverlapThreadsCmd) {
+        AmoreDetector->SetOverlapNThreads(StoI(newValues));
+    } else if (command == OverlapResolutionCmd) {
+        AmoreDetector->SetOverlapResolution(StoI(newValues));
+    } else if (command == OverlapRecordDirCmd) {
+        AmoreDetector->SetOverlapRecordDir(newValues);
     } else if (command == EnableSuperMagneticShieldCmd) {
         G4bool inp = StoB(newValues);
         AmoreDetector->Set_I_EnableSuperConductingShield(inp);
@@ -380,6 +446,18 @@ G4String AmoreDetectorMessenger::GetCurrentValue(G4UIcommand *command) {
         return BtoS(AmoreDetector->GetDebugMessage());
     } else if (command == OverlapCheckCmd) {
         return BtoS(AmoreDetector->GetOverlapCheck());
+    } else if (command == GeomSnapshotCmd) {
+        return BtoS(AmoreDetector->GetGeometrySnapshot());
+    } else if (command == GeomSnapshotDirCmd) {
+        return AmoreDetector->GetGeometrySnapshotDir();
+    } else if (command == OverlapAutoCmd) {
+        return BtoS(AmoreDetector->GetOverlapAutoCheck());
+    } else if (command == OverlapThreadsCmd) {
+        return ItoS(AmoreDetector->GetOverlapNThreads());
+    } else if (command == OverlapResolutionCmd) {
+        return ItoS(AmoreDetector->GetOverlapResolution());
+    } else if (command == OverlapRecordDirCmd) {
+        return AmoreDetector->GetOverlapRecordDir();
     } else if (command == EnableSuperMagneticShieldCmd) {
         return BtoS(AmoreDetector->Get_I_EnableSuperConductingShield());
     } else if (command == EnableCrystalArray) {
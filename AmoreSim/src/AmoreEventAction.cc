@@ -7,6 +7,8 @@
 #include <fstream>
 
 #include "AmoreSim/AmoreEventAction.hh"
+#include "AmoreSim/AmoreRunAction.hh"
+#include "AmoreSim/AmoreSubEventManager.hh"
 #include "AmoreSim/AmoreTrajectory.hh"
 #include "CupSim/CupVEventAction.hh"
 
@@ -36,8 +38,9 @@
 
 G4ThreeVector AmoreEventAction::fgPrimPosSkew = G4ThreeVector();
 
-AmoreEventAction::AmoreEventAction(AmoreRootNtuple *r)
-    : CupVEventAction(r), recorder(r), fPrimSkewEnable(false), fPrimSkewEnableCmd(nullptr),
+AmoreEventAction::AmoreEventAction(AmoreRootNtuple *r, G4bool aOwnRecorder)
+    : CupVEventAction(r), recorder(r), fOwnRecorder(aOwnRecorder), fPrimSkewEnable(false),
+      fPrimSkewEnableCmd(nullptr),
       fPrimDirectory(nullptr) {
     fPrimDirectory     = new G4UIdirectory("/event/primary");
     fPrimSkewEnableCmd = new G4UIcommand("/event/primary/enablePrimarySkew", this);
@@ -49,6 +52,7 @@ AmoreEventAction::AmoreEventAction(AmoreRootNtuple *r)
 AmoreEventAction::~AmoreEventAction() {
     delete fPrimSkewEnableCmd;
     delete fPrimDirectory;
+    if (fOwnRecorder) delete recorder;
 }
 
 G4String AmoreEventAction::GetCurrentValue(G4UIcommand *nowCommand) {
@@ -67,8 +71,13 @@ void AmoreEventAction::SetNewValue(G4UIcommand *nowCommand, G4String newValue) {
 }
 
 void AmoreEventAction::BeginOfEventAction(const G4Event *evt) {
+    fEventStart = std::chrono::steady_clock::now();
+    G4bool isSubEvent = AmoreSubEventManager::GetCurrentSubEvent() != nullptr;
+    if (!isSubEvent) AmoreSubEventManager::GetInstance()->BeginParentEvent(evt);
+
     recorder->ClearET();
-    if (fPrimSkewEnable) {
+    // Primaries of a sub-event are secondaries of a parent event which is already skewed
+    if (fPrimSkewEnable && !isSubEvent) {
         G4PrimaryVertex *temp = evt->GetPrimaryVertex();
         for (int i = 0; i < evt->GetNumberOfPrimaryVertex(); i++) {
             G4ThreeVector nowvec = temp->GetPosition();
@@ -82,5 +91,16 @@ void AmoreEventAction::BeginOfEventAction(const G4Event *evt) {
 }
 
 void AmoreEventAction::EndOfEventAction(const G4Event *evt) {
-    CupVEventAction::EndOfEventAction(evt);
+    AmoreSubEventManager *subEventManager = AmoreSubEventManager::GetInstance();
+    if (AmoreSubEventManager::GetCurrentSubEvent() != nullptr) {
+        // Hits and EndTrack records go to the parent event, nothing is recorded here
+        subEventManager->FinishSubEvent(evt, recorder->GetEndTrackList());
+        recorder->DiscardEvent();
+    } else {
+        subEventManager->EndParentEvent(evt, recorder->GetEndTrackList());
+        CupVEventAction::EndOfEventAction(evt);
+    }
+
+    std::chrono::duration<G4double> eventTime = std::chrono::steady_clock::now() - fEventStart;
+    AmoreRunAction::AddEventTime(eventTime.count());
 }
@@ -0,0 +1,340 @@
+#include "AmoreSim/AmoreEventFilter.hh"
+
+#include "G4UnitsTable.hh"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+class AmoreEventFilter::Parser {
+  public:
+    Parser(const G4String &aText) : fText(aText), fPos(0) {}
+
+    Program Parse() {
+        Program result = ParseOr();
+        SkipSpaces();
+        if (fError.empty() && fPos < fText.size()) Fail("unexpected character");
+        return result;
+    }
+    inline const G4String &GetError() const { return fError; }
+    inline size_t GetPosition() const { return fPos; }
+
+  private:
+    static void Append(Program &aTo, const Program &aFrom) {
+        aTo.insert(aTo.end(), aFrom.begin(), aFrom.end());
+    }
+    static inline G4bool IsNameChar(char aChar) {
+        return std::isalnum(static_cast<unsigned char>(aChar)) || aChar == '_';
+    }
+
+    void SkipSpaces() {
+        while (fPos < fText.size() && std::isspace(static_cast<unsigned char>(fText[fPos])))
+            fPos++;
+    }
+    G4bool Accept(const char *aToken) {
+        SkipSpaces();
+        size_t length = std::strlen(aToken);
+        if (fText.compare(fPos, length, aToken) != 0) return false;
+        fPos += length;
+        return true;
+    }
+    G4bool AcceptKeyword(const char *aKeyword) {
+        SkipSpaces();
+        size_t length = std::strlen(aKeyword);
+        if (fText.compare(fPos, length, aKeyword) != 0 ||
+            (fPos + length < fText.size() && IsNameChar(fText[fPos + length])))
+            return false;
+        fPos += length;
+        return true;
+    }
+    void Expect(const char *aToken) {
+        if (fError.empty() && !Accept(aToken)) Fail(G4String("expected '") + aToken + "'");
+    }
+    void Fail(const G4String &aMessage) {
+        if (fError.empty()) fError = aMessage;
+    }
+
+    Program ParseOr() {
+        Program result = ParseAnd();
+        while (fError.empty() && Accept("||")) {
+            Append(result, ParseAnd());
+            result.push_back({kOr, 0.});
+        }
+        return result;
+    }
+
+    Program ParseAnd() {
+        Program result = ParseNot();
+        while (fError.empty() && Accept("&&")) {
+            Append(result, ParseNot());
+            result.push_back({kAnd, 0.});
+        }
+        return result;
+    }
+
+    Program ParseNot() {
+        SkipSpaces();
+        if (fText.compare(fPos, 2, "!=") != 0 && Accept("!")) {
+            Program result = ParseNot();
+            result.push_back({kNot, 0.});
+            return result;
+        }
+        return ParseCompare();
+    }
+
+    Program ParseCompare() {
+        static const std::pair<const char *, eOperation> comparisons[] = {
+            {"<=", kLessEqual}, {">=", kGreaterEqual}, {"==", kEqual},
+            {"!=", kNotEqual},  {"<", kLess},          {">", kGreater}};
+        Program result = ParseSum();
+        if (!fError.empty()) return result;
+        for (const auto &nowComparison : comparisons) {
+            if (Accept(nowComparison.first)) {
+                Append(result, ParseSum());
+                result.push_back({nowComparison.second, 0.});
+                return result;
+            }
+        }
+        if (AcceptKeyword("in")) {
+            Expect("[");
+            Program lower = ParseSum();
+            Expect(",");
+            Program upper = ParseSum();
+            Expect("]");
+            // A unit after the bracket applies to both bounds
+            for (auto nowOperation : {kMultiply, kDivide}) {
+                if (Accept(nowOperation == kMultiply ? "*" : "/")) {
+                    Program factor = ParseUnary();
+                    Append(lower, factor);
+                    lower.push_back({nowOperation, 0.});
+                    Append(upper, factor);
+                    upper.push_back({nowOperation, 0.});
+                    break;
+                }
+            }
+            Append(result, lower);
+            Append(result, upper);
+            result.push_back({kInRange, 0.});
+        }
+        return result;
+    }
+
+    Program ParseSum() {
+        Program result = ParseTerm();
+        while (fError.empty()) {
+            eOperation nowOperation;
+            if (Accept("+"))
+                nowOperation = kAdd;
+            else if (Accept("-"))
+                nowOperation = kSubtract;
+            else
+                break;
+            Append(result, ParseTerm());
+            result.push_back({nowOperation, 0.});
+        }
+        return result;
+    }
+
+    Program ParseTerm() {
+        Program result = ParseUnary();
+        while (fError.empty()) {
+            eOperation nowOperation;
+            if (Accept("*"))
+                nowOperation = kMultiply;
+            else if (Accept("/"))
+                nowOperation = kDivide;
+            else
+                break;
+            Append(result, ParseUnary());
+            result.push_back({nowOperation, 0.});
+        }
+        return result;
+    }
+
+    Program ParseUnary() {
+        if (Accept("-")) {
+            Program result = ParseUnary();
+            result.push_back({kNegate, 0.});
+            return result;
+        }
+        Accept("+");
+        return ParsePrimary();
+    }
+
+    Program ParsePrimary() {
+        static const std::pair<const char *, eVariable> variables[] = {
+            {"nCrystalHit", kNCrystalHit}, {"nVetoHit", kNVetoHit}, {"Etot", kEtot},
+            {"EtotQ", kEtotQ},             {"vetoEdep", kVetoEdep}};
+        Program result;
+        if (!fError.empty()) return result;
+        if (Accept("(")) {
+            result = ParseOr();
+            Expect(")");
+            return result;
+        }
+
+        SkipSpaces();
+        if (fPos >= fText.size()) {
+            Fail("unexpected end of the expression");
+            return result;
+        }
+        char nowChar = fText[fPos];
+        if (std::isdigit(static_cast<unsigned char>(nowChar)) || nowChar == '.') {
+            const char *begin = fText.c_str() + fPos;
+            char *end;
+            G4double value = std::strtod(begin, &end);
+            fPos += end - begin;
+            result.push_back({kConstant, value});
+            return result;
+        }
+        if (!IsNameChar(nowChar)) {
+            Fail("unexpected character");
+            return result;
+        }
+
+        size_t begin = fPos;
+        while (fPos < fText.size() && IsNameChar(fText[fPos]))
+            fPos++;
+        G4String name = fText.substr(begin, fPos - begin);
+        if (name == "hit") {
+            Expect("(");
+            result = ParseSum();
+            Expect(")");
+            result.push_back({kHit, 0.});
+            return result;
+        }
+        for (const auto &nowVariable : variables) {
+            if (name == nowVariable.first) {
+                result.push_back({kVariable, static_cast<G4double>(nowVariable.second)});
+                return result;
+            }
+        }
+        if (G4UnitDefinition::IsUnitDefined(name)) {
+            result.push_back({kConstant, G4UnitDefinition::GetValueOf(name)});
+            return result;
+        }
+        fPos = begin;
+        Fail("unknown name " + name);
+        return result;
+    }
+
+    const G4String &fText;
+    size_t fPos;
+    G4String fError;
+};
+
+G4bool AmoreEventFilter::Compile(const G4String &aExpression) {
+    Parser parser(aExpression);
+    Program newProgram = parser.Parse();
+    if (!parser.GetError().empty()) {
+        G4Exception(__PRETTY_FUNCTION__, "EVTFILTER_PARSE", JustWarning,
+                    ("Cannot compile the event filter \"" + aExpression + "\": " +
+                     parser.GetError() + " at column " + std::to_string(parser.GetPosition() + 1) +
+                     ". The filter will not be changed.")
+                        .c_str());
+        return false;
+    }
+    fExpression = aExpression;
+    fProgram.swap(newProgram);
+    return true;
+}
+
+G4bool AmoreEventFilter::Accept(const AmoreEventSummary &aSummary) {
+    if (fProgram.empty()) return true;
+
+    auto pop = [this]() {
+        G4double value = fStack.back();
+        fStack.pop_back();
+        return value;
+    };
+    fStack.clear();
+    for (const auto &nowInstruction : fProgram) {
+        switch (nowInstruction.fOperation) {
+            case kConstant:
+                fStack.push_back(nowInstruction.fValue);
+                continue;
+            case kVariable:
+                switch (static_cast<eVariable>(nowInstruction.fValue)) {
+                    case kNCrystalHit:
+                        fStack.push_back(aSummary.fNCrystalHit);
+                        break;
+                    case kNVetoHit:
+                        fStack.push_back(aSummary.fNVetoHit);
+                        break;
+                    case kEtot:
+                        fStack.push_back(aSummary.fCrystalEdep);
+                        break;
+                    case kEtotQ:
+                        fStack.push_back(aSummary.fCrystalQEdep);
+                        break;
+                    case kVetoEdep:
+                        fStack.push_back(aSummary.fVetoEdep);
+                        break;
+                }
+                continue;
+            case kHit: {
+                G4double index = pop();
+                fStack.push_back(index >= 0 && index < aSummary.fCrystalHits.size() &&
+                                 aSummary.fCrystalHits[static_cast<size_t>(index)]);
+                continue;
+            }
+            case kNegate:
+                fStack.back() = -fStack.back();
+                continue;
+            case kNot:
+                fStack.back() = (fStack.back() == 0.);
+                continue;
+            case kInRange: {
+                G4double upper = pop(), lower = pop();
+                fStack.back()  = (lower <= fStack.back() && fStack.back() <= upper);
+                continue;
+            }
+            default:
+                break;
+        }
+
+        G4double right = pop();
+        G4double &left = fStack.back();
+        switch (nowInstruction.fOperation) {
+            case kAdd:
+                left += right;
+                break;
+            case kSubtract:
+                left -= right;
+                break;
+            case kMultiply:
+                left *= right;
+                break;
+            case kDivide:
+                left /= right;
+                break;
+            case kAnd:
+                left = (left != 0. && right != 0.);
+                break;
+            case kOr:
+                left = (left != 0. || right != 0.);
+                break;
+            case kLess:
+                left = (left < right);
+                break;
+            case kLessEqual:
+                left = (left <= right);
+                break;
+            case kGreater:
+                left = (left > right);
+                break;
+            case kGreaterEqual:
+                left = (left >= right);
+                break;
+            case kEqual:
+                left = (left == right);
+                break;
+            case kNotEqual:
+                left = (left != right);
+                break;
+            default:
+                break;
+        }
+    }
+    return fStack.back() != 0.;
+}
@@ -0,0 +1,97 @@
+#include "AmoreSim/AmoreForkRunManager.hh"
+#include "AmoreSim/AmoreRootNtuple.hh"
+
+#include "G4Event.hh"
+#include "G4ios.hh"
+#include "Randomize.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+AmoreForkRunManager::AmoreForkRunManager(G4int aNProcesses)
+    : G4RunManager(), fNProcesses(aNProcesses), fChildIndex(-1), fEventOffset(0),
+      fRecorder(nullptr) {}
+
+void AmoreForkRunManager::BeamOn(G4int n_event, const char *macroFile, G4int n_select) {
+    if (fNProcesses <= 1 || n_event <= 0) {
+        G4RunManager::BeamOn(n_event, macroFile, n_select);
+        return;
+    }
+
+    if (!IsChild()) {
+        if (fChildren.empty()) ForkChildren();
+        if (!IsChild()) {
+            G4cout << "The " << n_event << " events of this run are processed by "
+                   << fNProcesses << " child processes." << G4endl;
+            return;
+        }
+    }
+
+    G4int nowShare = n_event / fNProcesses;
+    G4int nowRest  = n_event % fNProcesses;
+    fEventOffset   = fChildIndex * nowShare + std::min(fChildIndex, nowRest);
+    if (fChildIndex < nowRest) nowShare++;
+
+    ReseedChild();
+    G4RunManager::BeamOn(nowShare, macroFile, n_select);
+}
+
+G4Event *AmoreForkRunManager::GenerateEvent(G4int i_event) {
+    // Event IDs stay unique over the children, so the merged output looks like one run
+    return G4RunManager::GenerateEvent(i_event + fEventOffset);
+}
+
+void AmoreForkRunManager::ForkChildren() {
+    // A run without events builds the physics tables and closes the geometry, so that the
+    // children do not have to do it again.
+    G4RunManager::BeamOn(0);
+
+    G4cout << "Forking " << fNProcesses << " child processes." << G4endl;
+    G4cout.flush();
+    std::cout.flush();
+    std::fflush(nullptr);
+
+    for (G4int i = 0; i < fNProcesses; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            fChildIndex = i;
+            fChildren.clear();
+            if (fRecorder != nullptr) fRecorder->BecomeForkChild(i);
+            return;
+        } else if (pid < 0) {
+            G4Exception(__PRETTY_FUNCTION__, "FORK_FAIL", FatalException,
+                        "Forking a child process has been failed.");
+        }
+        fChildren.push_back(pid);
+    }
+}
+
+void AmoreForkRunManager::ReseedChild() {
+    // Every child takes its seeds from a different position of the common random sequence,
+    // so /cupdebug/setseed in the macro still gives reproducible and independent streams.
+    long seeds[3] = {0, 0, 0};
+    for (G4int i = 0; i <= fChildIndex; i++) {
+        seeds[0] = static_cast<long>(100000000L * G4UniformRand()) + 1;
+        seeds[1] = static_cast<long>(100000000L * G4UniformRand()) + 1;
+    }
+    G4Random::setTheSeeds(seeds, -1);
+}
+
+G4bool AmoreForkRunManager::WaitForChildren() {
+    G4bool allSucceeded = true;
+    for (size_t i = 0; i < fChildren.size(); i++) {
+        int status = 0;
+        if (waitpid(fChildren[i], &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            G4Exception(__PRETTY_FUNCTION__, "FORK_CHILD_FAIL", JustWarning,
+                        ("Child process " + std::to_string(i) + " has not finished normally.")
+                            .c_str());
+            allSucceeded = false;
+        }
+    }
+    fChildren.clear();
+    return allSucceeded;
+}
@@ -0,0 +1,19 @@
+#include "AmoreSim/AmoreHash.hh"
+
+#include <iomanip>
+#include <sstream>
+
+std::uint64_t AmoreHash::Digest(const std::string &aText) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char nowChar : aText) {
+        hash ^= nowChar;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+G4String AmoreHash::HexDigest(const std::string &aText) {
+    std::ostringstream hashStr;
+    hashStr << std::hex << std::setw(16) << std::setfill('0') << Digest(aText);
+    return hashStr.str();
+}
@@ -0,0 +1,117 @@
+#include "AmoreSim/AmoreLog.hh"
+
+#include "G4UIcommand.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIparameter.hh"
+#include "G4ios.hh"
+
+#include <sstream>
+
+namespace {
+    const char *kCategoryNames[AmoreLog::kNCategories] = {"event", "hit", "ntuple"};
+    const char *kLevelNames[]                          = {"silent", "warning", "info", "debug"};
+} // namespace
+
+AmoreLog *AmoreLog::fgInstance = nullptr;
+std::atomic<G4int> AmoreLog::fgLevels[kNCategories] = {{kInfo}, {kInfo}, {kInfo}};
+std::atomic<G4int> AmoreLog::fgBufferSize(65536);
+
+AmoreLog *AmoreLog::GetInstance() {
+    if (fgInstance == nullptr) fgInstance = new AmoreLog;
+    return fgInstance;
+}
+
+AmoreLog::AmoreLog() {
+    // The levels are shared by every thread, so the commands are not broadcast.
+    fLogDir = new G4UIdirectory("/amore/log/", false);
+    fLogDir->SetGuidance("Control the messages of the event loop.");
+
+    G4String categories = "all";
+    for (auto nowName : kCategoryNames)
+        categories += G4String(" ") + nowName;
+    G4String levels;
+    for (auto nowName : kLevelNames)
+        levels += (levels.empty() ? "" : " ") + G4String(nowName);
+
+    fLevelCmd = new G4UIcommand("/amore/log/level", this);
+    fLevelCmd->SetGuidance("Set the level up to which the messages of a category are printed.");
+    fLevelCmd->SetGuidance("  event : end of event banners");
+    fLevelCmd->SetGuidance("  hit   : energy deposits in the sensitive detectors");
+    fLevelCmd->SetGuidance("  ntuple: contents of the recorded events");
+    fLevelCmd->SetGuidance("Every category is at info by default, which hides the debug messages.");
+    G4UIparameter *categoryParam = new G4UIparameter("category", 's', false);
+    categoryParam->SetParameterCandidates(categories);
+    fLevelCmd->SetParameter(categoryParam);
+    G4UIparameter *levelParam = new G4UIparameter("level", 's', false);
+    levelParam->SetParameterCandidates(levels);
+    fLevelCmd->SetParameter(levelParam);
+    fLevelCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fLevelCmd->SetToBeBroadcasted(false);
+
+    fBufferSizeCmd = new G4UIcommand("/amore/log/bufferSize", this);
+    fBufferSizeCmd->SetGuidance("Size in bytes of the message buffer of each thread.");
+    fBufferSizeCmd->SetGuidance("0 writes every message at once.");
+    G4UIparameter *sizeParam = new G4UIparameter("size", 'i', false);
+    sizeParam->SetParameterRange("size >= 0");
+    fBufferSizeCmd->SetParameter(sizeParam);
+    fBufferSizeCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fBufferSizeCmd->SetToBeBroadcasted(false);
+
+    fListCmd = new G4UIcommand("/amore/log/list", this);
+    fListCmd->SetGuidance("Print the level of every category.");
+    fListCmd->SetToBeBroadcasted(false);
+}
+
+AmoreLog::~AmoreLog() {
+    Flush();
+    delete fLevelCmd;
+    delete fBufferSizeCmd;
+    delete fListCmd;
+    delete fLogDir;
+    fgInstance = nullptr;
+}
+
+void AmoreLog::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == fLevelCmd) {
+        std::istringstream input(newValue);
+        G4String category, level;
+        input >> category >> level;
+        G4int nowLevel = kSilent;
+        for (G4int i = 0; i <= kDebug; i++)
+            if (level == kLevelNames[i]) nowLevel = i;
+        for (G4int i = 0; i < kNCategories; i++)
+            if (category == "all" || category == kCategoryNames[i]) fgLevels[i] = nowLevel;
+    } else if (command == fBufferSizeCmd) {
+        fgBufferSize = StoI(newValue);
+    } else if (command == fListCmd) {
+        PrintLevels();
+    }
+}
+
+G4String AmoreLog::GetCurrentValue(G4UIcommand *command) {
+    if (command == fBufferSizeCmd) return ItoS(fgBufferSize);
+    return G4String();
+}
+
+void AmoreLog::PrintLevels() const {
+    G4cout << "Message levels (buffer of " << fgBufferSize << " bytes per thread)" << G4endl;
+    for (G4int i = 0; i < kNCategories; i++)
+        G4cout << "  " << kCategoryNames[i] << ": " << kLevelNames[fgLevels[i]] << G4endl;
+}
+
+std::ostringstream &AmoreLog::GetStream() {
+    thread_local std::ostringstream stream;
+    return stream;
+}
+
+void AmoreLog::Flush() {
+    std::ostringstream &stream = GetStream();
+    if (stream.tellp() <= 0) return;
+    G4cout << stream.str() << std::flush;
+    stream.str("");
+}
+
+AmoreLog::Line::~Line() {
+    fStream << '\n';
+    if (fStream.tellp() >= static_cast<std::streamoff>(fgBufferSize)) Flush();
+}
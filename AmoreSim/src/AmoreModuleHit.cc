@@ -15,6 +15,8 @@
 #include "G4VisAttributes.hh"
 #include "G4ios.hh"
 
+#include <algorithm>
+
 #if G4VERSION_NUMBER <= 999
 G4Allocator<AmoreModuleHit> *AmoreModuleHitAllocator = nullptr;
 #else
@@ -26,25 +28,18 @@ G4int AmoreModuleHit::fgGeWaferGoldFilmNum = 3;
 
 AmoreModuleHit::AmoreModuleHit(const AmoreModuleSDInfo *aMSDInfo, G4int aCrystalGoldFilmNum,
                                G4int aGeWaferGoldFilmNum)
-    : G4VHit(), fModuleSDInfo(aMSDInfo) {
-    fEdepOnCrystal         = 0.;
-    fQuenchedEdepOnCrystal = 0.;
-    fEdepOnGeWafer         = 0.;
-    fQuenchedEdepOnGeWafer = 0.;
-    fEdepOnGeWaferGoldFilm.resize(aGeWaferGoldFilmNum, 0.);
-    fEdepOnCrystalGoldFilm.resize(aCrystalGoldFilmNum, 0.);
+    : G4VHit(), fEdepOnGeWaferGoldFilm{}, fEdepOnCrystalGoldFilm{}, fModuleSDInfo(aMSDInfo),
+      fTouched(false), fTouchedHits(nullptr) {
+    fGeWaferGoldFilmNum = std::max(1, std::min(aGeWaferGoldFilmNum, kMaxGoldFilmNum));
+    fCrystalGoldFilmNum = std::max(1, std::min(aCrystalGoldFilmNum, kMaxGoldFilmNum));
+    Clear();
 }
 
 AmoreModuleHit::~AmoreModuleHit() { ; }
 
 AmoreModuleHit::AmoreModuleHit(const AmoreModuleHit &right)
-    : G4VHit(), fModuleSDInfo(right.fModuleSDInfo) {
-    fEdepOnCrystal         = right.fEdepOnCrystal;
-    fQuenchedEdepOnCrystal = right.fQuenchedEdepOnCrystal;
-    fEdepOnGeWafer         = right.fEdepOnGeWafer;
-    fQuenchedEdepOnGeWafer = right.fQuenchedEdepOnGeWafer;
-    fEdepOnGeWaferGoldFilm = right.fEdepOnGeWaferGoldFilm;
-    fEdepOnCrystalGoldFilm = right.fEdepOnCrystalGoldFilm;
+    : G4VHit(), fModuleSDInfo(right.fModuleSDInfo), fTouched(false), fTouchedHits(nullptr) {
+    *this = right;
 }
 
 const AmoreModuleHit &AmoreModuleHit::operator=(const AmoreModuleHit &right) {
@@ -53,8 +48,11 @@ const AmoreModuleHit &AmoreModuleHit::operator=(const AmoreModuleHit &right) {
     fQuenchedEdepOnCrystal = right.fQuenchedEdepOnCrystal;
     fEdepOnGeWafer         = right.fEdepOnGeWafer;
     fQuenchedEdepOnGeWafer = right.fQuenchedEdepOnGeWafer;
-    fEdepOnGeWaferGoldFilm = right.fEdepOnGeWaferGoldFilm;
-    fEdepOnCrystalGoldFilm = right.fEdepOnCrystalGoldFilm;
+    fGeWaferGoldFilmNum    = right.fGeWaferGoldFilmNum;
+    fCrystalGoldFilmNum    = right.fCrystalGoldFilmNum;
+    std::copy_n(right.fEdepOnGeWaferGoldFilm, kMaxGoldFilmNum, fEdepOnGeWaferGoldFilm);
+    std::copy_n(right.fEdepOnCrystalGoldFilm, kMaxGoldFilmNum, fEdepOnCrystalGoldFilm);
+    if (right.fTouched) MarkTouched(1.);
 
     return *this;
 }
@@ -4,7 +4,9 @@
 
 #include "AmoreSim/AmoreModuleSD.hh"
 #include "AmoreSim/AmoreModuleHit.hh"
+#include "AmoreSim/AmoreQuenchingBuffer.hh"
 #include "G4HCofThisEvent.hh"
+#include "G4OpticalPhoton.hh"
 #include "G4SDManager.hh"
 #include "G4Step.hh"
 #include "G4TouchableHistory.hh"
@@ -16,14 +18,28 @@
 #include "G4LossTableManager.hh"
 
 AmoreModuleSD::AmoreModuleSD(G4String name, std::set<AmoreModuleSDInfo> &aModuleSDInfoList)
-    : G4VSensitiveDetector(name), fModuleSDInfoList(aModuleSDInfoList) {
+    : G4VSensitiveDetector(name), fOpticalPhoton(G4OpticalPhoton::Definition()),
+      fQuenchingBuffer(nullptr), fModuleSDInfoList(aModuleSDInfoList) {
     G4String HCname;
     collectionName.insert(HCname = "AmoreModuleSDColl");
     fModulesNumber = fModuleSDInfoList.size();
     fHitCollID     = -1;
+    BuildComponentTable();
+
+    fModuleHits.resize(fModulesNumber, nullptr);
+    fTouchedHits.reserve(fModulesNumber);
+    for (auto &nowSDInfo : fModuleSDInfoList) {
+        AmoreModuleHit *aHit = new AmoreModuleHit(&nowSDInfo);
+        aHit->SetTouchedHitList(&fTouchedHits);
+
+        fModuleHits[aHit->GetModuleID()] = aHit;
+    }
 }
 
-AmoreModuleSD::~AmoreModuleSD() { ; }
+AmoreModuleSD::~AmoreModuleSD() {
+    for (auto nowHit : fModuleHits)
+        delete nowHit;
+}
 
 void AmoreModuleSD::Initialize(G4HCofThisEvent *HCE) {
     fHitsColl = new AmoreModuleHitsCollection(SensitiveDetectorName, collectionName[0]);
@@ -32,82 +48,143 @@ void AmoreModuleSD::Initialize(G4HCofThisEvent *HCE) {
     }
     HCE->AddHitsCollection(fHitCollID, fHitsColl);
 
-    auto hitCollVector = fHitsColl->GetVector();
-    hitCollVector->resize(fModulesNumber);
+    for (auto nowHit : fTouchedHits)
+        nowHit->Clear();
+    fTouchedHits.clear();
+    *fHitsColl->GetVector() = fModuleHits;
+}
+
+// Every module envelope is a root region whose daughters are placed once, so each sensitive PV
+// is at a fixed depth below its envelope and is always the same component. The steps then find
+// their module with a single look up in the touchable instead of a search.
+void AmoreModuleSD::BuildComponentTable() {
+    std::set<const G4LogicalVolume *> visitedEnvelopes;
     for (auto &nowSDInfo : fModuleSDInfoList) {
-        AmoreModuleHit *aHit = new AmoreModuleHit(&nowSDInfo);
+        G4LogicalVolume *nowEnvelopeLV = nowSDInfo.fModulePV->GetLogicalVolume();
+        if (!visitedEnvelopes.insert(nowEnvelopeLV).second) continue;
+        CollectComponents(nowSDInfo, nowEnvelopeLV, 1);
+    }
+}
 
-        (*hitCollVector)[aHit->GetModuleID()] = aHit;
+void AmoreModuleSD::CollectComponents(const AmoreModuleSDInfo &aSDInfo,
+                                      G4LogicalVolume *aMotherLV, G4int aDepth) {
+    for (size_t i = 0; i < aMotherLV->GetNoDaughters(); i++) {
+        G4VPhysicalVolume *nowPhysical = aMotherLV->GetDaughter(i);
+        G4LogicalVolume *nowLogical    = nowPhysical->GetLogicalVolume();
+        if (nowLogical->IsRootRegion()) continue;
+
+        eComponent nowComponent = GetComponentOf(aSDInfo, nowLogical);
+        if (nowComponent != kNoComponent) {
+            ComponentInfo nowInfo{nowComponent, aDepth, nowPhysical->GetCopyNo()};
+            auto inserted = fComponentTable.emplace(nowPhysical, nowInfo);
+            // A PV found twice at other places falls back to the search
+            if (!inserted.second && (inserted.first->second.fEnvelopeDepth != aDepth ||
+                                     inserted.first->second.fComponent != nowComponent))
+                inserted.first->second.fEnvelopeDepth = -1;
+        }
+        CollectComponents(aSDInfo, nowLogical, aDepth + 1);
     }
 }
 
-G4bool AmoreModuleSD::ProcessHits(G4Step *aStep, G4TouchableHistory *) {
-    static CrystalModuleInfo aDummy;
-    G4EmSaturation *emSaturation = G4LossTableManager::Instance()->EmSaturation();
+AmoreModuleSD::eComponent AmoreModuleSD::GetComponentOf(const AmoreModuleSDInfo &aSDInfo,
+                                                        const G4LogicalVolume *aLV) {
+    if (aLV == aSDInfo.fCrystalLV) return kCrystal;
+    if (aLV == aSDInfo.fGeWaferLV) return kGeWafer;
+    if (aLV == aSDInfo.fCrystalGoldFilmLV) return kCrystalGoldFilm;
+    if (aLV == aSDInfo.fGeWaferGoldFilmLV) return kGeWaferGoldFilm;
+    return kNoComponent;
+}
+
+AmoreModuleSD::eComponent AmoreModuleSD::GetComponentOf(const AmoreModuleHit *aHit,
+                                                        const G4LogicalVolume *aLV) {
+    if (aLV == aHit->GetCrystalLogicalVolume()) return kCrystal;
+    if (aLV == aHit->GetGeWaferLogicalVolume()) return kGeWafer;
+    if (aLV == aHit->GetCrystalGoldFilmLogicalVolume()) return kCrystalGoldFilm;
+    if (aLV == aHit->GetGeWaferGoldFilmLogicalVolume()) return kGeWaferGoldFilm;
+    return kNoComponent;
+}
 
+G4int AmoreModuleSD::FindEnvelopeCopyNo(const G4TouchableHandle &aTouchable) {
     G4int nowMotherLevel = 1;
-    G4int envelopeCopyNo = 1;
-		G4int nowCopyNo;
-    G4double energyDeposit, qEnergyDeposit;
-    G4ParticleDefinition *nowParticle;
-    G4String particleName;
+    G4VPhysicalVolume *theMotherPhysical = aTouchable->GetVolume(nowMotherLevel++);
 
-    G4VPhysicalVolume *theMotherPhysical, *nowPhysical;
-    G4LogicalVolume *nowLogical;
+    while (theMotherPhysical != nullptr) {
+        if (theMotherPhysical->GetLogicalVolume()->IsRootRegion()) {
+            if (theMotherPhysical->GetMotherLogical() == nullptr) { // Reached the end of the world
+                G4Exception(__PRETTY_FUNCTION__, "MDSD_REGION_FAIL", FatalException,
+                            "Finding a root region for SD has been failed.");
+            }
+            return theMotherPhysical->GetCopyNo();
+        }
 
-    nowParticle   = aStep->GetTrack()->GetDefinition();
-    energyDeposit = aStep->GetTotalEnergyDeposit();
-    particleName  = nowParticle->GetParticleName();
-    if (particleName == "opticalphoton" || energyDeposit == 0.) return true;
+        theMotherPhysical = aTouchable->GetVolume(nowMotherLevel++);
+    }
+    return 1;
+}
 
+G4double AmoreModuleSD::GetVisibleEnergy(const G4Step *aStep) {
+    G4EmSaturation *emSaturation = G4LossTableManager::Instance()->EmSaturation();
 #if G4VERSION_NUMBER <= 1020
-    qEnergyDeposit = emSaturation->VisibleEnergyDeposition(aStep);
+    return emSaturation->VisibleEnergyDeposition(aStep);
 #else
-    qEnergyDeposit = emSaturation->VisibleEnergyDepositionAtAStep(aStep); // for geant4.10.4.2
+    return emSaturation->VisibleEnergyDepositionAtAStep(aStep); // for geant4.10.4.2
 #endif
+}
 
+G4bool AmoreModuleSD::ProcessHits(G4Step *aStep, G4TouchableHistory *) {
+    G4int nowCopyNo;
+    G4double energyDeposit;
+
+    G4VPhysicalVolume *nowPhysical;
+    AmoreModuleHit *aHit;
+    eComponent nowComponent;
+
+    energyDeposit = aStep->GetTotalEnergyDeposit();
+    if (energyDeposit == 0. || aStep->GetTrack()->GetDefinition() == fOpticalPhoton) return true;
 
     G4StepPoint *preStepPoint      = aStep->GetPreStepPoint();
     G4TouchableHandle theTouchable = preStepPoint->GetTouchableHandle();
 
-    nowPhysical = theTouchable->GetVolume(0);
-    nowLogical  = nowPhysical->GetLogicalVolume();
-    nowCopyNo   = nowPhysical->GetCopyNo();
-
-    theMotherPhysical = theTouchable->GetVolume(nowMotherLevel++);
+    nowPhysical   = theTouchable->GetVolume(0);
+    auto nowEntry = fComponentTable.find(nowPhysical);
+    if (nowEntry != fComponentTable.end() && nowEntry->second.fEnvelopeDepth >= 0) {
+        aHit         = (*fHitsColl)[theTouchable->GetCopyNumber(nowEntry->second.fEnvelopeDepth)];
+        nowComponent = nowEntry->second.fComponent;
+        nowCopyNo    = nowEntry->second.fCopyNo;
+    } else {
+        aHit         = (*fHitsColl)[FindEnvelopeCopyNo(theTouchable)];
+        nowComponent = GetComponentOf(aHit, nowPhysical->GetLogicalVolume());
+        nowCopyNo    = nowPhysical->GetCopyNo();
+    }
 
-    while (theMotherPhysical != nullptr) {
-        if (theMotherPhysical->GetLogicalVolume()->IsRootRegion()) {
-            if (theMotherPhysical->GetMotherLogical() == nullptr) { // Reached the end of the world
-                G4Exception(__PRETTY_FUNCTION__, "MDSD_REGION_FAIL", FatalException,
-                            "Finding a root region for SD has been failed.");
-            }
-            envelopeCopyNo = theMotherPhysical->GetCopyNo();
+    // Only the crystals and the wafers have a quenched energy
+    switch (nowComponent) {
+        case kCrystal:
+            aHit->AddCrystalEdep(energyDeposit); // JW modified
+            if (fQuenchingBuffer != nullptr)
+                fQuenchingBuffer->Add(aHit->GetModuleID(), aStep);
+            else
+                aHit->AddCrystalQEdep(GetVisibleEnergy(aStep)); // JW modified
+            break;
+        case kGeWafer:
+            aHit->AddGeWaferEdep(energyDeposit);
+            aHit->AddGeWaferQEdep(GetVisibleEnergy(aStep));
+            break;
+        case kCrystalGoldFilm:
+            aHit->AddCrystalGoldFilmEdep(0, energyDeposit);
+            break;
+        case kGeWaferGoldFilm:
+            aHit->AddGeWaferGoldFilmEdep(nowCopyNo, energyDeposit);
+            break;
+        default:
+            G4Exception(__PRETTY_FUNCTION__, "MDSD_LV_NOTMATCH", G4ExceptionSeverity::JustWarning,
+                        "SD has hitted but there is no LV which fits to this step.");
             break;
-        }
-
-        theMotherPhysical = theTouchable->GetVolume(nowMotherLevel++);
-    }
-    AmoreModuleHit *aHit = (*fHitsColl)[envelopeCopyNo];
-
-    if (nowLogical == aHit->GetCrystalLogicalVolume()) {
-        //aHit->SetCrystalEdep(energyDeposit);
-        //aHit->SetCrystalQEdep(qEnergyDeposit);
-        aHit->AddCrystalEdep(energyDeposit);   // JW modified
-        aHit->AddCrystalQEdep(qEnergyDeposit); // JW modified
-    } else if (nowLogical == aHit->GetGeWaferLogicalVolume()) {
-        aHit->AddGeWaferEdep(energyDeposit);
-        aHit->AddGeWaferQEdep(qEnergyDeposit);
-    } else if (nowLogical == aHit->GetCrystalGoldFilmLogicalVolume()) {
-        aHit->AddCrystalGoldFilmEdep(0, energyDeposit);
-    } else if (nowLogical == aHit->GetGeWaferGoldFilmLogicalVolume()) {
-        aHit->AddGeWaferGoldFilmEdep(nowCopyNo, energyDeposit);
-    } else {
-        G4Exception(__PRETTY_FUNCTION__, "MDSD_LV_NOTMATCH", G4ExceptionSeverity::JustWarning,
-                    "SD has hitted but there is no LV which fits to this step.");
     }
 
     return true;
 }
 
-void AmoreModuleSD::EndOfEvent(G4HCofThisEvent * /*HCE*/) { ; }
+void AmoreModuleSD::EndOfEvent(G4HCofThisEvent * /*HCE*/) {
+    if (fQuenchingBuffer != nullptr) fQuenchingBuffer->Quench(fModuleHits);
+}
@@ -0,0 +1,196 @@
+#include "AmoreSim/AmoreOutputFlusher.hh"
+
+#include "G4UIcommand.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIparameter.hh"
+#include "G4ios.hh"
+
+#include "RConfigure.h"
+#include "TFile.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include <algorithm>
+
+#include <unistd.h>
+
+AmoreOutputFlusher *AmoreOutputFlusher::fgInstance = nullptr;
+
+AmoreOutputFlusher *AmoreOutputFlusher::GetInstance() {
+    if (fgInstance == nullptr) fgInstance = new AmoreOutputFlusher;
+    return fgInstance;
+}
+
+AmoreOutputFlusher::AmoreOutputFlusher()
+    : fAsync(false), fQueueSize(4), fBlockWhenFull(true), fNSkipped(0),
+      fFlushingTree(nullptr), fStopping(false) {
+    // The settings are shared by every recorder, so the commands are not broadcast.
+    fIODir = new G4UIdirectory("/ntuple/io/", false);
+    fIODir->SetGuidance("Control the writing of the output files.");
+
+    fAsyncCmd = new G4UIcommand("/ntuple/io/async", this);
+    fAsyncCmd->SetGuidance("Write the baskets of the periodic flushes and synchronize the");
+    fAsyncCmd->SetGuidance("output files with the disk in a background thread, instead of in");
+    fAsyncCmd->SetGuidance("the event loop.");
+    fAsyncCmd->SetParameter(new G4UIparameter("async", 'b', false));
+    fAsyncCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fAsyncCmd->SetToBeBroadcasted(false);
+
+    fQueueSizeCmd = new G4UIcommand("/ntuple/io/queueSize", this);
+    fQueueSizeCmd->SetGuidance("Number of flushes which may wait for the background thread.");
+    G4UIparameter *queueSizeParam = new G4UIparameter("nFlushes", 'i', false);
+    queueSizeParam->SetParameterRange("nFlushes > 0");
+    fQueueSizeCmd->SetParameter(queueSizeParam);
+    fQueueSizeCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fQueueSizeCmd->SetToBeBroadcasted(false);
+
+    fWhenFullCmd = new G4UIcommand("/ntuple/io/whenFull", this);
+    fWhenFullCmd->SetGuidance("What to do with a flush when the queue is full.");
+    fWhenFullCmd->SetGuidance("  block: wait until the background thread takes it (default)");
+    fWhenFullCmd->SetGuidance("  skip : leave the file to the next flush or to its closing");
+    G4UIparameter *whenFullParam = new G4UIparameter("policy", 's', false);
+    whenFullParam->SetParameterCandidates("block skip");
+    fWhenFullCmd->SetParameter(whenFullParam);
+    fWhenFullCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fWhenFullCmd->SetToBeBroadcasted(false);
+
+    fIMTCmd = new G4UIcommand("/ntuple/io/imtThreads", this);
+    fIMTCmd->SetGuidance("Compress the baskets of the output trees in parallel with the");
+    fIMTCmd->SetGuidance("implicit multi-threading of ROOT. 0 uses every core of the node.");
+    G4UIparameter *imtParam = new G4UIparameter("nThreads", 'i', false);
+    imtParam->SetParameterRange("nThreads >= 0");
+    fIMTCmd->SetParameter(imtParam);
+    fIMTCmd->AvailableForStates(G4State_PreInit);
+    fIMTCmd->SetToBeBroadcasted(false);
+}
+
+// The flushes still in the queue are done before the thread stops
+AmoreOutputFlusher::~AmoreOutputFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStopping = true;
+    }
+    fCondition.notify_all();
+    if (fThread.joinable()) fThread.join();
+    if (fNSkipped > 0)
+        G4cout << fNSkipped << " output flushes have been skipped since the queue was full."
+               << G4endl;
+
+    delete fAsyncCmd;
+    delete fQueueSizeCmd;
+    delete fWhenFullCmd;
+    delete fIMTCmd;
+    delete fIODir;
+    fgInstance = nullptr;
+}
+
+void AmoreOutputFlusher::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == fAsyncCmd) {
+        fAsync = StoB(newValue);
+    } else if (command == fQueueSizeCmd) {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQueueSize = StoI(newValue);
+    } else if (command == fWhenFullCmd) {
+        fBlockWhenFull = (newValue == "block");
+    } else if (command == fIMTCmd) {
+        EnableImplicitMT(StoI(newValue));
+    }
+}
+
+G4String AmoreOutputFlusher::GetCurrentValue(G4UIcommand *command) {
+    if (command == fAsyncCmd) {
+        return BtoS(fAsync);
+    } else if (command == fQueueSizeCmd) {
+        return ItoS(fQueueSize);
+    } else if (command == fWhenFullCmd) {
+        return fBlockWhenFull ? "block" : "skip";
+    }
+    return G4String();
+}
+
+void AmoreOutputFlusher::EnableImplicitMT(G4int aNThreads) {
+#ifdef R__USE_IMT
+    ROOT::EnableImplicitMT(aNThreads);
+    G4cout << "ROOT implicit multi-threading uses " << ROOT::GetThreadPoolSize()
+           << " threads for the output." << G4endl;
+#else
+    (void)aNThreads;
+    G4Exception(__PRETTY_FUNCTION__, "IO_NO_IMT", JustWarning,
+                "ROOT has been built without implicit multi-threading (imt).");
+#endif
+}
+
+void AmoreOutputFlusher::FlushNow(TTree *aTree, std::mutex &aTreeMutex) {
+    std::lock_guard<std::mutex> lock(aTreeMutex);
+    aTree->FlushBaskets();
+    if (aTree->GetCurrentFile() != nullptr) aTree->GetCurrentFile()->Flush();
+}
+
+// A tree which is already in the queue is not queued again, since that flush also takes the
+// baskets filled in the meantime.
+void AmoreOutputFlusher::Flush(TTree *aTree, std::mutex &aTreeMutex) {
+    if (aTree == nullptr) return;
+    if (!fAsync) {
+        FlushNow(aTree, aTreeMutex);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(fMutex);
+    auto isQueued = [aTree](const Request &aRequest) { return aRequest.fTree == aTree; };
+    if (std::any_of(fPending.begin(), fPending.end(), isQueued)) return;
+    if (static_cast<G4int>(fPending.size()) >= fQueueSize) {
+        if (!fBlockWhenFull) {
+            fNSkipped++;
+            return;
+        }
+        fCondition.wait(lock, [this] { return static_cast<G4int>(fPending.size()) < fQueueSize; });
+    }
+    fPending.push_back({aTree, &aTreeMutex});
+    if (!fThread.joinable()) fThread = std::thread(&AmoreOutputFlusher::ProcessQueue, this);
+    lock.unlock();
+    fCondition.notify_all();
+}
+
+// A null tree, which a recorder without that tree passes, has nothing to wait for. It would
+// otherwise match fFlushingTree of an idle thread.
+void AmoreOutputFlusher::Wait(const TTree *aTree) {
+    if (aTree == nullptr) return;
+    std::unique_lock<std::mutex> lock(fMutex);
+    fCondition.wait(lock, [this, aTree] {
+        if (fFlushingTree == aTree) return false;
+        for (const auto &nowRequest : fPending)
+            if (nowRequest.fTree == aTree) return false;
+        return true;
+    });
+}
+
+// The baskets are written under the mutex of the recorder. TFile::Flush() only synchronizes
+// the descriptor of the file, so that is done on a duplicate of it after the mutex is released.
+void AmoreOutputFlusher::ProcessQueue() {
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (true) {
+        fCondition.wait(lock, [this] { return fStopping || !fPending.empty(); });
+        if (fPending.empty()) return; // Stopping with nothing left
+        Request nowRequest = fPending.front();
+        fPending.pop_front();
+        fFlushingTree = nowRequest.fTree;
+        lock.unlock();
+        fCondition.notify_all(); // A blocked recorder may go on
+
+        int nowFD = -1;
+        {
+            std::lock_guard<std::mutex> treeLock(*nowRequest.fTreeMutex);
+            nowRequest.fTree->FlushBaskets();
+            if (nowRequest.fTree->GetCurrentFile() != nullptr)
+                nowFD = dup(nowRequest.fTree->GetCurrentFile()->GetFd());
+        }
+        if (nowFD >= 0) {
+            fsync(nowFD);
+            close(nowFD);
+        }
+
+        lock.lock();
+        fFlushingTree = nullptr;
+        fCondition.notify_all(); // Wait() may return
+    }
+}
@@ -0,0 +1,224 @@
+#include "AmoreSim/AmoreOverlapValidator.hh"
+#include "AmoreSim/AmoreHash.hh"
+
+#include "G4AffineTransform.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Material.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    G4String NameOf(const G4VPhysicalVolume *aPV) {
+        return aPV->GetName() + "[" + std::to_string(aPV->GetCopyNo()) + "]";
+    }
+
+    // Every logical volume of the world, each once, mothers before daughters
+    std::vector<const G4LogicalVolume *> CollectLVs(const G4VPhysicalVolume *aWorld) {
+        std::vector<const G4LogicalVolume *> LVs = {aWorld->GetLogicalVolume()};
+        std::set<const G4LogicalVolume *> visited = {aWorld->GetLogicalVolume()};
+        for (size_t i = 0; i < LVs.size(); i++) {
+            for (size_t j = 0; j < LVs[i]->GetNoDaughters(); j++) {
+                const G4LogicalVolume *nowLV = LVs[i]->GetDaughter(j)->GetLogicalVolume();
+                if (visited.insert(nowLV).second) LVs.push_back(nowLV);
+            }
+        }
+        return LVs;
+    }
+} // namespace
+
+AmoreOverlapValidator::AmoreOverlapValidator(G4int aResolution, G4int aNThreads)
+    : fResolution(aResolution), fNThreads(aNThreads) {}
+
+G4String AmoreOverlapValidator::MakeGeometryHash(const G4VPhysicalVolume *aWorld) const {
+    std::ostringstream geometry;
+    geometry << std::setprecision(12);
+    for (auto nowLV : CollectLVs(aWorld)) {
+        geometry << "LV " << nowLV->GetName() << " " << nowLV->GetMaterial()->GetName() << "\n";
+        nowLV->GetSolid()->StreamInfo(geometry);
+        for (size_t i = 0; i < nowLV->GetNoDaughters(); i++) {
+            const G4VPhysicalVolume *nowPV = nowLV->GetDaughter(i);
+            geometry << "PV " << NameOf(nowPV) << " " << nowPV->GetLogicalVolume()->GetName()
+                     << " " << nowPV->GetMultiplicity() << " " << nowPV->GetTranslation();
+            if (nowPV->GetRotation() != nullptr) geometry << " " << *nowPV->GetRotation();
+            geometry << "\n";
+        }
+    }
+    return AmoreHash::HexDigest(geometry.str());
+}
+
+G4int AmoreOverlapValidator::Validate(const G4VPhysicalVolume *aWorld, const G4String &aRecordDir,
+                                      G4bool aForce) {
+    G4String hash       = MakeGeometryHash(aWorld);
+    G4String recordFile = aRecordDir + "/" + hash + ".txt";
+
+    if (!aForce) {
+        std::ifstream record(recordFile.c_str());
+        G4String tag, recordedHash;
+        G4int recordedResolution = 0, recordedOverlaps = 0;
+        record >> tag >> recordedHash >> tag >> recordedResolution >> tag >> recordedOverlaps;
+        // A record with overlaps is checked again, so that they are reported every time
+        if (record.good() && recordedHash == hash && recordedResolution >= fResolution &&
+            recordedOverlaps == 0) {
+            G4cout << "Overlap validation: geometry " << hash << " has been checked with "
+                   << recordedResolution << " points per placement. Skipping the check."
+                   << G4endl;
+            return 0;
+        }
+    }
+
+    std::vector<Placement> placements;
+    for (auto nowLV : CollectLVs(aWorld)) {
+        for (size_t i = 0; i < nowLV->GetNoDaughters(); i++) {
+            const G4VPhysicalVolume *nowPV = nowLV->GetDaughter(i);
+            if (!nowPV->IsReplicated()) placements.push_back({nowLV, nowPV});
+        }
+    }
+
+    // The threads only call the const queries of the solids, which Geant4 also calls from
+    // several threads while tracking
+    SurfacePoints surfacePoints;
+    for (auto &nowPlacement : placements) {
+        for (size_t i = 0; i < nowPlacement.fMother->GetNoDaughters(); i++) {
+            const G4VSolid *nowSolid =
+                nowPlacement.fMother->GetDaughter(i)->GetLogicalVolume()->GetSolid();
+            std::vector<G4ThreeVector> &nowPoints = surfacePoints[nowSolid];
+            if (!nowPoints.empty()) continue;
+            nowPoints.reserve(fResolution);
+            for (G4int n = 0; n < fResolution; n++)
+                nowPoints.push_back(nowSolid->GetPointOnSurface());
+        }
+    }
+
+    G4int nThreads = (fNThreads > 0) ? fNThreads : std::thread::hardware_concurrency();
+    nThreads       = std::max(1, std::min<G4int>(nThreads, placements.size()));
+    G4cout << "Overlap validation: checking " << placements.size() << " placements of geometry "
+           << hash << " with " << fResolution << " points each on " << nThreads << " threads."
+           << G4endl;
+
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::vector<G4String>> overlapsOf(placements.size());
+    std::atomic<size_t> nextPlacement(0);
+    auto checkPlacements = [&]() {
+        for (size_t i = nextPlacement++; i < placements.size(); i = nextPlacement++)
+            CheckPlacement(placements[i], surfacePoints, overlapsOf[i]);
+    };
+    std::vector<std::thread> threads;
+    for (G4int i = 1; i < nThreads; i++)
+        threads.emplace_back(checkPlacements);
+    checkPlacements();
+    for (auto &nowThread : threads)
+        nowThread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    std::vector<G4String> overlaps;
+    for (auto &nowOverlaps : overlapsOf)
+        overlaps.insert(overlaps.end(), nowOverlaps.begin(), nowOverlaps.end());
+    for (auto &nowOverlap : overlaps)
+        G4cout << "Overlap validation: " << nowOverlap << G4endl;
+    G4cout << "Overlap validation: " << overlaps.size() << " overlaps found in "
+           << elapsed.count() << " s." << G4endl;
+    if (!overlaps.empty())
+        G4Exception(__PRETTY_FUNCTION__, "AMORE_OVERLAP", JustWarning,
+                    (std::to_string(overlaps.size()) + " overlaps have been found.").c_str());
+
+    // The record goes through a temporary file, so other jobs never read a partial one
+    std::error_code fsError;
+    fs::create_directories(aRecordDir, fsError);
+    G4String tempFile = recordFile + ".tmp" + std::to_string(getpid());
+    std::ofstream record(tempFile.c_str());
+    record << "hash " << hash << "\nresolution " << fResolution << "\noverlaps "
+           << overlaps.size() << "\n";
+    for (auto &nowOverlap : overlaps)
+        record << nowOverlap << "\n";
+    record.close();
+    if (!record || (fs::rename(tempFile, recordFile, fsError), fsError)) {
+        G4Exception(__PRETTY_FUNCTION__, "AMORE_OVERLAP_RECORD", JustWarning,
+                    ("The result cannot be recorded to " + recordFile).c_str());
+        fs::remove(tempFile, fsError);
+    }
+    return overlaps.size();
+}
+
+void AmoreOverlapValidator::CheckPlacement(const Placement &aPlacement,
+                                           const SurfacePoints &aSurfacePoints,
+                                           std::vector<G4String> &aOverlaps) const {
+    const G4VPhysicalVolume *thePV = aPlacement.fDaughter;
+    const G4VSolid *theSolid       = thePV->GetLogicalVolume()->GetSolid();
+    const G4VSolid *motherSolid    = aPlacement.fMother->GetSolid();
+    G4AffineTransform toMother(thePV->GetRotation(), thePV->GetTranslation());
+    G4AffineTransform fromMother = toMother.Inverse();
+
+    struct Sister {
+        const G4VPhysicalVolume *fPV;
+        const G4VSolid *fSolid;
+        G4AffineTransform fToMother;
+        G4AffineTransform fFromMother;
+        G4double fMaxDepth;
+    };
+    std::vector<Sister> sisters;
+    for (size_t i = 0; i < aPlacement.fMother->GetNoDaughters(); i++) {
+        const G4VPhysicalVolume *nowPV = aPlacement.fMother->GetDaughter(i);
+        if (nowPV == thePV) continue;
+        G4AffineTransform nowToMother(nowPV->GetRotation(), nowPV->GetTranslation());
+        sisters.push_back({nowPV, nowPV->GetLogicalVolume()->GetSolid(), nowToMother,
+                           nowToMother.Inverse(), 0.});
+    }
+
+    // Points on the surface of this placement must not be outside of the mother nor inside
+    // of any sister
+    G4double motherDepth = 0;
+    for (const auto &nowPoint : aSurfacePoints.at(theSolid)) {
+        G4ThreeVector pointInMother = toMother.TransformPoint(nowPoint);
+        if (motherSolid->Inside(pointInMother) == kOutside)
+            motherDepth = std::max(motherDepth, motherSolid->DistanceToIn(pointInMother));
+        for (auto &nowSister : sisters) {
+            G4ThreeVector pointInSister = nowSister.fFromMother.TransformPoint(pointInMother);
+            if (nowSister.fSolid->Inside(pointInSister) == kInside)
+                nowSister.fMaxDepth = std::max(nowSister.fMaxDepth,
+                                               nowSister.fSolid->DistanceToOut(pointInSister));
+        }
+    }
+
+    std::ostringstream overlap;
+    if (motherDepth > 0) {
+        overlap << NameOf(thePV) << " protrudes from its mother "
+                << aPlacement.fMother->GetName() << " by " << motherDepth / mm << " mm";
+        aOverlaps.push_back(overlap.str());
+    }
+    for (auto &nowSister : sisters) {
+        overlap.str("");
+        if (nowSister.fMaxDepth > 0) {
+            overlap << NameOf(thePV) << " overlaps with " << NameOf(nowSister.fPV) << " in "
+                    << aPlacement.fMother->GetName() << " by " << nowSister.fMaxDepth / mm
+                    << " mm";
+            aOverlaps.push_back(overlap.str());
+            continue;
+        }
+        // A sister totally inside of this placement has no surface point inside of the other
+        const std::vector<G4ThreeVector> &pointsOfSister = aSurfacePoints.at(nowSister.fSolid);
+        if (pointsOfSister.empty()) continue;
+        G4ThreeVector pointOfSister = pointsOfSister.front();
+        G4ThreeVector pointInThis =
+            fromMother.TransformPoint(nowSister.fToMother.TransformPoint(pointOfSister));
+        if (theSolid->Inside(pointInThis) == kInside) {
+            overlap << NameOf(nowSister.fPV) << " is totally included in " << NameOf(thePV)
+                    << " in " << aPlacement.fMother->GetName();
+            aOverlaps.push_back(overlap.str());
+        }
+    }
+}
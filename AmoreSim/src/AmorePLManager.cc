@@ -3,6 +3,7 @@
 
 #include "AmoreSim/AmorePLManager.hh"
 #include "AmoreSim/AmorePhysicsList.hh"
+#include "AmoreSim/AmorePhysicsTableCache.hh"
 
 #include <cstdlib>
 #include <iostream>
@@ -20,7 +21,7 @@ using namespace std;
 AmorePLManager::AmorePLManager(const std::string &db_name)
     : fBuilt(false), fInitialized(false), fBuildOptical(false), fEnableScintillation(false),
       fEnableCerenkov(false), fOmitHadronPhys(false), fThermalNeutron(false), fUseCupPL(false),
-      fPhysicsList(nullptr), fDB(CupStrParam::GetDB()) {
+      fUseTableCache(false), fTableCache(nullptr), fPhysicsList(nullptr), fDB(CupStrParam::GetDB()) {
     cout << "AmorePLManager -- uses database file" << db_name << endl;
     OpenDBFile(db_name);
     Initialize();
@@ -30,7 +31,7 @@ AmorePLManager::AmorePLManager(const std::string &db_name)
 AmorePLManager::AmorePLManager()
     : fBuilt(false), fInitialized(false), fBuildOptical(false), fEnableScintillation(false),
       fEnableCerenkov(false), fOmitHadronPhys(false), fThermalNeutron(false), fUseCupPL(false),
-      fPhysicsList(nullptr), fDB(CupStrParam::GetDB()) {
+      fUseTableCache(false), fTableCache(nullptr), fPhysicsList(nullptr), fDB(CupStrParam::GetDB()) {
     cout << "AmorePLManager -- uses default database file name PL_settings.dat" << endl;
     OpenDBFile("PL_settings.dat");
     Initialize();
@@ -39,6 +40,7 @@ AmorePLManager::AmorePLManager()
 
 AmorePLManager::~AmorePLManager() {
     cout << "Deleting AmorePLManager..." << endl;
+    delete fTableCache;
     delete fPhysicsList;
     delete fDummyMessenger;
     if (--fgPLManCnt == 0) {
@@ -75,6 +77,17 @@ void AmorePLManager::OpenDBFile(const std::string &db_name) {
 void AmorePLManager::Initialize() {
     if (fBuilt) return;
 
+    // AMORESIM_PHYSTABLE_CACHE overrides the cache directory. "off" or "" disables the cache.
+    G4String useTableCacheStr = fDB.GetWithDefault("PhysicsTableCache", "false");
+    fUseTableCache            = (useTableCacheStr == "true");
+    fTableCacheDir            = fDB.GetWithDefault("PhysicsTableCacheDir", "physics_table_cache");
+    char *lEnvStrTableCache   = getenv("AMORESIM_PHYSTABLE_CACHE");
+    if (lEnvStrTableCache != nullptr) {
+        fTableCacheDir = lEnvStrTableCache;
+        fUseTableCache = !(fTableCacheDir.empty() || fTableCacheDir == "off");
+    }
+    if (fUseTableCache) cout << "Physics table cache directory: " << fTableCacheDir << endl;
+
     G4String useCupPLStr = fDB.GetWithDefault("UseCupPhysList", "false");
     fUseCupPL            = (useCupPLStr == "true");
     if (fUseCupPL) {
@@ -129,7 +142,10 @@ void AmorePLManager::BuildPhysicsList() {
 
     if (fUseCupPL) {
         fPhysicsList = new AmorePhysicsList();
-        fBuilt       = true;
+        if (fUseTableCache)
+            fTableCache =
+                new AmorePhysicsTableCache(fPhysicsList, fTableCacheDir, "AmorePhysicsList");
+        fBuilt = true;
         return;
     }
 
@@ -178,6 +194,9 @@ void AmorePLManager::BuildPhysicsList() {
         if (fThermalNeutron) fPhysicsList->RegisterPhysics(new G4ThermalNeutrons(0));
     }
 
+    if (fUseTableCache)
+        fTableCache =
+            new AmorePhysicsTableCache(fPhysicsList, fTableCacheDir, fRefPLName + fEMPhysName);
     fBuilt = true;
 }
 
@@ -0,0 +1,188 @@
+#include "AmoreSim/AmorePhysicsTableCache.hh"
+#include "AmoreSim/AmoreHash.hh"
+
+#include "G4Element.hh"
+#include "G4EmParameters.hh"
+#include "G4Material.hh"
+#include "G4ParticleTable.hh"
+#include "G4ProcessManager.hh"
+#include "G4ProcessVector.hh"
+#include "G4ProductionCuts.hh"
+#include "G4ProductionCutsTable.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4StateManager.hh"
+#include "G4VExceptionHandler.hh"
+#include "G4VProcess.hh"
+#include "G4VUserPhysicsList.hh"
+#include "G4Version.hh"
+#include "G4ios.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char *kKeyFileName = "cache_key.txt";
+
+    // A process whose table can't be read is built instead, and only an exception raised from
+    // one of the Retrieve methods tells about it. The exceptions are passed on unchanged.
+    class RetrieveFailureCounter : public G4VExceptionHandler {
+      public:
+        RetrieveFailureCounter(G4VExceptionHandler *aNext, G4int &aNFailures)
+            : G4VExceptionHandler(), fNext(aNext), fNFailures(aNFailures) {}
+        virtual G4bool Notify(const char *originOfException, const char *exceptionCode,
+                              G4ExceptionSeverity severity, const char *description) {
+            if (strstr(originOfException, "Retrieve") != nullptr) fNFailures++;
+            if (fNext != nullptr)
+                return fNext->Notify(originOfException, exceptionCode, severity, description);
+            G4cerr << originOfException << " (" << exceptionCode << "): " << description
+                   << G4endl;
+            return severity == FatalException || severity == FatalErrorInArgument;
+        }
+
+      private:
+        G4VExceptionHandler *fNext;
+        G4int &fNFailures;
+    };
+} // namespace
+
+AmorePhysicsTableCache::AmorePhysicsTableCache(G4VUserPhysicsList *aPhysicsList,
+                                               const G4String &aCacheDir,
+                                               const G4String &aListLabel)
+    : G4VStateDependent(), fPhysicsList(aPhysicsList), fCacheDir(aCacheDir),
+      fListLabel(aListLabel), fChecked(false), fRetrieving(false), fStorePending(false),
+      fFailureCounter(nullptr), fPreviousHandler(nullptr), fNRetrieveFailures(0) {}
+
+// The tables are built in the Idle -> Init -> Idle transitions at the beginning of the first
+// run. /run/initialize goes from PreInit to Init and is not concerned.
+G4bool AmorePhysicsTableCache::Notify(G4ApplicationState requestedState) {
+    G4ApplicationState currentState = G4StateManager::GetStateManager()->GetCurrentState();
+    if (!fChecked && currentState == G4State_Idle && requestedState == G4State_Init) {
+        fChecked = true;
+        LookUp();
+    } else if (fStorePending && currentState == G4State_Init && requestedState == G4State_Idle) {
+        fStorePending = false;
+        if (fFailureCounter != nullptr) {
+            G4StateManager::GetStateManager()->SetExceptionHandler(fPreviousHandler);
+            delete fFailureCounter;
+            fFailureCounter = nullptr;
+        }
+        // The physics list resets the retrieved flag only when the cut table can't be read
+        G4bool retrieved = fRetrieving && fPhysicsList->IsPhysicsTableRetrieved() &&
+                           fNRetrieveFailures == 0;
+        if (retrieved) {
+            G4cout << "Physics tables have been retrieved from " << fEntryDir << G4endl;
+            return true;
+        }
+        if (fRetrieving)
+            G4Exception(__PRETTY_FUNCTION__, "PTCACHE_RETRIEVE_FAIL", JustWarning,
+                        ("Retrieving physics tables from " + fEntryDir + " has been failed (" +
+                         std::to_string(fNRetrieveFailures) +
+                         " failures reported). The entry will be stored again.")
+                            .c_str());
+        Store();
+    }
+    return true;
+}
+
+G4String AmorePhysicsTableCache::MakeKey() const {
+    std::ostringstream key;
+    key << std::setprecision(12);
+    key << "Geant4 " << G4VERSION_NUMBER << "\n";
+    key << "PhysicsList " << fListLabel << "\n";
+
+    G4ParticleTable::G4PTblDicIterator *particleIter =
+        G4ParticleTable::GetParticleTable()->GetIterator();
+    particleIter->reset();
+    while ((*particleIter)()) {
+        G4ParticleDefinition *nowParticle = particleIter->value();
+        G4ProcessManager *nowPManager     = nowParticle->GetProcessManager();
+        if (nowPManager == nullptr) continue;
+        key << "Particle " << nowParticle->GetParticleName() << ":";
+        G4ProcessVector *nowProcesses = nowPManager->GetProcessList();
+        for (size_t i = 0; i < nowProcesses->size(); i++)
+            key << " " << (*nowProcesses)[i]->GetProcessName();
+        key << "\n";
+    }
+
+    G4EmParameters::Instance()->StreamInfo(key);
+
+    G4ProductionCutsTable *cutsTable = G4ProductionCutsTable::GetProductionCutsTable();
+    key << "CutsEnergyRange " << cutsTable->GetLowEdgeEnergy() << " "
+        << cutsTable->GetHighEdgeEnergy() << "\n";
+    key << "DefaultCut " << fPhysicsList->GetDefaultCutValue() << "\n";
+    for (auto nowRegion : *G4RegionStore::GetInstance()) {
+        G4ProductionCuts *nowCuts = nowRegion->GetProductionCuts();
+        key << "Region " << nowRegion->GetName() << ":";
+        if (nowCuts != nullptr)
+            for (auto nowCut : nowCuts->GetProductionCuts())
+                key << " " << nowCut;
+        key << "\n";
+    }
+
+    for (auto nowMaterial : *G4Material::GetMaterialTable()) {
+        key << "Material " << nowMaterial->GetName() << ": " << nowMaterial->GetDensity() << " "
+            << nowMaterial->GetState() << " " << nowMaterial->GetTemperature() << " "
+            << nowMaterial->GetPressure() << " "
+            << nowMaterial->GetIonisation()->GetMeanExcitationEnergy();
+        const G4double *fractions = nowMaterial->GetFractionVector();
+        for (size_t i = 0; i < nowMaterial->GetNumberOfElements(); i++)
+            key << " " << nowMaterial->GetElement(i)->GetName() << "=" << fractions[i];
+        key << "\n";
+    }
+    return key.str();
+}
+
+void AmorePhysicsTableCache::LookUp() {
+    fKey      = MakeKey();
+    fEntryDir = fCacheDir + "/" + AmoreHash::HexDigest(fKey);
+
+    std::ifstream keyFile(fEntryDir + "/" + kKeyFileName);
+    std::ostringstream storedKey;
+    if (keyFile.good()) storedKey << keyFile.rdbuf();
+
+    fRetrieving   = keyFile.good() && storedKey.str() == fKey;
+    fStorePending = true;
+    if (fRetrieving) {
+        G4cout << "Physics table cache: retrieving the tables from " << fEntryDir << G4endl;
+        fPhysicsList->SetPhysicsTableRetrieved(fEntryDir);
+        // The handler registers itself to the state manager when constructed
+        fPreviousHandler = G4StateManager::GetStateManager()->GetExceptionHandler();
+        fFailureCounter  = new RetrieveFailureCounter(fPreviousHandler, fNRetrieveFailures);
+        G4StateManager::GetStateManager()->SetExceptionHandler(fFailureCounter);
+    } else {
+        G4cout << "Physics table cache: no entry for this setup. The tables will be stored to "
+               << fEntryDir << G4endl;
+    }
+}
+
+// The tables are written to a temporary directory which is renamed at the end, so that jobs
+// running at the same time never see a half-written entry.
+void AmorePhysicsTableCache::Store() {
+    G4String tempDir = fEntryDir + ".tmp" + std::to_string(getpid());
+    std::error_code fsError;
+    fs::remove_all(tempDir, fsError);
+    fs::create_directories(tempDir, fsError);
+    if (fsError || !fPhysicsList->StorePhysicsTable(tempDir)) {
+        G4Exception(__PRETTY_FUNCTION__, "PTCACHE_STORE_FAIL", JustWarning,
+                    ("Storing physics tables to " + tempDir + " has been failed.").c_str());
+        fs::remove_all(tempDir, fsError);
+        return;
+    }
+    std::ofstream(tempDir + "/" + kKeyFileName) << fKey;
+
+    if (fRetrieving) fs::remove_all(fEntryDir, fsError);
+    fs::rename(tempDir, fEntryDir, fsError);
+    if (fsError) {
+        // Another job has stored the same entry in the meantime
+        fs::remove_all(tempDir, fsError);
+        return;
+    }
+    G4cout << "Physics table cache: the tables have been stored to " << fEntryDir << G4endl;
+}
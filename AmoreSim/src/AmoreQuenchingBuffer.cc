@@ -0,0 +1,122 @@
+#include "AmoreSim/AmoreQuenchingBuffer.hh"
+#include "AmoreSim/AmoreModuleHit.hh"
+
+#include "G4Electron.hh"
+#include "G4EmSaturation.hh"
+#include "G4IonisParamMat.hh"
+#include "G4LossTableManager.hh"
+#include "G4Material.hh"
+#include "G4MaterialCutsCouple.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4Step.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+
+#include "TTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+void AmoreQuenchingSteps::Branch(TTree *aTree) {
+    aTree->Branch("Quenching_ModuleID", &fModuleID);
+    aTree->Branch("Quenching_Eloss", &fEloss);
+    aTree->Branch("Quenching_Length", &fLength);
+    aTree->Branch("Quenching_Niel", &fNiel);
+    aTree->Branch("Quenching_NielRange", &fNielRange);
+}
+
+void AmoreQuenchingSteps::Clear() {
+    fModuleID.clear();
+    fEloss.clear();
+    fLength.clear();
+    fNiel.clear();
+    fNielRange.clear();
+}
+
+void AmoreQuenchingBuffer::Add(G4int aModuleID, const G4Step *aStep) {
+    fEntries.push_back({aModuleID, aStep->GetTrack()->GetDefinition(),
+                        aStep->GetPreStepPoint()->GetMaterialCutsCouple(),
+                        aStep->GetTotalEnergyDeposit(), aStep->GetNonIonizingEnergyDeposit(),
+                        aStep->GetStepLength()});
+}
+
+// Charged steps of some length without a non-ionizing part, nearly all of them, need the Birks
+// formula only.
+// The others are left to G4EmSaturation, which looks up the ranges in its tables.
+void AmoreQuenchingBuffer::Quench(const std::vector<AmoreModuleHit *> &aHits) {
+    G4EmSaturation *emSaturation          = G4LossTableManager::Instance()->EmSaturation();
+    const G4MaterialCutsCouple *nowCouple = nullptr;
+    G4double nowKB                        = 0.;
+
+    for (const auto &nowEntry : fEntries) {
+        if (nowEntry.fCouple != nowCouple) {
+            nowCouple = nowEntry.fCouple;
+            nowKB     = nowCouple->GetMaterial()->GetIonisation()->GetBirksConstant();
+        }
+
+        G4double nowVisible;
+        if (nowKB <= 0.)
+            nowVisible = nowEntry.fEdep;
+        else if (nowEntry.fNiel <= 0. && nowEntry.fLength > 0. &&
+                 nowEntry.fParticle->GetPDGCharge() != 0.)
+            nowVisible = Quench(nowKB, nowEntry.fEdep, nowEntry.fLength);
+        else
+            nowVisible = emSaturation->VisibleEnergyDeposition(
+                nowEntry.fParticle, nowEntry.fCouple, nowEntry.fLength, nowEntry.fEdep,
+                nowEntry.fNiel);
+
+        aHits[nowEntry.fModuleID]->AddCrystalQEdep(nowVisible);
+        if (fKeepSteps) KeepStep(nowEntry, nowKB, nowVisible);
+    }
+    fEntries.clear();
+}
+
+void AmoreQuenchingBuffer::Clear() {
+    fEntries.clear();
+    fSteps.Clear();
+}
+
+// The columns follow the cases of G4EmSaturation::VisibleEnergyDeposition. The range of the
+// non-ionizing part is taken back from the energy it has quenched.
+void AmoreQuenchingBuffer::KeepStep(const Entry &aEntry, G4double aKB, G4double aVisible) {
+    G4double eloss = 0., length = 0., niel = 0., nielRange = 0.;
+    G4int pdgCode  = aEntry.fParticle->GetPDGEncoding();
+
+    if (aEntry.fEdep > 0. && pdgCode == 22) {
+        eloss  = aEntry.fEdep;
+        length = G4LossTableManager::Instance()->GetRange(G4Electron::Electron(), aEntry.fEdep,
+                                                          aEntry.fCouple);
+    } else if (aEntry.fEdep > 0.) {
+        niel  = std::max(aEntry.fNiel, 0.);
+        eloss = aEntry.fEdep - niel;
+        if (pdgCode == 2112 || eloss < 0. || aEntry.fLength <= 0.) {
+            niel  = aEntry.fEdep;
+            eloss = 0.;
+        } else {
+            length = aEntry.fLength;
+        }
+    }
+
+    G4double nielVisible = aVisible - (aKB > 0. ? Quench(aKB, eloss, length) : eloss);
+    if (niel > 0. && aKB > 0. && nielVisible > 0. && nielVisible < niel)
+        nielRange = aKB * niel * nielVisible / (niel - nielVisible);
+
+    G4double requenched = Requench(aKB, eloss, length, niel, nielRange);
+    if (!fMismatchReported && std::abs(requenched - aVisible) > 1e-6 * aVisible) {
+        fMismatchReported = true;
+        std::ostringstream message;
+        message << "A kept step of module " << aEntry.fModuleID << " gives " << requenched / keV
+                << " keV instead of " << aVisible / keV
+                << " keV when quenched again. Reported once.";
+        G4Exception(__PRETTY_FUNCTION__, "QUENCH_KEEP_MISMATCH", JustWarning,
+                    message.str().c_str());
+    }
+
+    fSteps.fModuleID.push_back(aEntry.fModuleID);
+    fSteps.fEloss.push_back(eloss);
+    fSteps.fLength.push_back(length);
+    fSteps.fNiel.push_back(niel);
+    fSteps.fNielRange.push_back(nielRange);
+}
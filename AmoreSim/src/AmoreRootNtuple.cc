@@ -7,20 +7,28 @@
 //
 //
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 #include <string>
 
+#include "G4AutoLock.hh"
 #include "G4RunManager.hh"
 #include "G4UImanager.hh"
 #include "G4UItcsh.hh"
 #include "G4UIterminal.hh"
 
 #include "AmoreSim/AmoreDetectorConstruction.hh"
+#include "AmoreSim/AmoreLog.hh"
 #include "AmoreSim/AmoreModuleSD.hh"
+#include "AmoreSim/AmoreOutputFlusher.hh"
 #include "AmoreSim/AmoreRootNtuple.hh"
 #include "AmoreSim/AmoreRootNtupleMessenger.hh"
 #include "AmoreSim/AmoreScintSD.hh"
 #include "AmoreSim/AmoreScintillation.hh"
+#include "AmoreSim/AmoreStartupProfiler.hh"
+#include "AmoreSim/AmoreSubEventManager.hh"
 #include "AmoreSim/AmoreTrackInformation.hh"
 #include "CupSim/CupScintHit.hh"
 #include "CupSim/CupParam.hh"
@@ -32,7 +40,10 @@
 #include "CupSim/CupVetoSD.hh"
 
 // Include files for ROOT.
+#include "Compression.h"
+#include "RVersion.h"
 #include "Rtypes.h"
+#include "TFileMerger.h"
 
 // Include files for the G4 classes
 #include "G4Event.hh"
@@ -51,10 +62,29 @@ using namespace std;
 
 TROOT theROOT("AmoreSim/Amoresim", "AMoRE Geant4 simulation output tree");
 
+namespace {
+    G4Mutex workerRecorderMutex = G4MUTEX_INITIALIZER;
+
+    G4VHitsCollection *FindHitsCollection(const G4Event *aEvent, const G4String &aName) {
+        G4int collectionID      = G4SDManager::GetSDMpointer()->GetCollectionID(aName);
+        G4HCofThisEvent *theHCE = aEvent->GetHCofThisEvent();
+        if (collectionID < 0 || theHCE == nullptr) return nullptr;
+        return theHCE->GetHC(collectionID);
+    }
+
+    // Bounds of the basket memory of the output tree in the auto mode of /ntuple/basketSize
+    constexpr Long64_t kMinAutoBasketMemory = 1000000;
+    constexpr Long64_t kMaxAutoBasketMemory = 256000000;
+}
+
 AmoreRootNtuple::AmoreRootNtuple()
     : CupRootNtuple(), fRecordedEvt(0), fRecordWithCut(false), fRecordPrimary(false),
-      myAmoreNtupleMessenger(nullptr), fEvtInfos(nullptr), fPrimAtCB(nullptr), fPrimAtOVC(nullptr),
-			fOutputForPrim(nullptr) {
+      fCompactStep(false), fCompressionSettings(-1), fBasketSize(0), fAutoBasketEvents(0),
+      fBasketsOptimized(false), fAutoFlush(0), fEvtMod(kEvtMod), fEvtModForPrim(kEvtModForPrim),
+      fStepDictionary(&fVolumeTable), fDeferredQuenching(false), fKeepQuenchingSteps(false),
+      myAmoreNtupleMessenger(nullptr),
+      fEvtInfos(nullptr), fPrimAtCB(nullptr), fPrimAtOVC(nullptr),
+			fOutputForPrim(nullptr), fMasterRecorder(nullptr), fOutputMode(false), fForkChildren(0) {
     fModuleArray           = nullptr;
     EndTrackList           = new std::vector<TTrack *>;
     myAmoreNtupleMessenger = new AmoreRootNtupleMessenger(this);
@@ -65,16 +95,89 @@ AmoreRootNtuple::AmoreRootNtuple()
 AmoreRootNtuple::~AmoreRootNtuple() {
     CloseFile();
     ClearET();
+    for (auto nowTrack : fEndTrackPool)
+        delete nowTrack;
+
+    if (fMasterRecorder != nullptr) {
+        G4AutoLock lock(&workerRecorderMutex);
+        auto &workers = fMasterRecorder->fWorkerRecorders;
+        workers.erase(std::remove(workers.begin(), workers.end(), this), workers.end());
+    }
 
     delete EndTrackList;
     delete myAmoreNtupleMessenger;
     delete fEvtInfo_VolumeTbl;
 }
 
-void AmoreRootNtuple::OpenFile(const G4String filename, G4bool outputmode) {
+// Called from AmoreActionInitialization::Build() on each worker thread. The worker gets the
+// recording options that were given to the master before /run/initialize, since PreInit-only
+// commands are not replayed on the workers.
+AmoreRootNtuple *AmoreRootNtuple::CreateWorkerRecorder() {
+    AmoreRootNtuple *newRecorder = new AmoreRootNtuple;
+
+    newRecorder->fMasterRecorder      = this;
+    newRecorder->fRecordWithCut       = fRecordWithCut;
+    newRecorder->fRecordPrimary       = fRecordPrimary;
+    newRecorder->fCompactStep         = fCompactStep;
+    newRecorder->fStepFilter          = fStepFilter;
+    newRecorder->fEventFilter         = fEventFilter;
+    newRecorder->fDeferredQuenching   = fDeferredQuenching;
+    newRecorder->fKeepQuenchingSteps  = fKeepQuenchingSteps;
+    newRecorder->fCompressionSettings = fCompressionSettings;
+    newRecorder->fBasketSize          = fBasketSize;
+    newRecorder->fAutoBasketEvents    = fAutoBasketEvents;
+    newRecorder->fAutoFlush           = fAutoFlush;
+    newRecorder->fEvtMod              = fEvtMod;
+    newRecorder->fEvtModForPrim       = fEvtModForPrim;
+    newRecorder->StatusPrimary        = StatusPrimary;
+    newRecorder->StatusTrack          = StatusTrack;
+    newRecorder->StatusStep           = StatusStep;
+    newRecorder->StatusPhoton         = StatusPhoton;
+    newRecorder->StatusScint          = StatusScint;
+    newRecorder->StatusMuon           = StatusMuon;
+
+    G4AutoLock lock(&workerRecorderMutex);
+    fWorkerRecorders.push_back(newRecorder);
+    return newRecorder;
+}
+
+// Called in a child process right after the fork. The output requested before the fork is
+// opened here under the name of the child.
+void AmoreRootNtuple::BecomeForkChild(G4int aIndex) {
+    fForkChildren = 0;
+    fForkSuffix   = "_f" + std::to_string(aIndex);
+    fForkOutputs.clear();
+    if (!fOutputBaseName.empty()) OpenFile(fOutputBaseName, fOutputMode);
+}
+
+// The master of the MT mode has no output of its own, since /event/output_file only exists
+// on the workers. The name given to its workers is returned instead.
+G4String AmoreRootNtuple::GetOutputBaseName() const {
+    if (!fOutputBaseName.empty()) return fOutputBaseName;
+    G4AutoLock lock(&workerRecorderMutex);
+    for (auto nowWorker : fWorkerRecorders)
+        if (!nowWorker->fOutputBaseName.empty()) return nowWorker->fOutputBaseName;
+    return G4String();
+}
+
+void AmoreRootNtuple::OpenFile(const G4String aFileName, G4bool outputmode) {
+    // Every worker writes its own part file, and the master merges the parts into aFileName
+    // when it closes the file.
+    G4String filename = fOutputBaseName = aFileName;
+    fOutputMode       = outputmode;
+    if (fForkChildren > 0) {
+        if (std::find(fForkOutputs.begin(), fForkOutputs.end(), aFileName) == fForkOutputs.end())
+            fForkOutputs.push_back(aFileName);
+        return;
+    }
+    filename += fForkSuffix;
+    if (IsWorkerRecorder()) filename += "_t" + std::to_string(G4Threading::G4GetThreadId());
+
     if (fRecordPrimary) {
         fOutputForPrim = new TFile((filename + "_prim" + ".root").c_str(), "RECREATE",
                                    "Output file for primrary generation");
+        if (fCompressionSettings >= 0)
+            fOutputForPrim->SetCompressionSettings(fCompressionSettings);
 
         fValuesForPrim[0] = fValuesForPrim[1] = fValuesForPrim[2] = fValuesForPrim[3] =
             fValuesForPrim[4] = fValuesForPrim[5] = fValuesForPrim[6] = fValuesForPrim[7] =
@@ -93,6 +196,9 @@ void AmoreRootNtuple::OpenFile(const G4String filename, G4bool outputmode) {
 }
 
 void AmoreRootNtuple::CreateTree() {
+    AmoreStartupProfiler::Scope createTreeScope("CreateTree");
+    // Branches take the compression of the file when they are created
+    if (fCompressionSettings >= 0) fROOTOutputFile->SetCompressionSettings(fCompressionSettings);
     CupRootNtuple::CreateTree();
 
     // Sensitive Detector for crystal detectors
@@ -115,10 +221,20 @@ void AmoreRootNtuple::CreateTree() {
             "AmoreModuleSD",
             "A DetectorArray object of detector module array for simulation of AMoRE", nameList);
         fROOTOutputTree->Branch("MDSD", &fModuleArray, 512000, 2);
+
+        fQuenchingBuffer.SetKeepSteps(fKeepQuenchingSteps);
+        moduleSD->SetQuenchingBuffer(fDeferredQuenching ? &fQuenchingBuffer : nullptr);
+        if (fKeepQuenchingSteps) fQuenchingBuffer.GetSteps().Branch(fROOTOutputTree);
     }
 
     fROOTOutputTree->Branch("EndTrack", &EndTrackList);
 
+    if (fCompactStep && StatusStep) fCompactSteps.Branch(fROOTOutputTree);
+
+    if (fBasketSize > 0) fROOTOutputTree->SetBasketSize("*", fBasketSize);
+    if (fAutoFlush != 0) fROOTOutputTree->SetAutoFlush(fAutoFlush);
+    fBasketsOptimized = false;
+
     if (fRecordPrimary) {
         fOutputForPrim->cd();
         fEvtInfos = new TTree("EvtInfos", "Event information for primary records");
@@ -153,6 +269,57 @@ void AmoreRootNtuple::CreateTree() {
 }
 
 void AmoreRootNtuple::CloseFile() {
+    // The parent of the fork mode has no file of its own. Its children have finished here.
+    if (fForkChildren > 0) {
+        for (auto &nowOutput : fForkOutputs) {
+            std::vector<G4String> mainParts, primParts;
+            for (G4int i = 0; i < fForkChildren; i++) {
+                G4String nowPart = nowOutput + "_f" + std::to_string(i);
+                if (std::ifstream(nowPart + ".root").good()) mainParts.push_back(nowPart + ".root");
+                if (std::ifstream(nowPart + "_prim.root").good())
+                    primParts.push_back(nowPart + "_prim.root");
+            }
+            if (MergeOutputFiles(nowOutput + ".root", mainParts, fCompressionSettings) &&
+                mainParts.size() > 1)
+                DeduplicateMetadata(nowOutput + ".root", fCompactStep);
+            MergeOutputFiles(nowOutput + "_prim.root", primParts, fCompressionSettings);
+        }
+        fForkOutputs.clear();
+        return;
+    }
+
+    // The master closes the worker files once the event loop is over and the workers are idle,
+    // then merges the parts of each output into one file with the usual branch layout.
+    if (!IsWorkerRecorder()) {
+        std::map<G4String, std::vector<G4String>> mainParts, primParts;
+        {
+            G4AutoLock lock(&workerRecorderMutex);
+            for (auto nowWorker : fWorkerRecorders) {
+                if (nowWorker->fROOTOutputFile != nullptr)
+                    mainParts[nowWorker->fOutputBaseName].push_back(
+                        nowWorker->fROOTOutputFile->GetName());
+                if (nowWorker->fOutputForPrim != nullptr)
+                    primParts[nowWorker->fOutputBaseName].push_back(
+                        nowWorker->fOutputForPrim->GetName());
+                nowWorker->CloseFile();
+            }
+        }
+        for (auto &nowParts : mainParts)
+            if (MergeOutputFiles(nowParts.first + ".root", nowParts.second,
+                                 fCompressionSettings) &&
+                nowParts.second.size() > 1)
+                DeduplicateMetadata(nowParts.first + ".root", fCompactStep);
+        for (auto &nowParts : primParts)
+            MergeOutputFiles(nowParts.first + "_prim.root", nowParts.second,
+                             fCompressionSettings);
+    }
+
+    // The background flushes of the trees are over before their files are written
+    AmoreOutputFlusher *flusher = AmoreOutputFlusher::GetInstance();
+    flusher->Wait(fROOTOutputTree);
+    flusher->Wait(fPrimAtCB);
+    flusher->Wait(fPrimAtOVC);
+
     if (fRecordPrimary && fOutputForPrim != nullptr) {
         fOutputForPrim->Write();
         fOutputForPrim->Close();
@@ -162,11 +329,104 @@ void AmoreRootNtuple::CloseFile() {
 				fPrimAtOVC     = nullptr;
         fOutputForPrim = nullptr;
     }
+    // Every file carries the tables of its volume and step IDs
+    if (fROOTOutputFile != nullptr) {
+        fROOTOutputFile->cd();
+        if (fVolumeTable.IsBuilt()) fVolumeTable.Write();
+        if (fCompactStep && StatusStep) {
+            if (!fStepDictionary.IsBuilt()) fStepDictionary.Build();
+            fStepDictionary.Write();
+        }
+    }
     CupRootNtuple::CloseFile();
 }
 
+// Merges the closed part files into aTarget and removes the parts. The parts are kept when the
+// merging fails, so that nothing is lost. The merged file is written with the compression of
+// the parts, since the merger would otherwise recompress every basket with the default one.
+G4bool AmoreRootNtuple::MergeOutputFiles(const G4String &aTarget,
+                                         const std::vector<G4String> &aParts,
+                                         G4int aCompressionSettings) {
+    if (aParts.empty()) return true;
+    if (aParts.size() == 1 && std::rename(aParts[0].c_str(), aTarget.c_str()) == 0) return true;
+
+    TFileMerger merger(kFALSE, kFALSE);
+    merger.SetPrintLevel(0);
+    G4bool success = aCompressionSettings >= 0
+                         ? merger.OutputFile(aTarget.c_str(), "RECREATE", aCompressionSettings)
+                         : merger.OutputFile(aTarget.c_str(), "RECREATE");
+    for (auto &nowPart : aParts)
+        success = success && merger.AddFile(nowPart.c_str(), kFALSE);
+    success = success && merger.Merge();
+
+    if (!success) {
+        G4Exception(__PRETTY_FUNCTION__, "MERGE_FAIL", JustWarning,
+                    ("Merging the worker outputs into " + aTarget +
+                     " has been failed. The part files are kept.")
+                        .c_str());
+        return false;
+    }
+    for (auto &nowPart : aParts)
+        std::remove(nowPart.c_str());
+    return true;
+}
+
+// Levels go from 0 (no compression) to 9. zstd needs ROOT 6.20 or later.
+void AmoreRootNtuple::SetCompression(const G4String &aAlgorithm, G4int aLevel) {
+    using eAlgorithm = ROOT::RCompressionSetting::EAlgorithm;
+    static const std::map<G4String, eAlgorithm::EValues> algorithms = {
+        {"default", eAlgorithm::kUseGlobal},
+        {"zlib", eAlgorithm::kZLIB},
+        {"lzma", eAlgorithm::kLZMA},
+        {"lz4", eAlgorithm::kLZ4},
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 20, 0)
+        {"zstd", eAlgorithm::kZSTD},
+#endif
+    };
+    auto result = algorithms.find(aAlgorithm);
+    if (result == algorithms.end()) {
+        G4Exception(__PRETTY_FUNCTION__, "NTUPLE_NOCOMPRESSION", JustWarning,
+                    ("This build of ROOT has no " + aAlgorithm +
+                     " compression. The compression will not be changed.")
+                        .c_str());
+        return;
+    }
+    fCompressionSettings = ROOT::CompressionSettings(result->second, aLevel);
+}
+
+// The baskets of each branch are resized to hold about one cluster, from the average size of
+// the first entries. ROOT shares the memory among the branches by their compressed sizes.
+void AmoreRootNtuple::OptimizeBasketSizes() {
+    fBasketsOptimized = true;
+    Long64_t nEntries = fROOTOutputTree->GetEntries();
+    if (nEntries == 0) return;
+
+    fROOTOutputTree->FlushBaskets();
+    Long64_t entryBytes     = fROOTOutputTree->GetTotBytes() / nEntries + 1;
+    Long64_t clusterEntries = nEntries;
+    if (fAutoFlush > 0)
+        clusterEntries = fAutoFlush;
+    else if (fAutoFlush < 0)
+        clusterEntries = -fAutoFlush / entryBytes + 1;
+    else if (fEvtMod > 0)
+        clusterEntries = fEvtMod;
+    Long64_t basketMemory =
+        std::clamp(entryBytes * clusterEntries, kMinAutoBasketMemory, kMaxAutoBasketMemory);
+    fROOTOutputTree->OptimizeBaskets(basketMemory, 1.1, "");
+    AMORE_LOG(kNtuple, kInfo) << "Baskets of the output tree are resized for " << clusterEntries
+                              << " entries of " << entryBytes << " bytes.";
+}
+
+// The parts of a merged file have each written the same tables
+void AmoreRootNtuple::DeduplicateMetadata(const G4String &aFileName, G4bool aCompactStep) {
+    AmoreVolumeTable::Deduplicate(aFileName);
+    if (aCompactStep) AmoreStepDictionary::Deduplicate(aFileName);
+}
+
 void AmoreRootNtuple::ClearEvent() {
     CupRootNtuple::ClearEvent();
+    fCompactSteps.Clear();
+    fQuenchingBuffer.Clear();
     fTIDListForPrimAtCB.clear();
     fEvtInfo_EdepOV[0]       = 0;
     fEvtInfo_EdepOV[1]       = 0;
@@ -175,88 +435,79 @@ void AmoreRootNtuple::ClearEvent() {
 		fEvtInfo_InciAtOVC    = 0;
 }
 
-int AmoreRootNtuple::CountHittedCMOs() {
-    eDetGeometry DetectorType;
-    DetectorType = AmoreDetectorConstruction::GetDetGeometryType();
+// One pass over the crystal and veto hits, so that the cut is decided before the records of the
+// event are built. The last two TGSD cells of AMoRE200 are the outer vetoes, and the cells of
+// the pilot runs after the six crystals are gold films.
+void AmoreRootNtuple::SummarizeEvent(const G4Event *aEvent) {
+    fEventSummary.Clear();
+    eDetGeometry DetectorType = AmoreDetectorConstruction::GetDetGeometryType();
+    if (DetectorType == eDetGeometry::kDetector_AMoRE_I) {
+        auto *mdsdHC = static_cast<AmoreModuleHitsCollection *>(
+            FindHitsCollection(aEvent, "MDSD/AmoreModuleSDColl"));
+        if (mdsdHC == nullptr) return;
+        for (size_t i = 0; i < mdsdHC->GetSize(); i++) {
+            const AmoreModuleHit *nowHit = (*mdsdHC)[i];
+            fEventSummary.AddCrystal(nowHit->GetCrystalEdep(), nowHit->GetCrystalQEdep());
+        }
+        fEventSummary.fValid = true;
+        return;
+    }
+
+    auto *tgsdHC =
+        static_cast<CupScintHitsCollection *>(FindHitsCollection(aEvent, "TGSD/TGSDColl"));
+    if (tgsdHC == nullptr) return;
+    size_t nCells = tgsdHC->entries(), nCrystals = nCells;
     switch (DetectorType) {
-        case eDetGeometry::kDetector_AMoRE200: {
-            G4int NumberOfCMOs   = Ctgsd->GetNTotCell();
-						cout << " DEBUG: The number of Total Cell = " << NumberOfCMOs << endl;
-            G4int hittedCMOs     = 0;
-            for (int i = 0; i < NumberOfCMOs; i++) {
-                TCell *WaterCell = static_cast<TCell *>(Ctgsd->GetCell()->At(i));
-                if (WaterCell->GetEdep() != 0) hittedCMOs++;
-            }
-						cout << "Hitted CMOs - " << hittedCMOs << endl;
-            return hittedCMOs;
-        } break;
-        case eDetGeometry::kDetector_AMoREPilot: {
-            TCell *nowCell;
-            G4int hittedCMOs = 0;
-            for (G4int i = 0; i < 6; i++) {
-                nowCell = static_cast<TCell *>(Ctgsd->GetCell()->At(i));
-                if (nowCell->GetEdep() > 0) hittedCMOs++;
-            }
-            return hittedCMOs;
-        } break;
-        case eDetGeometry::kDetector_AMoREPilotRUN5: {
-            TCell *nowCell;
-            G4int hittedCMOs = 0;
-            for (G4int i = 0; i < 6; i++) {
-                nowCell = static_cast<TCell *>(Ctgsd->GetCell()->At(i));
-                if (nowCell->GetEdep() > 0) hittedCMOs++;
-            }
-            return hittedCMOs;
-        } break;
-        case eDetGeometry::kDetector_AMoRE_I: {
-            G4int hittedCMOs = 0;
-            if (fModuleArray == nullptr) return -1;
-            for (G4int i = 0; i < fModuleArray->GetTotalNumOfDetectorModules(); i++) {
-                DetectorModule_Amore &nowModule =
-                    static_cast<DetectorModule_Amore &>((*fModuleArray)[i]);
-                if (nowModule.GetCrystalEdep() > 0) hittedCMOs++;
-            }
-						cout << "Hitted CMOs - " << hittedCMOs << endl;
-            return hittedCMOs;
-        } break;
+        case eDetGeometry::kDetector_AMoRE200:
+            nCrystals = nCells >= 2 ? nCells - 2 : 0;
+            break;
+        case eDetGeometry::kDetector_AMoREPilot:
+        case eDetGeometry::kDetector_AMoREPilotRUN5:
+            nCrystals = std::min<size_t>(nCells, 6);
+            nCells    = nCrystals;
+            break;
         default:
-            return -1;
             break;
     }
+    for (size_t i = 0; i < nCells; i++) {
+        const CupScintHit *nowHit = (*tgsdHC)[i];
+        if (i < nCrystals)
+            fEventSummary.AddCrystal(nowHit->GetEdep(), nowHit->GetEdepQuenched());
+        else
+            fEventSummary.AddVeto(nowHit->GetEdep());
+    }
+    fEventSummary.fValid = true;
 }
 
-bool AmoreRootNtuple::RecordCut() {
-    using namespace std;
-    eDetGeometry DetectorType;
-    DetectorType = AmoreDetectorConstruction::GetDetGeometryType();
-    switch (DetectorType) {
-        case eDetGeometry::kDetector_AMoRE200: {
-            G4int hittedCMOs = CountHittedCMOs();
+// The outer vetoes of AMoRE200 are counted as well, as they always have been
+int AmoreRootNtuple::CountHittedCMOs() const {
+    if (!fEventSummary.fValid) return -1;
+    if (AmoreDetectorConstruction::GetDetGeometryType() == eDetGeometry::kDetector_AMoRE200)
+        return fEventSummary.fNCrystalHit + fEventSummary.fNVetoHit;
+    return fEventSummary.fNCrystalHit;
+}
 
-            if (hittedCMOs >= 1)
-                return true;
-            else
-                return false;
-						/*
-            if (hittedCMOs != 1)
-                return false;
-            else
-                return true;
-								*/
-        } break;
-        case eDetGeometry::kDetector_AMoREPilot:
-        case eDetGeometry::kDetector_AMoREPilotRUN5:
-        case eDetGeometry::kDetector_AMoRE_I: {
-            G4int hittedCMOs = CountHittedCMOs();
-            if (hittedCMOs >= 1)
+void AmoreRootNtuple::SetEventFilter(const G4String &aExpression) {
+    if (fEventFilter.Compile(aExpression)) fRecordWithCut = true;
+}
+
+// Without /ntuple/eventFilter, the cut keeps the events with a hit in any crystal
+bool AmoreRootNtuple::RecordCut() {
+    if (!fEventFilter.IsCompiled()) {
+        switch (AmoreDetectorConstruction::GetDetGeometryType()) {
+            case eDetGeometry::kDetector_AMoRE200:
+                fEventFilter.Compile("nCrystalHit + nVetoHit >= 1");
+                break;
+            case eDetGeometry::kDetector_AMoREPilot:
+            case eDetGeometry::kDetector_AMoREPilotRUN5:
+            case eDetGeometry::kDetector_AMoRE_I:
+                fEventFilter.Compile("nCrystalHit >= 1");
+                break;
+            default:
                 return true;
-            else
-                return false;
-        } break;
-        default:
-            return true;
-            break;
+        }
     }
+    return fEventSummary.fValid && fEventFilter.Accept(fEventSummary);
 }
 
 void AmoreRootNtuple::SetMDSD(const G4Event *aEvent) {
@@ -271,15 +522,30 @@ void AmoreRootNtuple::SetMDSD(const G4Event *aEvent) {
         G4Exception(__PRETTY_FUNCTION__, "MDSD_NOTEXIST", G4ExceptionSeverity::FatalException,
                     "Module SD is not found.");
 
-    size_t i;
+    // The SD keeps the list of the modules touched in this event, so the untouched ones are skipped
+    // without visiting every hit of the collection
+    AmoreModuleSD *nowModuleSD =
+        static_cast<AmoreModuleSD *>(sdMan->FindSensitiveDetector("/CupDet/MDSD"));
+
     eDetGeometry DetectorType;
     DetectorType = AmoreDetectorConstruction::GetDetGeometryType();
     switch (DetectorType) {
         case eDetGeometry::kDetector_AMoRE_I: {
-            for (i = 0; i < nowHColl->GetSize(); i++) {
-                AmoreModuleHit *nowHit = (*nowHColl)[i];
+            // Only the modules with a deposit are copied, after clearing the ones of the last event
+            for (auto nowID : fWrittenModuleIDs) {
+                DetectorModule_Amore &nowModule = (*fModuleArray)[nowID];
+                nowModule.SetCrystalEdep(0.);
+                nowModule.SetGeWaferEdep(0.);
+                nowModule.SetQuenchedCrystalEdep(0.);
+                nowModule.SetQuenchedGeWaferEdep(0.);
+                for (G4int j = 0; j < 4; j++)
+                    nowModule.SetGoldFilmEdep(j, 0.);
+            }
+            fWrittenModuleIDs.clear();
 
+            for (auto nowHit : nowModuleSD->GetTouchedHits()) {
                 DetectorModule_Amore &nowModule = (*fModuleArray)[nowHit->GetModuleID()];
+                fWrittenModuleIDs.push_back(nowHit->GetModuleID());
 
                 nowModule.SetCrystalEdep(nowHit->GetCrystalEdep());
                 nowModule.SetGeWaferEdep(nowHit->GetGeWaferEdep());
@@ -331,7 +597,7 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
 
     eDetGeometry DetectorType;
     DetectorType = AmoreDetectorConstruction::GetDetGeometryType();
-    G4cout << "Ntuple DetectorType= " << DetectorType << G4endl;
+    AMORE_LOG(kNtuple, kDebug) << "Ntuple DetectorType= " << DetectorType;
     switch (DetectorType) {
         case eDetGeometry::kDetector_AMoRE200: //// for AMoRE200
             for (int i1 = 0; i1 < nTotCell; i1++) {
@@ -347,9 +613,10 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
                     totalE += eDep;
                     totalEquenched += eDepQuenched;
 
-                    G4cout << "i1= " << i1 << ", volumeName= " << aHit->GetLogV()->GetName()
-                           << ", tgcellEdep[idxDetID]= " << eDep
-                           << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched << G4endl;
+                    AMORE_LOG(kNtuple, kDebug)
+                        << "i1= " << i1 << ", volumeName= " << aHit->GetLogV()->GetName()
+                        << ", tgcellEdep[idxDetID]= " << eDep
+                        << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched;
                 }
                 tgTotEdep         = totalE;
                 tgTotEdepQuenched = totalEquenched;
@@ -373,8 +640,9 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
                     totalE += eDep;
                     totalEquenched += eDepQuenched;
 
-                    G4cout << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
-                           << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched << G4endl;
+                    AMORE_LOG(kNtuple, kDebug)
+                        << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
+                        << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched;
                 }
                 tgTotEdep         = totalE;
                 tgTotEdepQuenched = totalEquenched;
@@ -398,8 +666,9 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
                     totalE += eDep;
                     totalEquenched += eDepQuenched;
 
-                    G4cout << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
-                           << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched << G4endl;
+                    AMORE_LOG(kNtuple, kDebug)
+                        << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
+                        << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched;
                 }
                 tgTotEdep         = totalE;
                 tgTotEdepQuenched = totalEquenched;
@@ -423,8 +692,9 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
                     totalE += eDep;
                     totalEquenched += eDepQuenched;
 
-                    G4cout << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
-                           << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched << G4endl;
+                    AMORE_LOG(kNtuple, kDebug)
+                        << "i1= " << i1 << ", tgcellEdep[idxDetID]= " << eDep
+                        << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched;
                 }
                 tgTotEdep         = totalE;
                 tgTotEdepQuenched = totalEquenched;
@@ -448,9 +718,10 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
                     totalE += eDep;
                     totalEquenched += eDepQuenched;
 
-                    G4cout << "i1= " << i1 << ", volumeName= " << aHit->GetLogV()->GetName()
-                           << ", tgcellEdep[idxDetID]= " << eDep
-                           << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched << G4endl;
+                    AMORE_LOG(kNtuple, kDebug)
+                        << "i1= " << i1 << ", volumeName= " << aHit->GetLogV()->GetName()
+                        << ", tgcellEdep[idxDetID]= " << eDep
+                        << ", tgcellEdepQuenched[idxDetID]= " << eDepQuenched;
                 }
                 tgTotEdep         = totalE;
                 tgTotEdepQuenched = totalEquenched;
@@ -461,7 +732,8 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
             }
             break;
         default:
-            G4cout << "### Detector type is not valid!!! Signal is not filled to Cell!!!\n";
+            AMORE_LOG(kNtuple, kWarning)
+                << "### Detector type is not valid!!! Signal is not filled to Cell!!!";
             break;
     }
     (void)tgTotEdep;
@@ -469,65 +741,69 @@ void AmoreRootNtuple::SetTGSD(const G4Event *a_event) {
     Ctgsd->SetTotEdep(totalE);
     Ctgsd->SetTotEdepQuenched(totalEquenched);
     Ctgsd->SetNTotCell(nTotCell);
-		G4cout << " nHit: " << iHit  << ", TotEdep: " << totalE << endl;
+    AMORE_LOG(kNtuple, kInfo) << " nHit: " << iHit << ", TotEdep: " << totalE;
 }
 
-void AmoreRootNtuple::RecordET(const G4Track *a_track) {
-    Int_t trid          = a_track->GetTrackID();
-    Int_t prntid        = a_track->GetParentID();
-    G4String volume     = a_track->GetVolume()->GetName();
-    G4String pname      = a_track->GetDefinition()->GetParticleName();
-    G4int atomicmass    = a_track->GetDefinition()->GetAtomicMass();
-    G4int atomicnumber  = a_track->GetDefinition()->GetAtomicNumber();
-    Double_t ke         = a_track->GetStep()->GetPreStepPoint()->GetKineticEnergy();
-    Double_t globaltime = a_track->GetGlobalTime();
-    Double_t localtime  = a_track->GetLocalTime();
+// The records of the event go back to the pool, which keeps at most fgcMaxPooledEndTracks
+void AmoreRootNtuple::ClearET() {
+    if (fEndTrackPool.empty()) {
+        fEndTrackPool.swap(*EndTrackList);
+    } else {
+        fEndTrackPool.insert(fEndTrackPool.end(), EndTrackList->begin(), EndTrackList->end());
+        EndTrackList->clear();
+    }
+    if (fEndTrackPool.size() > fgcMaxPooledEndTracks) {
+        for (size_t i = fgcMaxPooledEndTracks; i < fEndTrackPool.size(); i++)
+            delete fEndTrackPool[i];
+        fEndTrackPool.resize(fgcMaxPooledEndTracks);
+        fEndTrackPool.shrink_to_fit();
+    }
+    if (EndTrackList->capacity() > fgcMaxPooledEndTracks) {
+        std::vector<TTrack *>().swap(*EndTrackList);
+    }
+}
 
-    G4ThreeVector pos = a_track->GetPosition();
-    Float_t xx        = (float)pos.x();
-    Float_t yy        = (float)pos.y();
-    Float_t zz        = (float)pos.z();
+// The record is taken from the pool and filled in place, without building temporary copies
+void AmoreRootNtuple::RecordET(const G4Track *a_track) {
+    if (!StatusTrack) return;
 
-    G4String procname;
-    const G4VProcess *EndProcess = a_track->GetStep()->GetPostStepPoint()->GetProcessDefinedStep();
-    if (EndProcess) procname = EndProcess->GetProcessName();
+    TTrack *ttr;
+    if (fEndTrackPool.empty()) {
+        ttr = new TTrack;
+    } else {
+        ttr = fEndTrackPool.back();
+        fEndTrackPool.pop_back();
+    }
 
-    TTrack ttr;
+    const G4ParticleDefinition *pdef = a_track->GetDefinition();
+    G4int atomicmass                 = pdef->GetAtomicMass();
+    G4int atomicnumber               = pdef->GetAtomicNumber();
     Int_t cuppdgcode;
-
-    char partname[100];
-    char volname[100];
-    char prcsname[100];
-
-    sprintf(partname, "%s", (char *)pname.data());
-    sprintf(volname, "%s", (char *)volume.data());
-    sprintf(prcsname, "%s", (char *)procname.data());
-
-    G4ParticleDefinition *pdef = a_track->GetDefinition();
     if (G4IonTable::IsIon(pdef)) {
         cuppdgcode = (1000 * atomicnumber + atomicmass) * 10;
     } else {
         cuppdgcode = pdef->GetPDGEncoding();
     }
 
-    if (StatusTrack) {
-        ttr.SetParticleName(partname);
-        ttr.SetAtomicNumber(atomicnumber);
-        ttr.SetAtomicMass(atomicmass);
-        ttr.SetPDGcode(cuppdgcode);
-        ttr.SetTrackID(trid);
-        ttr.SetParentID(prntid);
-        ttr.SetKineticEnergy(ke);
-        ttr.SetX(xx);
-        ttr.SetY(yy);
-        ttr.SetZ(zz);
-        ttr.SetGlobalTime(globaltime);
-        ttr.SetLocalTime(localtime);
-        ttr.SetProcessName(prcsname);
-        ttr.SetVolumeName(volname);
+    const G4ThreeVector &pos = a_track->GetPosition();
+    const G4VProcess *EndProcess = a_track->GetStep()->GetPostStepPoint()->GetProcessDefinedStep();
 
-        EndTrackList->push_back(new TTrack(ttr));
-    }
+    ttr->SetParticleName(pdef->GetParticleName().data());
+    ttr->SetAtomicNumber(atomicnumber);
+    ttr->SetAtomicMass(atomicmass);
+    ttr->SetPDGcode(cuppdgcode);
+    ttr->SetTrackID(a_track->GetTrackID());
+    ttr->SetParentID(a_track->GetParentID());
+    ttr->SetKineticEnergy(a_track->GetStep()->GetPreStepPoint()->GetKineticEnergy());
+    ttr->SetX((float)pos.x());
+    ttr->SetY((float)pos.y());
+    ttr->SetZ((float)pos.z());
+    ttr->SetGlobalTime(a_track->GetGlobalTime());
+    ttr->SetLocalTime(a_track->GetLocalTime());
+    ttr->SetProcessName(EndProcess ? EndProcess->GetProcessName().data() : "");
+    ttr->SetVolumeName(a_track->GetVolume()->GetName().data());
+
+    EndTrackList->push_back(ttr);
 }
 
 void AmoreRootNtuple::RecordTrack(const G4Track *a_track) {
@@ -605,9 +881,24 @@ void AmoreRootNtuple::RecordTrack(const G4Track *a_track) {
 }
 
 void AmoreRootNtuple::RecordStep(const G4Step *a_step) {
+    // Track IDs of sub-events are not the ones of the parent event yet
+    G4bool recordPrimary =
+        fRecordPrimary && AmoreSubEventManager::GetCurrentSubEvent() == nullptr;
+    // Rejected steps are dropped before anything is built for them
+    if (!StatusStep || (fStepFilter.IsActive() && !fStepFilter.Accept(a_step, fVolumeTable))) {
+        if (recordPrimary) RecordPrimaryAtBorder(a_step);
+        return;
+    }
+    if (fCompactStep) {
+        // The output may be opened before /run/initialize, so the IDs are given at the first step
+        if (!fStepDictionary.IsBuilt()) fStepDictionary.Build();
+        fStepDictionary.Fill(a_step, fCompactSteps);
+        if (recordPrimary) RecordPrimaryAtBorder(a_step);
+        return;
+    }
+
     Int_t trid         = a_step->GetTrack()->GetTrackID();
     Int_t prntid       = a_step->GetTrack()->GetParentID();
-    G4String volume    = a_step->GetTrack()->GetVolume()->GetName();
     G4int istep        = a_step->GetTrack()->GetCurrentStepNumber();
     G4String pname     = a_step->GetTrack()->GetDefinition()->GetParticleName();
     G4int atomicmass   = a_step->GetTrack()->GetDefinition()->GetAtomicMass();
@@ -626,63 +917,14 @@ void AmoreRootNtuple::RecordStep(const G4Step *a_step) {
     Float_t yy          = (float)pos.y();
     Float_t zz          = (float)pos.z();
 
-    G4TouchableHandle theTouchable = preStep->GetTouchableHandle();
-    G4int motherCopyNo             = -1;
+    // The copy number of the crystals is added to the name, see AmoreVolumeTable
+    G4String volname = fVolumeTable.GetStepVolumeName(a_step->GetTrack()->GetVolume(),
+                                                      preStep->GetTouchableHandle());
 
     //	TTrack ttr;
     TStep tst;
     Int_t cuppdgcode;
 
-    char volname[100];
-
-    bool isWorldRegion;
-
-    isWorldRegion =
-        theTouchable->GetVolume(theTouchable->GetHistoryDepth())->GetLogicalVolume() ==
-        theTouchable->GetVolume()->GetLogicalVolume()->GetRegion()->GetRootLogicalVolumeIterator().
-        operator*();
-
-    sprintf(volname, "%s", (char *)volume.data());
-    if (!isWorldRegion) {
-        switch (AmoreDetectorConstruction::GetDetGeometryType()) {
-            case eDetGeometry::kDetector_AMoRE200:
-                if (!strcmp(volname, "physCMOCell")) {
-                    motherCopyNo = theTouchable->GetCopyNumber(1);
-                    sprintf(volname, "%s%d", "physCMOCell", motherCopyNo);
-                }
-                break;
-            case eDetGeometry::kDetector_AMoRE_I: {
-                constexpr const char *pvCheckerString = "_Crystal_PV";
-                //size_t checkerIndex                 = volume.index(pvCheckerString);
-                size_t checkerIndex                 = volume.find(pvCheckerString);
-                if (checkerIndex != G4String::npos) {
-                    G4VPhysicalVolume *theMother;
-                    size_t envelopeCopyNo = 1;
-										size_t nowMotherLevel = 1;
-                    theMother = theTouchable->GetVolume(nowMotherLevel++);
-                    while (theMother != nullptr) {
-                        if (theMother->GetLogicalVolume()->IsRootRegion()) {
-                            if (theMother->GetMotherLogical() ==
-                                nullptr) { // Reached the end of the world
-                                G4Exception(__PRETTY_FUNCTION__, "MDSD_REGION_FAIL", FatalException,
-                                            "Finding a root region for SD has been failed.");
-                            }
-                            envelopeCopyNo = theMother->GetCopyNo();
-                            break;
-                        }
-                        theMother = theTouchable->GetVolume(nowMotherLevel++);
-                    }
-
-                    volume.insert(checkerIndex, "_");
-                    volume.insert(checkerIndex + 1, std::to_string(envelopeCopyNo));
-                    sprintf(volname, "%s", (char *)volume.data());
-                }
-            } break;
-            default:
-                break;
-        }
-    }
-
     G4ParticleDefinition *pdef = a_step->GetTrack()->GetDefinition();
     if (G4IonTable::IsIon(pdef)) {
         cuppdgcode = (1000 * atomicnumber + atomicmass) * 10;
@@ -702,35 +944,56 @@ void AmoreRootNtuple::RecordStep(const G4Step *a_step) {
     tst.SetGlobalTime(globaltime);
     tst.SetLocalTime(localtime);
     tst.SetProcessName(procname.data());
-    tst.SetVolumeName(volname);
+    tst.SetVolumeName(volname.data());
     tst.SetStepNo(istep);
 
-    if (StatusStep) {
-        new ((*tclst)[nStep]) TStep(tst);
-        nStep++;
-    }
+    new ((*tclst)[nStep]) TStep(tst);
+    nStep++;
 
-    if (fRecordPrimary) RecordPrimaryAtBorder(a_step);
+    if (recordPrimary) RecordPrimaryAtBorder(a_step);
 }
 
+// Only a step ending on a geometry boundary can enter the cavern or the OVC. The border is
+// judged with the flags of the volume table, and the record is built only for the steps entering.
 void AmoreRootNtuple::RecordPrimaryAtBorder(const G4Step *aStep) {
-    G4StepPoint *postStep                   = aStep->GetPostStepPoint();
-
-    const AmoreDetectorConstruction *tDetCons = static_cast<const AmoreDetectorConstruction *>(
-        G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    G4StepPoint *postStep = aStep->GetPostStepPoint();
+    if (postStep->GetStepStatus() != fGeomBoundary) return;
 
     eCavernType tNowCT    = AmoreDetectorConstruction::GetCavernType();
     //eVetoGeometry tNowVGT = AmoreDetectorConstruction::GetVetoGeometryType();
 
-    G4bool fileFlushed = false;
-    auto flushTuple    = [&](TNtupleD *aTuple, G4int &aFillCnt) {
-        if (aTuple != nullptr && kEvtModForPrim != 0 && aFillCnt > kEvtModForPrim) {
-            aTuple->FlushBaskets();
-            aFillCnt = 0;
-            if (!fileFlushed) {
-                aTuple->GetCurrentFile()->Flush();
-                fileFlushed = true;
+    G4bool atCB = false, atOVC = false;
+    switch (AmoreDetectorConstruction::GetDetGeometryType()) {
+        case eDetGeometry::kDetector_AMoRE_I: {
+            atCB = fVolumeTable.EntersCavern(aStep);
+        } break;
+        case eDetGeometry::kDetector_AMoRE200: {
+            switch (tNowCT) {
+                case eCavernType::kCavern_Toy_HemiSphere:
+                case eCavernType::kCavern_RealModel:
+                    atCB = fVolumeTable.EntersCavern(aStep);
+                    break;
+                case eCavernType::kCavern_Toy_Cylinder:
+                    G4Exception(__PRETTY_FUNCTION__, "CAVERN", G4ExceptionSeverity::JustWarning,
+                                "Cavern type of cylinder toy model hasn't been implemented in "
+                                "AMoRE-II.");
+                    return;
+                default:
+                    G4Exception(__PRETTY_FUNCTION__, "CAVERN", G4ExceptionSeverity::JustWarning,
+                                "Cavern type is wrong.");
+                    return;
             }
+            atOVC = fVolumeTable.EntersOVC(aStep);
+        } break;
+        default:
+            break;
+    }
+    if (!atCB && !atOVC) return;
+
+    auto flushTuple = [&](TNtupleD *aTuple, G4int &aFillCnt) {
+        if (aTuple != nullptr && fEvtModForPrim != 0 && aFillCnt > fEvtModForPrim) {
+            AmoreOutputFlusher::GetInstance()->Flush(aTuple, fOutputMutex);
+            aFillCnt = 0;
         }
     };
 
@@ -758,74 +1021,37 @@ void AmoreRootNtuple::RecordPrimaryAtBorder(const G4Step *aStep) {
         AmoreTrackInformation *aATI =
             static_cast<AmoreTrackInformation *>(aStep->GetTrack()->GetUserInformation());
         fValuesForPrim[10] = aATI->GetParentDefinition()->GetPDGEncoding();
-        auto res_iter      = fEvtInfo_VolumeTbl->find(aATI->GetBirthPV()->GetName());
-        if (res_iter == fEvtInfo_VolumeTbl->end()) {
+        const AmoreVolumeTable::Entry *birthEntry = fVolumeTable.Find(aATI->GetBirthPV());
+        if (birthEntry == nullptr) {
             fValuesForPrim[11] = -100;
             G4Exception(__PRETTY_FUNCTION__, "PRIM_VOLTBL_NOEXIST",
                         G4ExceptionSeverity::JustWarning, "We couldn't find a PV in the PV table.");
         } else
-            fValuesForPrim[11] = (*res_iter).second;
+            fValuesForPrim[11] = birthEntry->fNameID;
     } else {
         fValuesForPrim[10] = 0;
         fValuesForPrim[11] = -1;
     }
 
-    switch (AmoreDetectorConstruction::GetDetGeometryType()) {
-        case eDetGeometry::kDetector_AMoRE_I: {
-            if (tDetCons->Judge_CavernBorder(aStep)) {
-                judgeTID(fTIDListForPrimAtCB, aStep->GetTrack()->GetTrackID());
-                fPrimAtCB->Fill(fValuesForPrim);
-                fPrimFillCntAtCB++;
-                fEvtInfo_InciAtCB++;
-            }
-            flushTuple(fPrimAtCB, fPrimFillCntAtCB);
-        } break;
-        case eDetGeometry::kDetector_AMoRE200: {
-            switch (tNowCT) {
-                case eCavernType::kCavern_Toy_HemiSphere:
-                    if (tDetCons->Judge_CavernBorder(aStep)) {
-                        judgeTID(fTIDListForPrimAtCB, aStep->GetTrack()->GetTrackID());
-                        fPrimAtCB->Fill(fValuesForPrim);
-                        fPrimFillCntAtCB++;
-                        fEvtInfo_InciAtCB++;
-                    } 
-                    break;
-                case eCavernType::kCavern_Toy_Cylinder:
-                    if (AmoreDetectorConstruction::GetDetGeometryType() ==
-                        eDetGeometry::kDetector_AMoRE200)
-                        G4Exception(__PRETTY_FUNCTION__, "CAVERN", G4ExceptionSeverity::JustWarning,
-                                    "Cavern type of cylinder toy model hasn't been implemented in "
-                                    "AMoRE-II.");
-                    return;
-                    break;
-                case eCavernType::kCavern_RealModel:
-                    if (tDetCons->Judge_CavernBorder(aStep)) {
-                        judgeTID(fTIDListForPrimAtCB, aStep->GetTrack()->GetTrackID());
-                        fPrimAtCB->Fill(fValuesForPrim);
-                        fPrimFillCntAtCB++;
-                        fEvtInfo_InciAtCB++;
-                    }
-                    break;
-                default:
-                    G4Exception(__PRETTY_FUNCTION__, "CAVERN", G4ExceptionSeverity::JustWarning,
-                                "Cavern type is wrong.");
-                    return;
-            }
-
-						if(tDetCons->Judge_200_OVCBorder(aStep))
-						{
-                judgeTID(fTIDListForPrimAtOVC, aStep->GetTrack()->GetTrackID());
-                fPrimAtOVC->Fill(fValuesForPrim);
-                fPrimFillCntAtOVC++;
-                fEvtInfo_InciAtOVC++;
-						}
-
-            flushTuple(fPrimAtCB, fPrimFillCntAtCB);
-            flushTuple(fPrimAtOVC, fPrimFillCntAtOVC);
-						
-        } break;
-        default:
-            break;
+    if (atCB) {
+        judgeTID(fTIDListForPrimAtCB, aStep->GetTrack()->GetTrackID());
+        {
+            std::lock_guard<std::mutex> lock(fOutputMutex);
+            fPrimAtCB->Fill(fValuesForPrim);
+        }
+        fPrimFillCntAtCB++;
+        fEvtInfo_InciAtCB++;
+        flushTuple(fPrimAtCB, fPrimFillCntAtCB);
+    }
+    if (atOVC) {
+        judgeTID(fTIDListForPrimAtOVC, aStep->GetTrack()->GetTrackID());
+        {
+            std::lock_guard<std::mutex> lock(fOutputMutex);
+            fPrimAtOVC->Fill(fValuesForPrim);
+        }
+        fPrimFillCntAtOVC++;
+        fEvtInfo_InciAtOVC++;
+        flushTuple(fPrimAtOVC, fPrimFillCntAtOVC);
     }
 }
 
@@ -833,36 +1059,33 @@ void AmoreRootNtuple::RecordBeginOfEvent(const G4Event *a_event) {
     CupRootNtuple::RecordBeginOfEvent(a_event);
     fEvtInfo_EvtID = a_event->GetEventID();
 
-    // Genarate Volume Table
-    if (fEvtInfo_VolumeTbl->size() == 0) {
-        G4PhysicalVolumeStore *aPVStore = G4PhysicalVolumeStore::GetInstance();
-
-        int idx = 0;
-        for (auto &nowPV : *aPVStore) {
-            auto &nowName = nowPV->GetName();
-            if (fEvtInfo_VolumeTbl->find(nowName.c_str()) == fEvtInfo_VolumeTbl->end()) {
-                (*fEvtInfo_VolumeTbl)[nowName.c_str()] = idx++;
-            }
-        }
+    // Genarate Volume Table once the geometry and its regions are ready
+    if (!fVolumeTable.IsBuilt()) {
+        fVolumeTable.Build(static_cast<const AmoreDetectorConstruction *>(
+            G4RunManager::GetRunManager()->GetUserDetectorConstruction()));
+        *fEvtInfo_VolumeTbl = fVolumeTable.GetNameIDs();
     }
 }
 
-void AmoreRootNtuple::RecordPrimaryEvtInfos(const G4Event *) {
+// Taken from the hit collections, since the records of an event rejected by the cut are not built
+void AmoreRootNtuple::RecordPrimaryEvtInfos(const G4Event *aEvent) {
+    std::lock_guard<std::mutex> lock(fOutputMutex);
     switch (AmoreDetectorConstruction::GetDetGeometryType()) {
         case eDetGeometry::kDetector_AMoRE_I: {
             fEvtInfo_HittedCMONum = CountHittedCMOs();
             fEvtInfos->Fill();
         } break;
         case eDetGeometry::kDetector_AMoRE200: {
-            Double_t edepOV[2]       = {-1,-1};
-            const Int_t vetoIdx1   = Ctgsd->GetCell()->GetEntries() - 2;
-            const TCell *vetoCell1 = static_cast<TCell *>((Ctgsd->GetCell())->At(vetoIdx1));
-            const Int_t vetoIdx2   = Ctgsd->GetCell()->GetEntries() - 1;
-            const TCell *vetoCell2 = static_cast<TCell *>((Ctgsd->GetCell())->At(vetoIdx2));
-            edepOV[0]                = vetoCell1->GetEdep();
-            edepOV[1]                = vetoCell2->GetEdep();
-            fEvtInfo_EdepOV[0]       = edepOV[0];
-            fEvtInfo_EdepOV[1]       = edepOV[1];
+            // The last two cells of TGSD are the outer vetoes
+            Double_t edepOV[2] = {-1, -1};
+            auto *tgsdHC =
+                static_cast<CupScintHitsCollection *>(FindHitsCollection(aEvent, "TGSD/TGSDColl"));
+            if (tgsdHC != nullptr && tgsdHC->entries() >= 2) {
+                edepOV[0] = (*tgsdHC)[tgsdHC->entries() - 2]->GetEdep();
+                edepOV[1] = (*tgsdHC)[tgsdHC->entries() - 1]->GetEdep();
+            }
+            fEvtInfo_EdepOV[0]    = edepOV[0];
+            fEvtInfo_EdepOV[1]    = edepOV[1];
             fEvtInfo_HittedCMONum = CountHittedCMOs();
             fEvtInfos->Fill();
         } break;
@@ -872,6 +1095,19 @@ void AmoreRootNtuple::RecordPrimaryEvtInfos(const G4Event *) {
 }
 
 void AmoreRootNtuple::RecordEndOfEvent(const G4Event *a_event) {
+    SummarizeEvent(a_event);
+    if (fRecordPrimary) {
+        RecordPrimaryEvtInfos(a_event);
+    }
+
+    // The cut only needs the hit collections, so nothing is built for a rejected event
+    if (fRecordWithCut && !RecordCut()) {
+        ClearEvent();
+        AMORE_LOG(kEvent, kInfo) << "///////////////////////////////// End of Event "
+                                    "/////////////////////////////////////////";
+        return;
+    }
+
     SetEventInfo(a_event);
     if (StatusPrimary) {
         SetPrimary(a_event);
@@ -900,30 +1136,23 @@ void AmoreRootNtuple::RecordEndOfEvent(const G4Event *a_event) {
         SetMuonSD(a_event);
     }
 
-    if (fRecordPrimary) {
-        RecordPrimaryEvtInfos(a_event);
-    }
-
     // put to tree
-    if (fRecordWithCut) {
-        if (RecordCut()) {
-            fROOTOutputTree->Fill();
-            fRecordedEvt++;
-        }
-    } else {
+    {
+        std::lock_guard<std::mutex> lock(fOutputMutex);
         fROOTOutputTree->Fill();
-        fRecordedEvt++;
+        if (fAutoBasketEvents > 0 && !fBasketsOptimized &&
+            fROOTOutputTree->GetEntries() >= fAutoBasketEvents)
+            OptimizeBasketSizes();
     }
+    fRecordedEvt++;
 
-    if (kEvtMod != 0 && fRecordedEvt > kEvtMod) {
-        fROOTOutputTree->FlushBaskets();
-        fROOTOutputTree->GetCurrentFile()->Flush();
+    if (fEvtMod != 0 && fRecordedEvt > fEvtMod) {
+        AmoreOutputFlusher::GetInstance()->Flush(fROOTOutputTree, fOutputMutex);
         fRecordedEvt = 0;
     }
 
     ClearEvent();
 
-    G4cout << "///////////////////////////////// End of Event "
-              "/////////////////////////////////////////"
-           << G4endl;
+    AMORE_LOG(kEvent, kInfo) << "///////////////////////////////// End of Event "
+                                "/////////////////////////////////////////";
 }
@@ -7,6 +7,7 @@
 
 #include "G4UIcmdWith3VectorAndUnit.hh"
 #include "G4UIcmdWithAString.hh"
+#include "G4SystemOfUnits.hh"
 #include "G4UIdirectory.hh"
 #include "G4ios.hh"
 #include "globals.hh"
@@ -26,15 +27,160 @@ AmoreRootNtupleMessenger::AmoreRootNtupleMessenger(AmoreRootNtuple *myntuple)
     CUTCmd->AvailableForStates(G4State_PreInit);
     CUTCmd->SetParameter(new G4UIparameter("recordWithCut", 'b', true));
 
+    EventFilterCmd = new G4UIcommand("/ntuple/eventFilter", this);
+    EventFilterCmd->SetGuidance("Record only the events passing an expression (turns the cut on).");
+    EventFilterCmd->SetGuidance("  e.g. nCrystalHit>=1 && vetoEdep<1*MeV && Etot in [2.9,3.1]*MeV");
+    EventFilterCmd->SetGuidance("Variables: nCrystalHit, nVetoHit, Etot, EtotQ (quenched),");
+    EventFilterCmd->SetGuidance("vetoEdep and hit(i) for crystal i. Other names are Geant4 units.");
+    EventFilterCmd->SetGuidance("Operators: || && ! < <= > >= == != + - * / ( ) and x in [a,b].");
+    EventFilterCmd->SetGuidance("Without it, the cut keeps the events with a hit in any crystal.");
+    EventFilterCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    EventFilterCmd->SetParameter(new G4UIparameter("expression", 's', false));
+
     PrimCmd = new G4UIcommand("/ntuple/recordPrimaries", this);
     PrimCmd->SetGuidance("Select on/off of recording primaries for neutron flux.");
     PrimCmd->AvailableForStates(G4State_PreInit);
     PrimCmd->SetParameter(new G4UIparameter("recordPrimaries", 'b', true));
+
+    CompactStepCmd = new G4UIcommand("/ntuple/compactStep", this);
+    CompactStepCmd->SetGuidance("Select on/off of recording steps as columns of IDs.");
+    CompactStepCmd->SetGuidance("The names of the IDs are in the trees StepParticles,");
+    CompactStepCmd->SetGuidance("StepProcesses and StepVolumes of the same file.");
+    CompactStepCmd->AvailableForStates(G4State_PreInit);
+    CompactStepCmd->SetParameter(new G4UIparameter("compactStep", 'b', true));
+
+    CompressionCmd = new G4UIcommand("/ntuple/compression", this);
+    CompressionCmd->SetGuidance("Select the compression algorithm and level of the output files.");
+    CompressionCmd->SetGuidance("Higher levels give smaller files but slower writing; 0 turns");
+    CompressionCmd->SetGuidance("the compression off. zstd needs ROOT 6.20 or later.");
+    CompressionCmd->AvailableForStates(G4State_PreInit);
+    G4UIparameter *algorithmParam = new G4UIparameter("algorithm", 's', false);
+    algorithmParam->SetParameterCandidates("default zlib lzma lz4 zstd");
+    CompressionCmd->SetParameter(algorithmParam);
+    G4UIparameter *levelParam = new G4UIparameter("level", 'i', true);
+    levelParam->SetParameterRange("level >= 0 && level <= 9");
+    levelParam->SetDefaultValue("4");
+    CompressionCmd->SetParameter(levelParam);
+
+    BasketSizeCmd = new G4UIcommand("/ntuple/basketSize", this);
+    BasketSizeCmd->SetGuidance("Set the basket size in bytes of every branch of the output tree.");
+    BasketSizeCmd->SetGuidance("With auto, the baskets are sized from the entries written in the");
+    BasketSizeCmd->SetGuidance("first nEvents events so that each holds about one cluster.");
+    BasketSizeCmd->SetGuidance("0 keeps the sizes given to each branch.");
+    BasketSizeCmd->AvailableForStates(G4State_PreInit);
+    BasketSizeCmd->SetParameter(new G4UIparameter("size", 's', false));
+    G4UIparameter *autoEventsParam = new G4UIparameter("nEvents", 'i', true);
+    autoEventsParam->SetParameterRange("nEvents > 0");
+    autoEventsParam->SetDefaultValue("100");
+    BasketSizeCmd->SetParameter(autoEventsParam);
+
+    ClusterSizeCmd = new G4UIcommand("/ntuple/clusterSize", this);
+    ClusterSizeCmd->SetGuidance("Set the auto-flush cluster size of the output tree, in entries");
+    ClusterSizeCmd->SetGuidance("or in MB of uncompressed data. 0 keeps the default of ROOT.");
+    ClusterSizeCmd->SetGuidance("The periodic flushes of /ntuple/flushPeriod also end clusters.");
+    ClusterSizeCmd->AvailableForStates(G4State_PreInit);
+    G4UIparameter *clusterParam = new G4UIparameter("size", 'i', false);
+    clusterParam->SetParameterRange("size >= 0");
+    ClusterSizeCmd->SetParameter(clusterParam);
+    G4UIparameter *clusterUnitParam = new G4UIparameter("unit", 's', true);
+    clusterUnitParam->SetParameterCandidates("events MB");
+    clusterUnitParam->SetDefaultValue("events");
+    ClusterSizeCmd->SetParameter(clusterUnitParam);
+
+    FlushPeriodCmd = new G4UIcommand("/ntuple/flushPeriod", this);
+    FlushPeriodCmd->SetGuidance("Write the baskets of the output tree every nEvents recorded");
+    FlushPeriodCmd->SetGuidance("events. 0 leaves the writing to the auto-flush of the tree.");
+    FlushPeriodCmd->AvailableForStates(G4State_PreInit);
+    G4UIparameter *flushParam = new G4UIparameter("nEvents", 'i', false);
+    flushParam->SetParameterRange("nEvents >= 0");
+    FlushPeriodCmd->SetParameter(flushParam);
+
+    PrimFlushPeriodCmd = new G4UIcommand("/ntuple/primFlushPeriod", this);
+    PrimFlushPeriodCmd->SetGuidance("Write the baskets of the primary records every nEntries");
+    PrimFlushPeriodCmd->SetGuidance("entries. 0 leaves the writing to the auto-flush of ROOT.");
+    PrimFlushPeriodCmd->AvailableForStates(G4State_PreInit);
+    G4UIparameter *primFlushParam = new G4UIparameter("nEntries", 'i', false);
+    primFlushParam->SetParameterRange("nEntries >= 0");
+    PrimFlushPeriodCmd->SetParameter(primFlushParam);
+
+    QuenchingDir = new G4UIdirectory("/ntuple/quenching/");
+    QuenchingDir->SetGuidance("Control the Birks quenching of the crystal energy deposits.");
+
+    DeferredQuenchingCmd = new G4UIcommand("/ntuple/quenching/deferred", this);
+    DeferredQuenchingCmd->SetGuidance("Quench the crystal steps together at the end of each event");
+    DeferredQuenchingCmd->SetGuidance("instead of one by one while they are tracked.");
+    DeferredQuenchingCmd->AvailableForStates(G4State_PreInit);
+    DeferredQuenchingCmd->SetParameter(new G4UIparameter("deferred", 'b', true));
+
+    KeepQuenchingStepsCmd = new G4UIcommand("/ntuple/quenching/keepSteps", this);
+    KeepQuenchingStepsCmd->SetGuidance("Write the crystal steps as Quenching_* columns, from");
+    KeepQuenchingStepsCmd->SetGuidance("which the deposits can be quenched again with other");
+    KeepQuenchingStepsCmd->SetGuidance("Birks constants kB (see AmoreQuenchingBuffer.hh):");
+    KeepQuenchingStepsCmd->SetGuidance("  Eloss/(1+kB*Eloss/Length) + Niel/(1+kB*Niel/NielRange)");
+    KeepQuenchingStepsCmd->SetGuidance("Turns /ntuple/quenching/deferred on.");
+    KeepQuenchingStepsCmd->AvailableForStates(G4State_PreInit);
+    KeepQuenchingStepsCmd->SetParameter(new G4UIparameter("keepSteps", 'b', true));
+
+    StepFilterDir = new G4UIdirectory("/ntuple/stepFilter/");
+    StepFilterDir->SetGuidance("Select the steps recorded by /ntuple/step.");
+    StepFilterDir->SetGuidance("A step is recorded if it passes every given selection.");
+
+    StepFilterVolumeCmd = new G4UIcommand("/ntuple/stepFilter/volume", this);
+    StepFilterVolumeCmd->SetGuidance("Record the steps in a physical volume and its daughters.");
+    StepFilterVolumeCmd->SetGuidance("Volumes and regions given by several commands are combined.");
+    StepFilterVolumeCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    StepFilterVolumeCmd->SetParameter(new G4UIparameter("volume", 's', false));
+
+    StepFilterRegionCmd = new G4UIcommand("/ntuple/stepFilter/region", this);
+    StepFilterRegionCmd->SetGuidance("Record the steps in the volumes of a region.");
+    StepFilterRegionCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    StepFilterRegionCmd->SetParameter(new G4UIparameter("region", 's', false));
+
+    StepFilterParticleCmd = new G4UIcommand("/ntuple/stepFilter/particle", this);
+    StepFilterParticleCmd->SetGuidance("Record the steps of a particle type.");
+    StepFilterParticleCmd->SetGuidance("Particles given by several commands are combined.");
+    StepFilterParticleCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    StepFilterParticleCmd->SetParameter(new G4UIparameter("particle", 's', false));
+
+    StepFilterMinEdepCmd = new G4UIcommand("/ntuple/stepFilter/minEdep", this);
+    StepFilterMinEdepCmd->SetGuidance("Record the steps depositing at least this energy.");
+    StepFilterMinEdepCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    G4UIparameter *edepParam = new G4UIparameter("edep", 'd', false);
+    edepParam->SetParameterRange("edep >= 0");
+    StepFilterMinEdepCmd->SetParameter(edepParam);
+    G4UIparameter *unitParam = new G4UIparameter("unit", 's', true);
+    unitParam->SetDefaultValue("keV");
+    StepFilterMinEdepCmd->SetParameter(unitParam);
+
+    StepFilterClearCmd = new G4UIcommand("/ntuple/stepFilter/clear", this);
+    StepFilterClearCmd->SetGuidance("Remove every selection, so that all steps are recorded.");
+    StepFilterClearCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    StepFilterListCmd = new G4UIcommand("/ntuple/stepFilter/list", this);
+    StepFilterListCmd->SetGuidance("Print the selections of the recorded steps.");
+    StepFilterListCmd->SetToBeBroadcasted(false);
 }
 
 AmoreRootNtupleMessenger::~AmoreRootNtupleMessenger() {
     delete CUTCmd;
+    delete EventFilterCmd;
     delete PrimCmd;
+    delete CompactStepCmd;
+    delete CompressionCmd;
+    delete BasketSizeCmd;
+    delete ClusterSizeCmd;
+    delete FlushPeriodCmd;
+    delete PrimFlushPeriodCmd;
+    delete DeferredQuenchingCmd;
+    delete KeepQuenchingStepsCmd;
+    delete QuenchingDir;
+    delete StepFilterVolumeCmd;
+    delete StepFilterRegionCmd;
+    delete StepFilterParticleCmd;
+    delete StepFilterMinEdepCmd;
+    delete StepFilterClearCmd;
+    delete StepFilterListCmd;
+    delete StepFilterDir;
 
     delete AmoreRootNtupleDir;
 }
@@ -43,9 +189,61 @@ void AmoreRootNtupleMessenger::SetNewValue(G4UIcommand *command, G4String newVal
     if (command == CUTCmd) {
         G4bool input = StoB(newValues);
         myNtuple->SetRecordCut(input);
+    } else if (command == EventFilterCmd) {
+        G4String expression = newValues;
+        if (expression.size() >= 2 && expression.front() == '"' && expression.back() == '"')
+            expression = expression.substr(1, expression.size() - 2);
+        myNtuple->SetEventFilter(expression);
     } else if (command == PrimCmd) {
         G4bool input = StoB(newValues);
         myNtuple->SetRecordPrim(input);
+    } else if (command == CompactStepCmd) {
+        myNtuple->SetCompactStep(StoB(newValues));
+    } else if (command == CompressionCmd) {
+        std::istringstream input(newValues);
+        G4String algorithm;
+        G4int level;
+        input >> algorithm >> level;
+        myNtuple->SetCompression(algorithm, level);
+    } else if (command == BasketSizeCmd) {
+        std::istringstream input(newValues);
+        G4String size;
+        G4int autoEvents;
+        input >> size >> autoEvents;
+        if (size == "auto")
+            myNtuple->SetBasketSize(0, autoEvents);
+        else
+            myNtuple->SetBasketSize(StoI(size), 0);
+    } else if (command == ClusterSizeCmd) {
+        std::istringstream input(newValues);
+        Long64_t size;
+        G4String unit;
+        input >> size >> unit;
+        myNtuple->SetAutoFlush(unit == "MB" ? -size * 1000000 : size);
+    } else if (command == FlushPeriodCmd) {
+        myNtuple->SetFlushPeriod(StoI(newValues));
+    } else if (command == PrimFlushPeriodCmd) {
+        myNtuple->SetPrimFlushPeriod(StoI(newValues));
+    } else if (command == DeferredQuenchingCmd) {
+        myNtuple->SetDeferredQuenching(StoB(newValues));
+    } else if (command == KeepQuenchingStepsCmd) {
+        myNtuple->SetKeepQuenchingSteps(StoB(newValues));
+    } else if (command == StepFilterVolumeCmd) {
+        myNtuple->GetStepFilter().AddVolume(newValues);
+    } else if (command == StepFilterRegionCmd) {
+        myNtuple->GetStepFilter().AddRegion(newValues);
+    } else if (command == StepFilterParticleCmd) {
+        myNtuple->GetStepFilter().AddParticle(newValues);
+    } else if (command == StepFilterMinEdepCmd) {
+        std::istringstream input(newValues);
+        G4double edep;
+        G4String unit;
+        input >> edep >> unit;
+        myNtuple->GetStepFilter().SetMinEnergyDeposit(edep * G4UIcommand::ValueOf(unit));
+    } else if (command == StepFilterClearCmd) {
+        myNtuple->GetStepFilter().Clear();
+    } else if (command == StepFilterListCmd) {
+        myNtuple->GetStepFilter().Print();
     } else {
         CupRootNtupleMessenger::SetNewValue(command, newValues);
     }
@@ -55,8 +253,30 @@ G4String AmoreRootNtupleMessenger::GetCurrentValue(G4UIcommand *command) {
     // CalDeviceCmd
     if (command == CUTCmd) {
         return BtoS(myNtuple->GetRecordCut());
+    } else if (command == EventFilterCmd) {
+        return myNtuple->GetEventFilter();
     } else if (command == CUTCmd) {
         return BtoS(myNtuple->GetRecordPrim());
+    } else if (command == CompactStepCmd) {
+        return BtoS(myNtuple->GetCompactStep());
+    } else if (command == BasketSizeCmd) {
+        if (myNtuple->GetAutoBasketEvents() > 0)
+            return "auto " + ItoS(myNtuple->GetAutoBasketEvents());
+        return ItoS(myNtuple->GetBasketSize());
+    } else if (command == ClusterSizeCmd) {
+        Long64_t autoFlush = myNtuple->GetAutoFlush();
+        if (autoFlush < 0) return std::to_string(-autoFlush / 1000000) + " MB";
+        return std::to_string(autoFlush) + " events";
+    } else if (command == FlushPeriodCmd) {
+        return ItoS(myNtuple->GetFlushPeriod());
+    } else if (command == PrimFlushPeriodCmd) {
+        return ItoS(myNtuple->GetPrimFlushPeriod());
+    } else if (command == DeferredQuenchingCmd) {
+        return BtoS(myNtuple->GetDeferredQuenching());
+    } else if (command == KeepQuenchingStepsCmd) {
+        return BtoS(myNtuple->GetKeepQuenchingSteps());
+    } else if (command == StepFilterMinEdepCmd) {
+        return DtoS(myNtuple->GetStepFilter().GetMinEnergyDeposit() / keV) + " keV";
     } else { // invalid command
         return CupRootNtupleMessenger::GetCurrentValue(command);
     }
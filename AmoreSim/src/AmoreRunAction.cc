@@ -0,0 +1,68 @@
+#include "AmoreSim/AmoreRunAction.hh"
+#include "AmoreSim/AmoreLog.hh"
+#include "AmoreSim/AmoreRootNtuple.hh"
+
+#include "G4AutoLock.hh"
+#include "G4Run.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+    G4Mutex threadLoadMutex = G4MUTEX_INITIALIZER;
+}
+
+std::vector<AmoreRunAction::ThreadLoad> AmoreRunAction::fgThreadLoads;
+G4ThreadLocal G4double AmoreRunAction::fgBusyTime  = 0.;
+G4ThreadLocal G4int AmoreRunAction::fgEventCount   = 0;
+G4bool AmoreRunAction::fgReportThreadLoad          = true;
+
+AmoreRunAction::AmoreRunAction(AmoreRootNtuple *aRecorder) : CupRunAction(aRecorder) {}
+
+void AmoreRunAction::BeginOfRunAction(const G4Run *aRun) {
+    fRunStart    = std::chrono::steady_clock::now();
+    fgBusyTime   = 0.;
+    fgEventCount = 0;
+    CupRunAction::BeginOfRunAction(aRun);
+}
+
+void AmoreRunAction::EndOfRunAction(const G4Run *aRun) {
+    AmoreLog::Flush(); // Messages of the last events of this thread
+    CupRunAction::EndOfRunAction(aRun);
+
+    // Worker run terminations all happen before the one of the master
+    if (G4Threading::IsWorkerThread()) {
+        G4AutoLock lock(&threadLoadMutex);
+        fgThreadLoads.push_back({G4Threading::G4GetThreadId(), fgEventCount, fgBusyTime});
+        return;
+    }
+
+    std::chrono::duration<G4double> wallTime = std::chrono::steady_clock::now() - fRunStart;
+    G4AutoLock lock(&threadLoadMutex);
+    if (fgReportThreadLoad && !fgThreadLoads.empty()) PrintThreadLoads(wallTime.count());
+    fgThreadLoads.clear();
+}
+
+void AmoreRunAction::PrintThreadLoads(G4double aWallTime) const {
+    std::sort(fgThreadLoads.begin(), fgThreadLoads.end(),
+              [](const ThreadLoad &a, const ThreadLoad &b) { return a.fThreadID < b.fThreadID; });
+
+    G4double totalBusy = 0.;
+    G4cout << "========================== Thread load of this run ==========================\n"
+           << " Wall time of the run: " << aWallTime << " s\n"
+           << std::setw(8) << "Thread" << std::setw(12) << "Events" << std::setw(14)
+           << "Busy [s]" << std::setw(14) << "Idle [s]" << std::setw(12) << "Busy [%]" << "\n";
+    for (const auto &nowLoad : fgThreadLoads) {
+        G4double idle = std::max(0., aWallTime - nowLoad.fBusyTime);
+        totalBusy += nowLoad.fBusyTime;
+        G4cout << std::setw(8) << nowLoad.fThreadID << std::setw(12) << nowLoad.fEventCount
+               << std::setw(14) << nowLoad.fBusyTime << std::setw(14) << idle << std::setw(12)
+               << (aWallTime > 0. ? 100. * nowLoad.fBusyTime / aWallTime : 0.) << "\n";
+    }
+    G4double efficiency = aWallTime > 0. ? totalBusy / (aWallTime * fgThreadLoads.size()) : 0.;
+    G4cout << " Parallel efficiency: " << 100. * efficiency << " %\n"
+           << "=============================================================================="
+           << G4endl;
+}
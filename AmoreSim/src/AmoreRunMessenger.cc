@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////
+// AmoreRunMessenger
+////////////////////////////////////////////////////////////////
+
+#include "AmoreSim/AmoreRunMessenger.hh"
+#include "AmoreSim/AmoreRunAction.hh"
+
+#include "G4RunManager.hh"
+#include "G4UIcommand.hh"
+#include "G4UIdirectory.hh"
+#include "G4Version.hh"
+#include "G4ios.hh"
+
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#if G4VERSION_NUMBER >= 1070
+#include "G4TaskRunManager.hh"
+#endif
+#endif
+
+AmoreRunMessenger::AmoreRunMessenger(G4RunManager *aRunManager)
+    : fRunManager(aRunManager), fEventsPerTask(0) {
+    fAmoreDir = new G4UIdirectory("/amore/");
+    fAmoreDir->SetGuidance("Control options of amoresim.");
+
+    fRunDir = new G4UIdirectory("/amore/run/");
+    fRunDir->SetGuidance("Control the event scheduling of the run manager backend.");
+
+    fEventsPerTaskCmd = new G4UIcommand("/amore/run/eventsPerTask", this);
+    fEventsPerTaskCmd->SetGuidance("Set the grain size: the number of events in one task.");
+    fEventsPerTaskCmd->SetGuidance("Small values balance events of very different costs better,");
+    fEventsPerTaskCmd->SetGuidance("large values reduce the scheduling overhead of cheap events.");
+    fEventsPerTaskCmd->SetGuidance("For the MT backend, this is the number of events per seed request.");
+    fEventsPerTaskCmd->SetGuidance("0 restores the automatic choice of Geant4.");
+    fEventsPerTaskCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    G4UIparameter *nEvtParam = new G4UIparameter("nEvents", 'i', false);
+    nEvtParam->SetParameterRange("nEvents >= 0");
+    fEventsPerTaskCmd->SetParameter(nEvtParam);
+
+    fReportThreadLoadCmd = new G4UIcommand("/amore/run/reportThreadLoad", this);
+    fReportThreadLoadCmd->SetGuidance("Print the busy/idle time of every worker at end of run.");
+    fReportThreadLoadCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fReportThreadLoadCmd->SetParameter(new G4UIparameter("enable", 'b', true));
+}
+
+AmoreRunMessenger::~AmoreRunMessenger() {
+    delete fEventsPerTaskCmd;
+    delete fReportThreadLoadCmd;
+    delete fRunDir;
+    delete fAmoreDir;
+}
+
+void AmoreRunMessenger::SetNewValue(G4UIcommand *command, G4String newValues) {
+    if (command == fEventsPerTaskCmd) {
+        fEventsPerTask = StoI(newValues);
+#ifdef G4MULTITHREADED
+#if G4VERSION_NUMBER >= 1070
+        // The tasking backend caps the events of a task at (events of run)/(grain size), so
+        // the grain size is lowered to 1 to make the event modulo the number of events per task.
+        G4TaskRunManager *taskRM = dynamic_cast<G4TaskRunManager *>(fRunManager);
+        if (taskRM != nullptr) taskRM->SetGrainsize(fEventsPerTask > 0 ? 1 : 0);
+#endif
+        G4MTRunManager *mtRM = dynamic_cast<G4MTRunManager *>(fRunManager);
+        if (mtRM != nullptr) {
+            mtRM->SetEventModulo(fEventsPerTask);
+            return;
+        }
+#endif
+        G4cout << "The run manager is sequential. /amore/run/eventsPerTask has no effect."
+               << G4endl;
+    } else if (command == fReportThreadLoadCmd) {
+        AmoreRunAction::SetReportThreadLoad(StoB(newValues));
+    }
+}
+
+G4String AmoreRunMessenger::GetCurrentValue(G4UIcommand *command) {
+    if (command == fEventsPerTaskCmd) {
+        return ItoS(fEventsPerTask);
+    } else if (command == fReportThreadLoadCmd) {
+        return BtoS(AmoreRunAction::GetReportThreadLoad());
+    }
+    return G4String();
+}
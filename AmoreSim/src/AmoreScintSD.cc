@@ -1,30 +1,42 @@
 #include "AmoreSim/AmoreScintSD.hh"
 #include "CupSim/CupScintSD.hh"
 
+#include "AmoreSim/AmoreLog.hh"
 #include "AmoreSim/AmoreScintillation.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4PhysicalVolumeStore.hh"
 //#include "CupSim/CupScintillation.hh"
 //#include "G4LossTableManager.hh"
 //#include "G4EmSaturation.hh"
 
 // Constructor /////////////////////////////////////////////////////////////
-AmoreScintSD::AmoreScintSD(G4String name, int arg_max_tgs) : CupScintSD(name, arg_max_tgs) {}
+AmoreScintSD::AmoreScintSD(G4String name, int arg_max_tgs)
+    : CupScintSD(name, arg_max_tgs), fOpticalPhoton(G4OpticalPhoton::Definition()),
+      fEnvelopesCollected(false) {}
 
 // Destructor //////////////////////////////////////////////////////////////
 AmoreScintSD::~AmoreScintSD() {}
 
+// The geometry is complete once the events start, so the envelopes are looked up only once
+void AmoreScintSD::Initialize(G4HCofThisEvent *HCE) {
+    CupScintSD::Initialize(HCE);
+    if (fEnvelopesCollected) return;
+    for (auto nowPV : *G4PhysicalVolumeStore::GetInstance())
+        if (strstr(nowPV->GetName(), "Envelope") != NULL) fEnvelopePVs.insert(nowPV);
+    fEnvelopesCollected = true;
+}
+
 G4bool AmoreScintSD::ProcessHits(G4Step *aStep, G4TouchableHistory * /*ROhist*/) {
     //  G4EmSaturation * emSaturation = G4LossTableManager::Instance()->EmSaturation();
 
     //  G4double edep_quenched = emSaturation->VisibleEnergyDeposition(aStep);
     //  G4double edep_quenched = CupScintillation::GetTotEdepQuenched();
-    G4double edep_quenched             = AmoreScintillation::GetTotEdepQuenched();
-    G4double edep                      = aStep->GetTotalEnergyDeposit();
-    G4ParticleDefinition *particleType = aStep->GetTrack()->GetDefinition();
-    G4String particleName              = particleType->GetParticleName();
+    G4double edep_quenched = AmoreScintillation::GetTotEdepQuenched();
+    G4double edep          = aStep->GetTotalEnergyDeposit();
 
     //  if(edep==0.) return true;
-    if (edep == 0. || particleName == "opticalphoton") return true;
-    G4cout << "EJ: edep= " << edep << ", visible= " << edep_quenched << G4endl;
+    if (edep == 0. || aStep->GetTrack()->GetDefinition() == fOpticalPhoton) return true;
+    AMORE_LOG(kHit, kDebug) << "EJ: edep= " << edep << ", visible= " << edep_quenched;
 
     // EJ: for LSVetoFullDetector (20150910)
     G4StepPoint *preStepPoint            = aStep->GetPreStepPoint();
@@ -33,12 +45,11 @@ G4bool AmoreScintSD::ProcessHits(G4Step *aStep, G4TouchableHistory * /*ROhist*/)
     G4int motherCopyNo                   = theTouchable->GetCopyNumber(1);
     G4VPhysicalVolume *thePhysical       = theTouchable->GetVolume();
     G4VPhysicalVolume *theMotherPhysical = theTouchable->GetVolume(1);
-    G4String motherVolName               = theMotherPhysical->GetName();
     // G4cout << "EJ: physical volume name= " << thePhysical->GetName() << ", mother physical volume
     // name= " << motherVolName << G4endl; G4cout << "EJ: copyNo= " << copyNo << ", motherCopyNo= "
     // << motherCopyNo << G4endl;
 
-    if ((strstr(motherVolName, "Envelope")) != NULL) copyNo = motherCopyNo;
+    if (fEnvelopePVs.count(theMotherPhysical) > 0) copyNo = motherCopyNo;
     // G4cout << "EJ2: copyNo= " << copyNo << ", motherCopyNo= " << motherCopyNo << G4endl;
 
     CupScintHit *aHit = (*hitsCollection)[copyNo];
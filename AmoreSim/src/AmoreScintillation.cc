@@ -1,19 +1,96 @@
 #include "AmoreSim/AmoreScintillation.hh"
 #include "CupSim/CupScintillation.hh"
 
+#include "G4Material.hh"
+#include "G4MaterialPropertiesTable.hh"
 #include "G4ParticleTypes.hh"
 #include "G4Version.hh"
+
+#include <limits>
 using namespace CLHEP;
 
-G4double AmoreScintillation::TotalEnergyDepositQuenched = 0.0;
+namespace {
+    const char *kYieldVectorNames[] = {"PROTONSCINTILLATIONYIELD", "DEUTERONSCINTILLATIONYIELD",
+                                       "TRITONSCINTILLATIONYIELD", "ALPHASCINTILLATIONYIELD",
+                                       "IONSCINTILLATIONYIELD",    "ELECTRONSCINTILLATIONYIELD"};
+
+    G4double ConstPropertyOf(const G4MaterialPropertiesTable *aTable, const char *aKey) {
+        return aTable->ConstPropertyExists(aKey) ? aTable->GetConstProperty(aKey)
+                                                 : std::numeric_limits<G4double>::quiet_NaN();
+    }
+} // namespace
+
+G4ThreadLocal G4double AmoreScintillation::TotalEnergyDepositQuenched = 0.0;
 
 // Constructor /////////////////////////////////////////////////////////////
 AmoreScintillation::AmoreScintillation(const G4String &processName, G4ProcessType type)
-    : CupScintillation(processName, type) {}
+    : CupScintillation(processName, type), fLastParticle(nullptr), fLastYieldType(kElectronYield) {}
 
 // Destructor //////////////////////////////////////////////////////////////
 AmoreScintillation::~AmoreScintillation() {}
 
+void AmoreScintillation::BuildPhysicsTable(const G4ParticleDefinition &aParticleType) {
+    CupScintillation::BuildPhysicsTable(aParticleType);
+    BuildMaterialParameters();
+}
+
+void AmoreScintillation::BuildMaterialParameters() {
+    const G4MaterialTable *theMaterialTable = G4Material::GetMaterialTable();
+    fMaterialParameters.assign(theMaterialTable->size(), MaterialParameters());
+
+    for (auto nowMaterial : *theMaterialTable) {
+        // The properties are only read, but GetProperty is not const in every version
+        G4MaterialPropertiesTable *nowTable = nowMaterial->GetMaterialPropertiesTable();
+        if (nowTable == nullptr) continue;
+        MaterialParameters &nowParameters = fMaterialParameters[nowMaterial->GetIndex()];
+
+        nowParameters.fFastIntensity = nowTable->GetProperty("FASTCOMPONENT");
+        nowParameters.fSlowIntensity = nowTable->GetProperty("SLOWCOMPONENT");
+        if (!nowParameters.fFastIntensity && !nowParameters.fSlowIntensity) continue;
+        nowParameters.fTable = nowTable;
+
+        for (G4int i = 0; i < kNYieldTypes; i++)
+            nowParameters.fYieldVectors[i] = nowTable->GetProperty(kYieldVectorNames[i]);
+        for (auto &nowVector : nowParameters.fYieldVectors)
+            if (!nowVector) nowVector = nowParameters.fYieldVectors[kElectronYield];
+
+        nowParameters.fYield           = ConstPropertyOf(nowTable, "SCINTILLATIONYIELD");
+        nowParameters.fResolutionScale = ConstPropertyOf(nowTable, "RESOLUTIONSCALE");
+        nowParameters.fYieldRatio      = ConstPropertyOf(nowTable, "YIELDRATIO");
+        nowParameters.fFastTime        = ConstPropertyOf(nowTable, "FASTTIMECONSTANT");
+        nowParameters.fSlowTime        = ConstPropertyOf(nowTable, "SLOWTIMECONSTANT");
+        nowParameters.fFastRiseTime    = ConstPropertyOf(nowTable, "FASTSCINTILLATIONRISETIME");
+        nowParameters.fSlowRiseTime    = ConstPropertyOf(nowTable, "SLOWSCINTILLATIONRISETIME");
+    }
+}
+
+// Steps come in runs of the same track, so the type of the last particle is kept
+AmoreScintillation::eYieldType AmoreScintillation::GetYieldType(
+    const G4ParticleDefinition *aParticle) {
+    if (aParticle == fLastParticle) return fLastYieldType;
+    fLastParticle = aParticle;
+
+    if (aParticle == G4Proton::ProtonDefinition())
+        fLastYieldType = kProtonYield;
+    else if (aParticle == G4Deuteron::DeuteronDefinition())
+        fLastYieldType = kDeuteronYield;
+    else if (aParticle == G4Triton::TritonDefinition())
+        fLastYieldType = kTritonYield;
+    else if (aParticle == G4Alpha::AlphaDefinition())
+        fLastYieldType = kAlphaYield;
+    // Ions (particles derived from G4VIon and G4Ions)
+    // and recoil ions below tracking cut from neutrons after hElastic
+    else if (aParticle->GetParticleType() == "nucleus" ||
+             aParticle == G4Neutron::NeutronDefinition())
+        fLastYieldType = kIonYield;
+    // Electrons (must also account for shell-binding energy
+    // attributed to gamma from standard PhotoElectricEffect),
+    // and the particles not listed above
+    else
+        fLastYieldType = kElectronYield;
+    return fLastYieldType;
+}
+
 // PostStepDoIt
 // -------------
 //
@@ -37,16 +114,12 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
 
     G4double TotalEnergyDeposit = aStep.GetTotalEnergyDeposit();
 
-    G4MaterialPropertiesTable *aMaterialPropertiesTable = aMaterial->GetMaterialPropertiesTable();
-    if (!aMaterialPropertiesTable) return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+    const MaterialParameters *nowParameters = GetMaterialParameters(aMaterial);
+    if (nowParameters == nullptr) return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+    const MaterialParameters &params = *nowParameters;
 
-    G4MaterialPropertyVector *Fast_Intensity =
-        aMaterialPropertiesTable->GetProperty("FASTCOMPONENT");
-    G4MaterialPropertyVector *Slow_Intensity =
-        aMaterialPropertiesTable->GetProperty("SLOWCOMPONENT");
-
-    if (!Fast_Intensity && !Slow_Intensity)
-        return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+    G4MaterialPropertyVector *Fast_Intensity = params.fFastIntensity;
+    G4MaterialPropertyVector *Slow_Intensity = params.fSlowIntensity;
 
     G4int nscnt = 1;
     if (Fast_Intensity && Slow_Intensity) nscnt = 2;
@@ -58,53 +131,13 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
         // deposited by particle types.
 
         // Get the definition of the current particle
-        G4ParticleDefinition *pDef                   = aParticle->GetDefinition();
-        G4MaterialPropertyVector *Scint_Yield_Vector = NULL;
+        G4ParticleDefinition *pDef = aParticle->GetDefinition();
 
         // Obtain the G4MaterialPropertyVectory containing the
         // scintillation light yield as a function of the deposited
-        // energy for the current particle type
-
-        // Protons
-        if (pDef == G4Proton::ProtonDefinition())
-            Scint_Yield_Vector = aMaterialPropertiesTable->GetProperty("PROTONSCINTILLATIONYIELD");
-
-        // Deuterons
-        else if (pDef == G4Deuteron::DeuteronDefinition())
-            Scint_Yield_Vector =
-                aMaterialPropertiesTable->GetProperty("DEUTERONSCINTILLATIONYIELD");
-
-        // Tritons
-        else if (pDef == G4Triton::TritonDefinition())
-            Scint_Yield_Vector = aMaterialPropertiesTable->GetProperty("TRITONSCINTILLATIONYIELD");
-
-        // Alphas
-        else if (pDef == G4Alpha::AlphaDefinition())
-            Scint_Yield_Vector = aMaterialPropertiesTable->GetProperty("ALPHASCINTILLATIONYIELD");
-
-        // Ions (particles derived from G4VIon and G4Ions)
-        // and recoil ions below tracking cut from neutrons after hElastic
-        else if (pDef->GetParticleType() == "nucleus" || pDef == G4Neutron::NeutronDefinition())
-            Scint_Yield_Vector = aMaterialPropertiesTable->GetProperty("IONSCINTILLATIONYIELD");
-
-        // Electrons (must also account for shell-binding energy
-        // attributed to gamma from standard PhotoElectricEffect)
-        else if (pDef == G4Electron::ElectronDefinition() || pDef == G4Gamma::GammaDefinition())
-            Scint_Yield_Vector =
-                aMaterialPropertiesTable->GetProperty("ELECTRONSCINTILLATIONYIELD");
-
-        // Default for particles not enumerated/listed above
-        else
-            Scint_Yield_Vector =
-                aMaterialPropertiesTable->GetProperty("ELECTRONSCINTILLATIONYIELD");
-
-        // If the user has not specified yields for (p,d,t,a,carbon)
-        // then these unspecified particles will default to the
-        // electron's scintillation yield
-        if (!Scint_Yield_Vector) {
-            Scint_Yield_Vector =
-                aMaterialPropertiesTable->GetProperty("ELECTRONSCINTILLATIONYIELD");
-        }
+        // energy for the current particle type. Particles without
+        // their own yield take the one of the electron.
+        G4MaterialPropertyVector *Scint_Yield_Vector = params.fYieldVectors[GetYieldType(pDef)];
 
         // Throw an exception if no scintillation yield is found
         if (!Scint_Yield_Vector) {
@@ -135,16 +168,8 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
 
         // Units: [# scintillation photons]
         ScintillationYield = Scint_Yield_Vector->Value(TotalEnergyDeposit);
-    } else {
-        // The default linear scintillation process
-        ScintillationYield = aMaterialPropertiesTable->GetConstProperty("SCINTILLATIONYIELD");
-
-        // Units: [# scintillation photons / MeV]
-        ScintillationYield *= YieldFactor;
     }
 
-    G4double ResolutionScale = aMaterialPropertiesTable->GetConstProperty("RESOLUTIONSCALE");
-
     // Birks law saturation:
 
     // G4double constBirks = 0.0;
@@ -161,19 +186,38 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
     if (scintillationByParticleType) {
         // EJ: start
         TotalEnergyDepositQuenched = ScintillationYield * TotalEnergyDeposit;
-        MeanNumberOfPhotons        = TotalEnergyDepositQuenched * 40000.; // EJ: 40000pe/MeV
-                                                                          // EJ: end
+        // EJ: end
     } else if (emSaturation) {
 #if G4VERSION_NUMBER <= 1020
         TotalEnergyDepositQuenched = emSaturation->VisibleEnergyDeposition(&aStep);
 #else
         TotalEnergyDepositQuenched = emSaturation->VisibleEnergyDepositionAtAStep(&aStep);
 #endif
-        MeanNumberOfPhotons = ScintillationYield * TotalEnergyDepositQuenched;
+    }
+
+    // Without photons, only the deposits are summed and no photon number is sampled
+    if (!doScintillation) {
+        totEdep += TotalEnergyDeposit;
+        totEdep_quenched += TotalEnergyDepositQuenched;
+        aParticleChange.SetNumberOfSecondaries(0);
+        return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
+    }
+
+    if (scintillationByParticleType) {
+        MeanNumberOfPhotons = TotalEnergyDepositQuenched * 40000.; // EJ: 40000pe/MeV
     } else {
-        MeanNumberOfPhotons = ScintillationYield * TotalEnergyDeposit;
+        // The default linear scintillation process
+        ScintillationYield = params.Get(params.fYield, "SCINTILLATIONYIELD");
+
+        // Units: [# scintillation photons / MeV]
+        ScintillationYield *= YieldFactor;
+
+        MeanNumberOfPhotons = ScintillationYield * (emSaturation ? TotalEnergyDepositQuenched
+                                                                 : TotalEnergyDeposit);
     }
 
+    G4double ResolutionScale = params.Get(params.fResolutionScale, "RESOLUTIONSCALE");
+
     G4int NumPhotons;
 
     if (MeanNumberOfPhotons > 10.) {
@@ -208,14 +252,6 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
         return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
     }
 
-    // EJ: start
-    // now we are done if we are not actually making photons here
-    if (!doScintillation) {
-        aParticleChange.SetNumberOfSecondaries(0);
-        return G4VRestDiscreteProcess::PostStepDoIt(aTrack, aStep);
-    }
-    // EJ: end
-
     ////////////////////////////////////////////////////////////////
 
     aParticleChange.SetNumberOfSecondaries(NumPhotons);
@@ -242,46 +278,44 @@ G4VParticleChange *AmoreScintillation::PostStepDoIt(const G4Track &aTrack, const
         if (scnt == 1) {
             if (nscnt == 1) {
                 if (Fast_Intensity) {
-                    ScintillationTime =
-                        aMaterialPropertiesTable->GetConstProperty("FASTTIMECONSTANT");
+                    ScintillationTime = params.Get(params.fFastTime, "FASTTIMECONSTANT");
                     if (fFiniteRiseTime) {
                         ScintillationRiseTime =
-                            aMaterialPropertiesTable->GetConstProperty("FASTSCINTILLATIONRISETIME");
+                            params.Get(params.fFastRiseTime, "FASTSCINTILLATIONRISETIME");
                     }
                     ScintillationIntegral =
                         (G4PhysicsOrderedFreeVector *)((*theFastIntegralTable)(materialIndex));
                 }
                 if (Slow_Intensity) {
-                    ScintillationTime =
-                        aMaterialPropertiesTable->GetConstProperty("SLOWTIMECONSTANT");
+                    ScintillationTime = params.Get(params.fSlowTime, "SLOWTIMECONSTANT");
                     if (fFiniteRiseTime) {
                         ScintillationRiseTime =
-                            aMaterialPropertiesTable->GetConstProperty("SLOWSCINTILLATIONRISETIME");
+                            params.Get(params.fSlowRiseTime, "SLOWSCINTILLATIONRISETIME");
                     }
                     ScintillationIntegral =
                         (G4PhysicsOrderedFreeVector *)((*theSlowIntegralTable)(materialIndex));
                 }
             } else {
-                G4double YieldRatio = aMaterialPropertiesTable->GetConstProperty("YIELDRATIO");
+                G4double YieldRatio = params.Get(params.fYieldRatio, "YIELDRATIO");
                 if (ExcitationRatio == 1.0) {
                     Num = G4int(std::min(YieldRatio, 1.0) * NumPhotons);
                 } else {
                     Num = G4int(std::min(ExcitationRatio, 1.0) * NumPhotons);
                 }
-                ScintillationTime = aMaterialPropertiesTable->GetConstProperty("FASTTIMECONSTANT");
+                ScintillationTime = params.Get(params.fFastTime, "FASTTIMECONSTANT");
                 if (fFiniteRiseTime) {
                     ScintillationRiseTime =
-                        aMaterialPropertiesTable->GetConstProperty("FASTSCINTILLATIONRISETIME");
+                        params.Get(params.fFastRiseTime, "FASTSCINTILLATIONRISETIME");
                 }
                 ScintillationIntegral =
                     (G4PhysicsOrderedFreeVector *)((*theFastIntegralTable)(materialIndex));
             }
         } else {
             Num               = NumPhotons - Num;
-            ScintillationTime = aMaterialPropertiesTable->GetConstProperty("SLOWTIMECONSTANT");
+            ScintillationTime = params.Get(params.fSlowTime, "SLOWTIMECONSTANT");
             if (fFiniteRiseTime) {
                 ScintillationRiseTime =
-                    aMaterialPropertiesTable->GetConstProperty("SLOWSCINTILLATIONRISETIME");
+                    params.Get(params.fSlowRiseTime, "SLOWSCINTILLATIONRISETIME");
             }
             ScintillationIntegral =
                 (G4PhysicsOrderedFreeVector *)((*theSlowIntegralTable)(materialIndex));
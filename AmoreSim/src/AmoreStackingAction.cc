@@ -0,0 +1,69 @@
+#include "AmoreSim/AmoreStackingAction.hh"
+#include "AmoreSim/AmoreSubEventManager.hh"
+#include "AmoreSim/AmoreTrackInformation.hh"
+
+#include "G4DynamicParticle.hh"
+#include "G4OpticalPhoton.hh"
+#include "G4StackManager.hh"
+#include "G4Track.hh"
+
+#include <vector>
+
+AmoreStackingAction::AmoreStackingAction()
+    : G4UserStackingAction(), fSubEventManager(AmoreSubEventManager::GetInstance()),
+      fOpticalPhoton(G4OpticalPhoton::Definition()), fNewTracks(0), fOffloadEvent(false),
+      fReclaiming(false), fHasWaitingTrack(false) {}
+
+G4ClassificationOfNewTrack AmoreStackingAction::ClassifyNewTrack(const G4Track *aTrack) {
+    if (!fOffloadEvent || fReclaiming || aTrack->GetParentID() == 0 ||
+        aTrack->GetDefinition() == fOpticalPhoton)
+        return fUrgent;
+    if (++fNewTracks <= fSubEventManager->GetThreshold()) return fUrgent;
+
+    // Geant4 calls NewStage() only if the waiting stack has a track when the urgent stack runs
+    // dry, so one track of every stage that offloads is kept there instead.
+    if (!fHasWaitingTrack) {
+        fHasWaitingTrack = true;
+        return fWaiting;
+    }
+    return fSubEventManager->Offload(aTrack) ? fKill : fUrgent;
+}
+
+void AmoreStackingAction::NewStage() {
+    if (!fOffloadEvent) return;
+    fHasWaitingTrack = false;
+
+    // The stack is empty: hand out the partial bundle, then take back what is still waiting
+    fSubEventManager->FlushOpenBundle();
+    std::vector<AmoreSubEventTrack> reclaimedTracks;
+    fSubEventManager->ReclaimPending(reclaimedTracks);
+
+    fReclaiming = true;
+    for (const auto &nowTrack : reclaimedTracks) {
+        G4DynamicParticle *nowParticle = new G4DynamicParticle(
+            nowTrack.fDefinition, nowTrack.fMomentumDirection, nowTrack.fKineticEnergy);
+        nowParticle->SetPolarization(nowTrack.fPolarization.x(), nowTrack.fPolarization.y(),
+                                     nowTrack.fPolarization.z());
+
+        G4Track *newTrack = new G4Track(nowParticle, nowTrack.fGlobalTime, nowTrack.fPosition);
+        newTrack->SetTrackID(nowTrack.fTrackID);
+        newTrack->SetParentID(nowTrack.fParentID);
+        newTrack->SetWeight(nowTrack.fWeight);
+
+        AmoreTrackInformation *nowInfo = new AmoreTrackInformation(newTrack);
+        if (nowTrack.fMotherDefinition != nullptr)
+            nowInfo->SetParentDefinition(
+                const_cast<G4ParticleDefinition *>(nowTrack.fMotherDefinition));
+        newTrack->SetUserInformation(nowInfo);
+
+        stackManager->PushOneTrack(newTrack);
+    }
+    fReclaiming = false;
+}
+
+void AmoreStackingAction::PrepareNewEvent() {
+    fNewTracks       = 0;
+    fHasWaitingTrack = false;
+    fOffloadEvent    = fSubEventManager->IsEnabled() &&
+                       AmoreSubEventManager::GetCurrentSubEvent() == nullptr;
+}
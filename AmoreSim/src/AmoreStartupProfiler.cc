@@ -0,0 +1,108 @@
+#include "AmoreSim/AmoreStartupProfiler.hh"
+
+#include "G4AutoLock.hh"
+#include "G4StateManager.hh"
+#include "G4Threading.hh"
+#include "G4ios.hh"
+
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+
+namespace {
+    G4Mutex profilerMutex = G4MUTEX_INITIALIZER;
+
+    G4double PeakRSSInMB() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.; // ru_maxrss is in kB on Linux
+    }
+
+    std::string JSONString(const G4String &aText) {
+        std::string escaped = "\"";
+        for (char nowChar : aText) {
+            if (nowChar == '"' || nowChar == '\\') escaped += '\\';
+            escaped += nowChar;
+        }
+        return escaped + "\"";
+    }
+} // namespace
+
+AmoreStartupProfiler *AmoreStartupProfiler::fgInstance = nullptr;
+
+// The state manager deletes the instance at the end of the job
+AmoreStartupProfiler *AmoreStartupProfiler::GetInstance() {
+    if (fgInstance == nullptr) fgInstance = new AmoreStartupProfiler;
+    return fgInstance;
+}
+
+AmoreStartupProfiler::AmoreStartupProfiler()
+    : G4VStateDependent(), fStartTime(std::chrono::steady_clock::now()), fOpenDepth(0),
+      fInitializeStage(-1), fRunInitStage(-1), fRunInitDone(false) {}
+
+G4double AmoreStartupProfiler::SecondsSinceStart() const {
+    return std::chrono::duration<G4double>(std::chrono::steady_clock::now() - fStartTime)
+        .count();
+}
+
+// Stages of worker threads (e.g. CreateTree of their recorders) are listed flat
+G4int AmoreStartupProfiler::Begin(const G4String &aName) {
+    G4AutoLock lock(&profilerMutex);
+    G4bool isMaster = G4Threading::IsMasterThread();
+    fStages.push_back({aName, isMaster ? -1 : G4Threading::G4GetThreadId(),
+                       isMaster ? fOpenDepth++ : 0, SecondsSinceStart(), -1., 0.});
+    return fStages.size() - 1;
+}
+
+void AmoreStartupProfiler::End(G4int aIndex) {
+    G4AutoLock lock(&profilerMutex);
+    Stage &nowStage    = fStages[aIndex];
+    nowStage.fWallTime = SecondsSinceStart() - nowStage.fStart;
+    nowStage.fPeakRSS  = PeakRSSInMB();
+    if (nowStage.fThreadID < 0) fOpenDepth--;
+}
+
+G4bool AmoreStartupProfiler::Notify(G4ApplicationState requestedState) {
+    G4ApplicationState currentState = G4StateManager::GetStateManager()->GetCurrentState();
+    if (currentState == G4State_PreInit && requestedState == G4State_Init) {
+        if (fInitializeStage < 0) fInitializeStage = Begin("Initialize");
+    } else if (currentState == G4State_Idle && requestedState == G4State_Init) {
+        // Geant4 builds the physics tables and closes the geometry in this state, with no
+        // state change in between, so both are timed as one stage.
+        if (!fRunInitDone && fRunInitStage < 0)
+            fRunInitStage = Begin("PhysicsTablesAndVoxelization");
+    } else if (currentState == G4State_Init && requestedState == G4State_Idle) {
+        if (fInitializeStage >= 0 && fStages[fInitializeStage].fWallTime < 0) {
+            End(fInitializeStage);
+        } else if (fRunInitStage >= 0 && !fRunInitDone) {
+            End(fRunInitStage);
+            fRunInitDone = true;
+        }
+    }
+    return true;
+}
+
+void AmoreStartupProfiler::WriteReport(const G4String &aFileName) const {
+    G4AutoLock lock(&profilerMutex);
+    std::ofstream report(aFileName.c_str());
+    if (!report) {
+        G4Exception(__PRETTY_FUNCTION__, "PROFILER_REPORT", JustWarning,
+                    ("The startup report cannot be written to " + aFileName).c_str());
+        return;
+    }
+    report << std::fixed << std::setprecision(4);
+    report << "{\n  \"elapsed_s\": " << SecondsSinceStart() << ",\n  \"peak_rss_mb\": "
+           << PeakRSSInMB() << ",\n  \"stages\": [";
+    for (size_t i = 0; i < fStages.size(); i++) {
+        const Stage &nowStage = fStages[i];
+        report << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << JSONString(nowStage.fName)
+               << ", \"thread\": " << nowStage.fThreadID << ", \"depth\": " << nowStage.fDepth
+               << ", \"start_s\": " << nowStage.fStart;
+        if (nowStage.fWallTime >= 0)
+            report << ", \"wall_s\": " << nowStage.fWallTime
+                   << ", \"peak_rss_mb\": " << nowStage.fPeakRSS;
+        report << "}";
+    }
+    report << "\n  ]\n}\n";
+    G4cout << "The startup profile has been written to " << aFileName << G4endl;
+}
@@ -0,0 +1,121 @@
+#include "AmoreSim/AmoreStepFilter.hh"
+#include "AmoreSim/AmoreVolumeTable.hh"
+
+#include "G4LogicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4ParticleTable.hh"
+#include "G4Region.hh"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4UnitsTable.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4ios.hh"
+
+void AmoreStepFilter::AddVolume(const G4String &aName) {
+    fVolumeNames.insert(aName);
+    fResolved = false;
+}
+
+void AmoreStepFilter::AddRegion(const G4String &aName) {
+    fRegionNames.insert(aName);
+    fResolved = false;
+}
+
+void AmoreStepFilter::AddParticle(const G4String &aName) {
+    fParticleNames.insert(aName);
+    fResolved = false;
+}
+
+void AmoreStepFilter::SetMinEnergyDeposit(G4double aEdep) { fMinEdep = aEdep; }
+
+void AmoreStepFilter::Clear() {
+    fVolumeNames.clear();
+    fRegionNames.clear();
+    fParticleNames.clear();
+    fMinEdep  = 0.;
+    fResolved = false;
+}
+
+void AmoreStepFilter::Print() const {
+    auto printNames = [](const char *aTitle, const std::set<G4String> &aNames) {
+        G4cout << "  " << aTitle << ":";
+        if (aNames.empty()) G4cout << " any";
+        for (const auto &nowName : aNames)
+            G4cout << " " << nowName;
+        G4cout << G4endl;
+    };
+    G4cout << "Step recording filter" << (IsActive() ? "" : " (inactive)") << G4endl;
+    printNames("Volumes", fVolumeNames);
+    printNames("Regions", fRegionNames);
+    printNames("Particles", fParticleNames);
+    G4cout << "  Minimum energy deposit: " << G4BestUnit(fMinEdep, "Energy") << G4endl;
+}
+
+// The cheapest test comes first. Names are not touched here after the first step.
+G4bool AmoreStepFilter::Accept(const G4Step *aStep, AmoreVolumeTable &aVolumeTable) {
+    if (aStep->GetTotalEnergyDeposit() < fMinEdep) return false;
+    if (!fResolved) Resolve(aVolumeTable);
+
+    const G4Track *theTrack = aStep->GetTrack();
+    if (!fParticleNames.empty() &&
+        fAcceptedParticles.find(theTrack->GetDefinition()) == fAcceptedParticles.end())
+        return false;
+    if (!fAcceptedVolumes.empty()) {
+        const AmoreVolumeTable::Entry *volumeEntry = aVolumeTable.Find(theTrack->GetVolume());
+        if (volumeEntry == nullptr || !fAcceptedVolumes[volumeEntry->fID]) return false;
+    }
+    return true;
+}
+
+void AmoreStepFilter::Resolve(AmoreVolumeTable &aVolumeTable) {
+    fAcceptedVolumes.clear();
+    if (!fVolumeNames.empty() || !fRegionNames.empty()) {
+        fAcceptedVolumes.assign(aVolumeTable.GetNVolumes(), false);
+        std::set<G4String> foundNames;
+        std::set<const G4LogicalVolume *> done;
+        for (size_t i = 0; i < aVolumeTable.GetNVolumes(); i++) {
+            const G4VPhysicalVolume *nowPV = aVolumeTable.GetVolume(i);
+            const G4LogicalVolume *nowLV   = nowPV->GetLogicalVolume();
+            const G4Region *nowRegion      = nowLV->GetRegion();
+            if (fVolumeNames.count(nowPV->GetName())) {
+                foundNames.insert(nowPV->GetName());
+                fAcceptedVolumes[i] = true;
+                AcceptInside(nowLV, aVolumeTable, done);
+            }
+            if (nowRegion != nullptr && fRegionNames.count(nowRegion->GetName())) {
+                foundNames.insert(nowRegion->GetName());
+                fAcceptedVolumes[i] = true;
+            }
+        }
+        for (const auto &nowNames : {fVolumeNames, fRegionNames})
+            for (const auto &nowName : nowNames)
+                if (foundNames.count(nowName) == 0)
+                    G4Exception(__PRETTY_FUNCTION__, "STEPFILTER_NOVOLUME", JustWarning,
+                                ("There is no volume or region named " + nowName +
+                                 ". No step is recorded for it.")
+                                    .c_str());
+    }
+
+    fAcceptedParticles.clear();
+    G4ParticleTable *particleTable = G4ParticleTable::GetParticleTable();
+    for (const auto &nowName : fParticleNames) {
+        const G4ParticleDefinition *nowParticle = particleTable->FindParticle(nowName);
+        if (nowParticle == nullptr)
+            G4Exception(__PRETTY_FUNCTION__, "STEPFILTER_NOPARTICLE", JustWarning,
+                        ("There is no particle named " + nowName + ".").c_str());
+        else
+            fAcceptedParticles.insert(nowParticle);
+    }
+    fResolved = true;
+}
+
+void AmoreStepFilter::AcceptInside(const G4LogicalVolume *aLV, AmoreVolumeTable &aVolumeTable,
+                                   std::set<const G4LogicalVolume *> &aDone) {
+    if (!aDone.insert(aLV).second) return;
+    for (size_t i = 0; i < aLV->GetNoDaughters(); i++) {
+        G4VPhysicalVolume *nowDaughter          = aLV->GetDaughter(i);
+        const AmoreVolumeTable::Entry *nowEntry = aVolumeTable.Find(nowDaughter);
+        if (nowEntry != nullptr) fAcceptedVolumes[nowEntry->fID] = true;
+        AcceptInside(nowDaughter->GetLogicalVolume(), aVolumeTable, aDone);
+    }
+}
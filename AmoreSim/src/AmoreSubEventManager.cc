@@ -0,0 +1,354 @@
+#include "AmoreSim/AmoreSubEventManager.hh"
+#include "AmoreSim/AmoreModuleHit.hh"
+#include "AmoreSim/AmoreTrackInformation.hh"
+#include "CupSim/CupScintHit.hh"
+#include "MCObjs/TTrack.hh"
+
+#include "G4Event.hh"
+#include "G4HCofThisEvent.hh"
+#include "G4SDManager.hh"
+#include "G4Track.hh"
+#include "G4UIcommand.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIparameter.hh"
+#include "G4ios.hh"
+
+#include <algorithm>
+
+namespace {
+    G4VHitsCollection *FindHitsCollection(const G4Event *aEvent, const G4String &aName) {
+        G4HCofThisEvent *HCE = aEvent->GetHCofThisEvent();
+        if (HCE == nullptr) return nullptr;
+        G4int hcID = G4SDManager::GetSDMpointer()->GetCollectionID(aName);
+        return hcID < 0 ? nullptr : HCE->GetHC(hcID);
+    }
+} // namespace
+
+AmoreSubEventManager *AmoreSubEventManager::fgInstance                            = nullptr;
+G4ThreadLocal AmoreSubEventManager::ParentContext *AmoreSubEventManager::fgParent = nullptr;
+G4ThreadLocal AmoreSubEventBundle *AmoreSubEventManager::fgCurrentSubEvent        = nullptr;
+
+AmoreSubEventManager *AmoreSubEventManager::GetInstance() {
+    if (fgInstance == nullptr) fgInstance = new AmoreSubEventManager;
+    return fgInstance;
+}
+
+AmoreSubEventManager::AmoreSubEventManager()
+    : fEnabled(false), fWorkerSupport(false), fThreshold(100000), fBundleSize(1000),
+      fMaxBundles(kMaxBundlesLimit), fActiveParents(0) {
+    // The commands only touch the shared settings, so they are not broadcast to the workers.
+    fSubEventDir = new G4UIdirectory("/event/subEvent/", false);
+    fSubEventDir->SetGuidance("Track the secondaries of huge events on other worker threads.");
+
+    fEnableCmd = new G4UIcommand("/event/subEvent/enable", this);
+    fEnableCmd->SetGuidance("Enable/disable the sub-event mode.");
+    fEnableCmd->SetGuidance("It needs the MT run manager backend (--runmanager mt).");
+    fEnableCmd->SetGuidance("Random number sequences of sub-events are not reproducible.");
+    fEnableCmd->SetParameter(new G4UIparameter("enable", 'b', false));
+    fEnableCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fEnableCmd->SetToBeBroadcasted(false);
+
+    fThresholdCmd = new G4UIcommand("/event/subEvent/threshold", this);
+    fThresholdCmd->SetGuidance("Number of non-optical tracks an event tracks by itself");
+    fThresholdCmd->SetGuidance("before further secondaries are moved to sub-events.");
+    G4UIparameter *thresholdParam = new G4UIparameter("nTracks", 'i', false);
+    thresholdParam->SetParameterRange("nTracks > 0");
+    fThresholdCmd->SetParameter(thresholdParam);
+    fThresholdCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fThresholdCmd->SetToBeBroadcasted(false);
+
+    fBundleSizeCmd = new G4UIcommand("/event/subEvent/bundleSize", this);
+    fBundleSizeCmd->SetGuidance("Number of secondaries packed into one sub-event.");
+    G4UIparameter *bundleSizeParam = new G4UIparameter("nTracks", 'i', false);
+    bundleSizeParam->SetParameterRange("nTracks > 0");
+    fBundleSizeCmd->SetParameter(bundleSizeParam);
+    fBundleSizeCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fBundleSizeCmd->SetToBeBroadcasted(false);
+
+    fMaxBundlesCmd = new G4UIcommand("/event/subEvent/maxBundles", this);
+    fMaxBundlesCmd->SetGuidance("Maximum number of sub-events of one event.");
+    fMaxBundlesCmd->SetGuidance("Secondaries beyond that stay on the stack of the event.");
+    G4UIparameter *maxBundlesParam = new G4UIparameter("nBundles", 'i', false);
+    maxBundlesParam->SetParameterRange("nBundles > 0 && nBundles <= 200");
+    fMaxBundlesCmd->SetParameter(maxBundlesParam);
+    fMaxBundlesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+    fMaxBundlesCmd->SetToBeBroadcasted(false);
+}
+
+AmoreSubEventManager::~AmoreSubEventManager() {
+    delete fEnableCmd;
+    delete fThresholdCmd;
+    delete fBundleSizeCmd;
+    delete fMaxBundlesCmd;
+    delete fSubEventDir;
+    fgInstance = nullptr;
+}
+
+void AmoreSubEventManager::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == fEnableCmd) {
+        G4bool enable = StoB(newValue);
+        if (enable && !fWorkerSupport) {
+            G4Exception(__PRETTY_FUNCTION__, "SUBEVT_NOT_SUPPORTED", JustWarning,
+                        "Sub-events need the MT run manager backend. Sub-event mode stays "
+                        "disabled.");
+            enable = false;
+        }
+        fEnabled = enable;
+    } else if (command == fThresholdCmd) {
+        fThreshold = StoI(newValue);
+    } else if (command == fBundleSizeCmd) {
+        fBundleSize = StoI(newValue);
+    } else if (command == fMaxBundlesCmd) {
+        fMaxBundles = std::min<G4int>(StoI(newValue), kMaxBundlesLimit);
+    }
+}
+
+G4String AmoreSubEventManager::GetCurrentValue(G4UIcommand *command) {
+    if (command == fEnableCmd) {
+        return BtoS(fEnabled);
+    } else if (command == fThresholdCmd) {
+        return ItoS(fThreshold);
+    } else if (command == fBundleSizeCmd) {
+        return ItoS(fBundleSize);
+    } else if (command == fMaxBundlesCmd) {
+        return ItoS(fMaxBundles);
+    }
+    return G4String();
+}
+
+AmoreSubEventManager::ParentContext &AmoreSubEventManager::GetParentContext() {
+    if (fgParent == nullptr) {
+        fgParent          = new ParentContext;
+        fgParent->fActive = false;
+    }
+    return *fgParent;
+}
+
+void AmoreSubEventManager::BeginParentEvent(const G4Event *aEvent) {
+    ParentContext &nowContext = GetParentContext();
+    nowContext.fActive        = fEnabled && fgCurrentSubEvent == nullptr;
+    if (!nowContext.fActive) return;
+
+    nowContext.fEventID = aEvent->GetEventID();
+    std::lock_guard<std::mutex> lock(fMutex);
+    fActiveParents++;
+}
+
+G4bool AmoreSubEventManager::Offload(const G4Track *aTrack) {
+    ParentContext &nowContext = GetParentContext();
+    if (!nowContext.fActive) return false;
+
+    if (nowContext.fOpenBundle == nullptr) {
+        if (static_cast<G4int>(nowContext.fBundles.size()) >= fMaxBundles) return false;
+        auto newBundle            = std::make_shared<AmoreSubEventBundle>();
+        newBundle->fState         = AmoreSubEventBundle::kOpen;
+        newBundle->fParentEventID = nowContext.fEventID;
+        newBundle->fTrackIDOffset = kTrackIDBase + nowContext.fBundles.size() * kTrackIDStride;
+        newBundle->fTracks.reserve(fBundleSize);
+        nowContext.fBundles.push_back(newBundle);
+        nowContext.fOpenBundle = newBundle;
+    }
+
+    const AmoreTrackInformation *trackInfo =
+        static_cast<const AmoreTrackInformation *>(aTrack->GetUserInformation());
+
+    AmoreSubEventTrack nowTrack;
+    nowTrack.fDefinition        = aTrack->GetDefinition();
+    nowTrack.fMotherDefinition  = trackInfo ? trackInfo->GetParentDefinition() : nullptr;
+    nowTrack.fPosition          = aTrack->GetPosition();
+    nowTrack.fMomentumDirection = aTrack->GetMomentumDirection();
+    nowTrack.fPolarization      = aTrack->GetPolarization();
+    nowTrack.fKineticEnergy     = aTrack->GetKineticEnergy();
+    nowTrack.fGlobalTime        = aTrack->GetGlobalTime();
+    nowTrack.fWeight            = aTrack->GetWeight();
+    nowTrack.fTrackID           = aTrack->GetTrackID();
+    nowTrack.fParentID          = aTrack->GetParentID();
+    nowContext.fOpenBundle->fTracks.push_back(nowTrack);
+
+    if (static_cast<G4int>(nowContext.fOpenBundle->fTracks.size()) >= fBundleSize)
+        FlushOpenBundle();
+    return true;
+}
+
+void AmoreSubEventManager::FlushOpenBundle() {
+    ParentContext &nowContext = GetParentContext();
+    if (nowContext.fOpenBundle == nullptr) return;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        nowContext.fOpenBundle->fState = AmoreSubEventBundle::kPending;
+        fPending.push_back(nowContext.fOpenBundle);
+    }
+    nowContext.fOpenBundle.reset();
+    fCondition.notify_all();
+}
+
+void AmoreSubEventManager::ReclaimPending(std::vector<AmoreSubEventTrack> &aTracks) {
+    ParentContext &nowContext = GetParentContext();
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto &nowBundle : nowContext.fBundles) {
+        if (nowBundle->fState != AmoreSubEventBundle::kPending) continue;
+        fPending.erase(std::find(fPending.begin(), fPending.end(), nowBundle));
+        nowBundle->fState = AmoreSubEventBundle::kReclaimed;
+        aTracks.insert(aTracks.end(), nowBundle->fTracks.begin(), nowBundle->fTracks.end());
+        nowBundle->fTracks.clear();
+    }
+}
+
+void AmoreSubEventManager::EndParentEvent(const G4Event *aEvent,
+                                          std::vector<TTrack *> *aEndTracks) {
+    ParentContext &nowContext = GetParentContext();
+    if (!nowContext.fActive) return;
+
+    // Bundles are reclaimed by NewStage() of AmoreStackingAction, so bundles still waiting
+    // here belong to an aborted event: their tracks are dropped.
+    size_t droppedTracks = 0;
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        for (auto &nowBundle : nowContext.fBundles) {
+            if (nowBundle->fState == AmoreSubEventBundle::kPending)
+                fPending.erase(std::find(fPending.begin(), fPending.end(), nowBundle));
+            if (nowBundle->fState == AmoreSubEventBundle::kOpen ||
+                nowBundle->fState == AmoreSubEventBundle::kPending) {
+                droppedTracks += nowBundle->fTracks.size();
+                nowBundle->fState = AmoreSubEventBundle::kReclaimed;
+            }
+        }
+        fCondition.wait(lock, [&nowContext] {
+            for (auto &nowBundle : nowContext.fBundles)
+                if (nowBundle->fState == AmoreSubEventBundle::kRunning) return false;
+            return true;
+        });
+    }
+    if (droppedTracks > 0 && !aEvent->IsAborted()) {
+        G4Exception(__PRETTY_FUNCTION__, "SUBEVT_DROPPED", FatalException,
+                    (std::to_string(droppedTracks) +
+                     " offloaded tracks have not been processed in this event.")
+                        .c_str());
+    }
+
+    for (auto &nowBundle : nowContext.fBundles)
+        if (nowBundle->fState == AmoreSubEventBundle::kDone)
+            MergeResults(aEvent, *nowBundle, aEndTracks);
+
+    nowContext.fBundles.clear();
+    nowContext.fOpenBundle.reset();
+    nowContext.fActive = false;
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fActiveParents--;
+    }
+    fCondition.notify_all();
+}
+
+std::shared_ptr<AmoreSubEventBundle> AmoreSubEventManager::ClaimBundle(G4bool aWait) {
+    std::unique_lock<std::mutex> lock(fMutex);
+    // Idle threads stay around as long as some event may still hand out bundles
+    if (aWait)
+        fCondition.wait(lock, [this] { return !fPending.empty() || fActiveParents == 0; });
+    if (fPending.empty()) return nullptr;
+
+    std::shared_ptr<AmoreSubEventBundle> nowBundle = fPending.front();
+    fPending.pop_front();
+    nowBundle->fState = AmoreSubEventBundle::kRunning;
+    return nowBundle;
+}
+
+void AmoreSubEventManager::FinishSubEvent(const G4Event *aEvent,
+                                          std::vector<TTrack *> *aEndTracks) {
+    AmoreSubEventBundle *nowBundle = fgCurrentSubEvent;
+    if (nowBundle == nullptr) return;
+
+    auto *moduleHC = static_cast<AmoreModuleHitsCollection *>(
+        FindHitsCollection(aEvent, "MDSD/AmoreModuleSDColl"));
+    if (moduleHC != nullptr) {
+        nowBundle->fModuleDeposits.resize(moduleHC->GetSize());
+        for (size_t i = 0; i < moduleHC->GetSize(); i++) {
+            const AmoreModuleHit *nowHit           = (*moduleHC)[i];
+            AmoreSubEventModuleDeposit &nowDeposit = nowBundle->fModuleDeposits[i];
+            nowDeposit.fCrystalEdep                = nowHit->GetCrystalEdep();
+            nowDeposit.fCrystalQEdep               = nowHit->GetCrystalQEdep();
+            nowDeposit.fGeWaferEdep                = nowHit->GetGeWaferEdep();
+            nowDeposit.fGeWaferQEdep               = nowHit->GetGeWaferQEdep();
+            for (G4int j = 0; j < AmoreModuleHit::GetCrystalGoldFilmNum(); j++)
+                nowDeposit.fCrystalGoldFilmEdep.push_back(nowHit->GetCrystalGoldFilmEdep(j));
+            for (G4int j = 0; j < AmoreModuleHit::GetGeWaferGoldFilmNum(); j++)
+                nowDeposit.fGeWaferGoldFilmEdep.push_back(nowHit->GetGeWaferGoldFilmEdep(j));
+        }
+    }
+
+    auto *cellHC =
+        static_cast<CupScintHitsCollection *>(FindHitsCollection(aEvent, "TGSD/TGSDColl"));
+    if (cellHC != nullptr) {
+        nowBundle->fCellDeposits.resize(cellHC->entries());
+        for (G4int i = 0; i < cellHC->entries(); i++) {
+            CupScintHit *nowHit = (*cellHC)[i];
+            nowBundle->fCellDeposits[i] = {nowHit->GetLogV(), nowHit->GetEdep(),
+                                           nowHit->GetEdepQuenched()};
+        }
+    }
+
+    // Primaries of the sub-event get back the IDs they had in the parent event
+    const G4int nPrimaries = nowBundle->fTracks.size();
+    auto toParentTrackID   = [&](G4int aLocalID) {
+        if (aLocalID <= 0) return aLocalID;
+        if (aLocalID <= nPrimaries) return nowBundle->fTracks[aLocalID - 1].fTrackID;
+        return nowBundle->fTrackIDOffset + aLocalID;
+    };
+    for (auto nowTrack : *aEndTracks) {
+        G4int localID  = nowTrack->GetTrackID();
+        G4int parentID = nowTrack->GetParentID();
+        nowTrack->SetParentID(parentID == 0 && localID <= nPrimaries
+                                  ? nowBundle->fTracks[localID - 1].fParentID
+                                  : toParentTrackID(parentID));
+        nowTrack->SetTrackID(toParentTrackID(localID));
+    }
+    nowBundle->fEndTracks.swap(*aEndTracks);
+    aEndTracks->clear();
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        nowBundle->fState  = AmoreSubEventBundle::kDone;
+        fgCurrentSubEvent = nullptr;
+    }
+    fCondition.notify_all();
+}
+
+void AmoreSubEventManager::MergeResults(const G4Event *aEvent, AmoreSubEventBundle &aBundle,
+                                        std::vector<TTrack *> *aEndTracks) {
+    auto *moduleHC = static_cast<AmoreModuleHitsCollection *>(
+        FindHitsCollection(aEvent, "MDSD/AmoreModuleSDColl"));
+    if (moduleHC != nullptr) {
+        size_t nModules = std::min(moduleHC->GetSize(), aBundle.fModuleDeposits.size());
+        for (size_t i = 0; i < nModules; i++) {
+            AmoreModuleHit *nowHit                       = (*moduleHC)[i];
+            const AmoreSubEventModuleDeposit &nowDeposit = aBundle.fModuleDeposits[i];
+            nowHit->AddCrystalEdep(nowDeposit.fCrystalEdep);
+            nowHit->AddCrystalQEdep(nowDeposit.fCrystalQEdep);
+            nowHit->AddGeWaferEdep(nowDeposit.fGeWaferEdep);
+            nowHit->AddGeWaferQEdep(nowDeposit.fGeWaferQEdep);
+            for (size_t j = 0; j < nowDeposit.fCrystalGoldFilmEdep.size(); j++)
+                nowHit->AddCrystalGoldFilmEdep(j, nowDeposit.fCrystalGoldFilmEdep[j]);
+            for (size_t j = 0; j < nowDeposit.fGeWaferGoldFilmEdep.size(); j++)
+                nowHit->AddGeWaferGoldFilmEdep(j, nowDeposit.fGeWaferGoldFilmEdep[j]);
+        }
+    }
+
+    auto *cellHC =
+        static_cast<CupScintHitsCollection *>(FindHitsCollection(aEvent, "TGSD/TGSDColl"));
+    if (cellHC != nullptr) {
+        size_t nCells = std::min<size_t>(cellHC->entries(), aBundle.fCellDeposits.size());
+        for (size_t i = 0; i < nCells; i++) {
+            const AmoreSubEventCellDeposit &nowDeposit = aBundle.fCellDeposits[i];
+            if (nowDeposit.fEdep == 0. && nowDeposit.fEdepQuenched == 0.) continue;
+            CupScintHit *nowHit = (*cellHC)[i];
+            if (!(nowHit->GetLogV()) && nowDeposit.fLogV != nullptr)
+                nowHit->SetLogV(const_cast<G4LogicalVolume *>(nowDeposit.fLogV));
+            nowHit->AddEdep(nowDeposit.fEdep);
+            nowHit->AddEdepQuenched(nowDeposit.fEdepQuenched);
+        }
+    }
+
+    // The parent recorder takes over the EndTrack records
+    aEndTracks->insert(aEndTracks->end(), aBundle.fEndTracks.begin(), aBundle.fEndTracks.end());
+    aBundle.fEndTracks.clear();
+}
@@ -1,4 +1,5 @@
 #include "G4EventManager.hh"
+#include "G4OpticalPhoton.hh"
 #include "G4ParticleTypes.hh"
 #include "G4Track.hh"
 #include "G4TrackingManager.hh"
@@ -10,12 +11,13 @@
 #include "G4Trajectory.hh"
 
 AmoreTrackingAction::AmoreTrackingAction(AmoreRootNtuple *r)
-    : tracknum(0), CupTrackingAction(r), recorder(r) {}
+    : tracknum(0), CupTrackingAction(r), recorder(r),
+      fOpticalPhoton(G4OpticalPhoton::Definition()) {}
 
 void AmoreTrackingAction::PreUserTrackingAction(const G4Track *aTrack) {
     if (aTrack->GetTrackID() == 1)
         tracknum = 0;
-    else if (aTrack->GetDefinition()->GetParticleName() != "opticalphoton")
+    else if (aTrack->GetDefinition() != fOpticalPhoton)
         tracknum++;
 
     if (aTrack->GetParentID() != 0) {
@@ -30,7 +32,7 @@ void AmoreTrackingAction::PreUserTrackingAction(const G4Track *aTrack) {
 void AmoreTrackingAction::PostUserTrackingAction(const G4Track *aTrack) {
     CupTrackingAction::PostUserTrackingAction(aTrack);
 
-    if (aTrack->GetDefinition()->GetParticleName() == "opticalphoton")
+    if (aTrack->GetDefinition() == fOpticalPhoton)
         return;
     else if (recorder)
         recorder->RecordET(aTrack);
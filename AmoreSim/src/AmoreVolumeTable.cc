@@ -0,0 +1,238 @@
+#include "AmoreSim/AmoreVolumeTable.hh"
+#include "AmoreSim/AmoreDetectorConstruction.hh"
+
+#include "G4LogicalVolume.hh"
+#include "G4Navigator.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4Region.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4TransportationManager.hh"
+#include "G4VPhysicalVolume.hh"
+
+#include "TFile.h"
+#include "TTree.h"
+
+namespace {
+    const char *kVolumeTableName = "VolumeTable";
+}
+
+// Names and placements are inspected here once, so that a step only needs a pointer lookup
+void AmoreVolumeTable::Build(const AmoreDetectorConstruction *aDetCons) {
+    using eDetGeometry          = AmoreDetectorConstruction::eDetGeometry;
+    eDetGeometry nowGeometry    = AmoreDetectorConstruction::GetDetGeometryType();
+    G4PhysicalVolumeStore *pvStore = G4PhysicalVolumeStore::GetInstance();
+    const G4VPhysicalVolume *worldPV = G4TransportationManager::GetTransportationManager()
+                                           ->GetNavigatorForTracking()
+                                           ->GetWorldVolume();
+    const G4LogicalVolume *worldLV = worldPV->GetLogicalVolume();
+
+    fDetCons  = aDetCons;
+    fCavernPV = aDetCons->GetCavernPV();
+    fOVCPV    = aDetCons->GetOVCPV();
+    fIDs.clear();
+    fNameIDs.clear();
+    fVolumes.assign(pvStore->begin(), pvStore->end());
+    fEntries.assign(fVolumes.size(), Entry());
+
+    for (size_t i = 0; i < fVolumes.size(); i++) {
+        const G4VPhysicalVolume *nowPV = fVolumes[i];
+        const G4LogicalVolume *nowLV   = nowPV->GetLogicalVolume();
+        const G4String &nowName        = nowPV->GetName();
+        Entry &nowEntry                = fEntries[i];
+        fIDs[nowPV]                    = i;
+
+        nowEntry.fID         = i;
+        nowEntry.fNameID     = fNameIDs.emplace(nowName, fNameIDs.size()).first->second;
+        nowEntry.fModuleID   = -1;
+        nowEntry.fFlags      = 0;
+        nowEntry.fCopyFrom   = kOwnCopy;
+        nowEntry.fCopyLevel  = 0;
+        nowEntry.fCopyNameAt = G4String::npos;
+
+        if (nowLV->GetSensitiveDetector() != nullptr) nowEntry.fFlags |= kSensitive;
+        G4Region *nowRegion = nowLV->GetRegion();
+        if (nowRegion == nullptr || *nowRegion->GetRootLogicalVolumeIterator() == worldLV) {
+            nowEntry.fFlags |= kWorldRegion;
+            continue;
+        }
+
+        if (nowGeometry == eDetGeometry::kDetector_AMoRE200 && nowName == "physCMOCell") {
+            nowEntry.fCopyFrom  = kMotherCopy;
+            nowEntry.fCopyLevel = 1;
+        } else if (nowGeometry == eDetGeometry::kDetector_AMoRE_I) {
+            nowEntry.fCopyNameAt = nowName.find("_Crystal_PV");
+            if (nowEntry.fCopyNameAt != G4String::npos) {
+                nowEntry.fCopyFrom  = kEnvelopeCopy;
+                nowEntry.fCopyLevel = -1;
+            }
+        }
+    }
+
+    for (const auto &nowSDInfo : aDetCons->GetModuleSDInfoList()) {
+        Entry *moduleEntry = Find(nowSDInfo.fModulePV);
+        if (moduleEntry == nullptr) continue;
+        moduleEntry->fFlags |= kModule;
+        moduleEntry->fModuleID = nowSDInfo.fModuleID;
+        std::set<const G4LogicalVolume *> done;
+        MarkModule(nowSDInfo.fModulePV->GetLogicalVolume(), nowSDInfo.fModuleID, done);
+    }
+    for (auto &nowEntry : fEntries)
+        if (nowEntry.fModuleID == -2) nowEntry.fModuleID = -1;
+
+    auto markBorder = [&](const G4VPhysicalVolume *aBorderPV, G4int aInsideFlag,
+                          G4int aAmbiguousFlag) {
+        Entry *borderEntry = Find(aBorderPV);
+        if (borderEntry == nullptr) return;
+        borderEntry->fFlags |= aInsideFlag;
+        std::set<const G4LogicalVolume *> insideDone, outsideDone;
+        MarkInside(aBorderPV->GetLogicalVolume(), aInsideFlag, insideDone);
+        MarkOutside(worldLV, aBorderPV, aInsideFlag, aAmbiguousFlag, outsideDone);
+    };
+    markBorder(fCavernPV, kInsideCavern, kCavernAmbiguous);
+    markBorder(fOVCPV, kInsideOVC, kOVCAmbiguous);
+}
+
+void AmoreVolumeTable::MarkInside(const G4LogicalVolume *aLV, G4int aFlag,
+                                  std::set<const G4LogicalVolume *> &aDone) {
+    if (!aDone.insert(aLV).second) return;
+    for (size_t i = 0; i < aLV->GetNoDaughters(); i++) {
+        G4VPhysicalVolume *nowDaughter = aLV->GetDaughter(i);
+        Entry *nowEntry                = Find(nowDaughter);
+        if (nowEntry != nullptr) nowEntry->fFlags |= aFlag;
+        MarkInside(nowDaughter->GetLogicalVolume(), aFlag, aDone);
+    }
+}
+
+// A volume reached from the world without passing the border but also marked as inside is
+// placed on both sides. The steps in it are judged with the navigation history instead.
+void AmoreVolumeTable::MarkOutside(const G4LogicalVolume *aLV,
+                                   const G4VPhysicalVolume *aBorderPV, G4int aInsideFlag,
+                                   G4int aAmbiguousFlag,
+                                   std::set<const G4LogicalVolume *> &aDone) {
+    if (!aDone.insert(aLV).second) return;
+    for (size_t i = 0; i < aLV->GetNoDaughters(); i++) {
+        G4VPhysicalVolume *nowDaughter = aLV->GetDaughter(i);
+        if (nowDaughter == aBorderPV) continue;
+        Entry *nowEntry = Find(nowDaughter);
+        if (nowEntry != nullptr && (nowEntry->fFlags & aInsideFlag))
+            nowEntry->fFlags |= aAmbiguousFlag;
+        MarkOutside(nowDaughter->GetLogicalVolume(), aBorderPV, aInsideFlag, aAmbiguousFlag,
+                    aDone);
+    }
+}
+
+// Volumes placed in more than one module get -2 here, which becomes -1 at the end of Build()
+void AmoreVolumeTable::MarkModule(const G4LogicalVolume *aLV, G4int aModuleID,
+                                  std::set<const G4LogicalVolume *> &aDone) {
+    if (!aDone.insert(aLV).second) return;
+    for (size_t i = 0; i < aLV->GetNoDaughters(); i++) {
+        G4VPhysicalVolume *nowDaughter = aLV->GetDaughter(i);
+        Entry *nowEntry                = Find(nowDaughter);
+        if (nowEntry != nullptr) {
+            if (nowEntry->fModuleID == -1)
+                nowEntry->fModuleID = aModuleID;
+            else if (nowEntry->fModuleID != aModuleID)
+                nowEntry->fModuleID = -2;
+        }
+        MarkModule(nowDaughter->GetLogicalVolume(), aModuleID, aDone);
+    }
+}
+
+// The level of the envelope is found at the first step in the volume and kept, since the
+// volume is always placed at the same depth below its envelope.
+G4int AmoreVolumeTable::GetCopyNo(Entry &aEntry, const G4TouchableHandle &aTouchable) {
+    if (aEntry.fCopyLevel < 0) {
+        for (G4int i = 1; i <= aTouchable->GetHistoryDepth(); i++) {
+            G4VPhysicalVolume *nowMother = aTouchable->GetVolume(i);
+            if (nowMother->GetLogicalVolume()->IsRootRegion()) {
+                if (nowMother->GetMotherLogical() == nullptr) { // Reached the end of the world
+                    G4Exception(__PRETTY_FUNCTION__, "MDSD_REGION_FAIL", FatalException,
+                                "Finding a root region for SD has been failed.");
+                }
+                aEntry.fCopyLevel = i;
+                break;
+            }
+        }
+    }
+    return aTouchable->GetCopyNumber(aEntry.fCopyLevel);
+}
+
+G4String AmoreVolumeTable::GetStepVolumeName(const G4VPhysicalVolume *aVolume,
+                                             const G4TouchableHandle &aTouchable) {
+    G4String stepName = aVolume->GetName();
+    Entry *theEntry   = Find(aVolume);
+    if (theEntry == nullptr) return stepName;
+    switch (theEntry->fCopyFrom) {
+        case kMotherCopy:
+            stepName += std::to_string(GetCopyNo(*theEntry, aTouchable));
+            break;
+        case kEnvelopeCopy:
+            stepName.insert(theEntry->fCopyNameAt,
+                            "_" + std::to_string(GetCopyNo(*theEntry, aTouchable)));
+            break;
+        default:
+            break;
+    }
+    return stepName;
+}
+
+// A step enters a volume only when it ends on a geometry boundary
+G4bool AmoreVolumeTable::EntersBorder(const G4Step *aStep, const G4VPhysicalVolume *aBorderPV,
+                                      G4int aInsideFlag, G4int aAmbiguousFlag) {
+    if (aBorderPV == nullptr || aStep->GetPostStepPoint()->GetStepStatus() != fGeomBoundary)
+        return false;
+    const G4VPhysicalVolume *postPV = aStep->GetPostStepPoint()->GetTouchableHandle()->GetVolume();
+    if (postPV == nullptr) return false;
+    const Entry *preEntry  = Find(aStep->GetPreStepPoint()->GetTouchableHandle()->GetVolume());
+    const Entry *postEntry = Find(postPV);
+    if (preEntry == nullptr || postEntry == nullptr ||
+        ((preEntry->fFlags | postEntry->fFlags) & aAmbiguousFlag))
+        return fDetCons->JudgeBorderIncident(aStep, &aBorderPV);
+    return !(preEntry->fFlags & aInsideFlag) && (postEntry->fFlags & aInsideFlag);
+}
+
+void AmoreVolumeTable::Write() const {
+    Int_t id = 0, nameID = 0, moduleID = 0, flags = 0, copyFrom = 0;
+    std::string name;
+    TTree *tree = new TTree(kVolumeTableName, "Physical volumes of the step records");
+    tree->Branch("ID", &id, "ID/I");
+    tree->Branch("Name", &name);
+    tree->Branch("NameID", &nameID, "NameID/I");
+    tree->Branch("ModuleID", &moduleID, "ModuleID/I");
+    tree->Branch("Flags", &flags, "Flags/I");
+    tree->Branch("CopyFrom", &copyFrom, "CopyFrom/I");
+    for (const auto &nowEntry : fEntries) {
+        id       = nowEntry.fID;
+        name     = fVolumes[nowEntry.fID]->GetName();
+        nameID   = nowEntry.fNameID;
+        moduleID = nowEntry.fModuleID;
+        flags    = nowEntry.fFlags;
+        copyFrom = nowEntry.fCopyFrom;
+        tree->Fill();
+    }
+    tree->Write();
+    delete tree;
+}
+
+// Every part was written from the same geometry, so the merged tree is the same table
+// repeated once per part.
+G4bool AmoreVolumeTable::Deduplicate(const G4String &aFileName) {
+    TFile theFile(aFileName.c_str(), "UPDATE");
+    if (theFile.IsZombie()) return false;
+    TTree *theTree = dynamic_cast<TTree *>(theFile.Get(kVolumeTableName));
+    if (theTree != nullptr) {
+        Long64_t nVolumes = static_cast<Long64_t>(theTree->GetMaximum("ID")) + 1;
+        if (theTree->GetEntries() > nVolumes) {
+            theFile.cd();
+            TTree *firstTable = theTree->CopyTree("", "", nVolumes, 0);
+            firstTable->SetDirectory(nullptr);
+            theFile.Delete((G4String(kVolumeTableName) + ";*").c_str());
+            firstTable->SetDirectory(&theFile);
+            firstTable->Write();
+            delete firstTable;
+        }
+    }
+    theFile.Close();
+    return true;
+}
@@ -0,0 +1,62 @@
+#include "AmoreSim/AmoreWorkerRunManager.hh"
+
+#if G4VERSION_NUMBER >= 1000
+
+#include "AmoreSim/AmoreSubEventManager.hh"
+
+#include "G4Event.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+
+AmoreWorkerRunManager::AmoreWorkerRunManager() : G4WorkerRunManager(), fMasterEventsDone(false) {}
+
+void AmoreWorkerRunManager::DoEventLoop(G4int n_event, const char *macroFile, G4int n_select) {
+    fMasterEventsDone = false;
+    G4WorkerRunManager::DoEventLoop(n_event, macroFile, n_select);
+}
+
+G4Event *AmoreWorkerRunManager::GenerateEvent(G4int i_event) {
+    AmoreSubEventManager *subEventManager = AmoreSubEventManager::GetInstance();
+    if (!subEventManager->IsEnabled()) return G4WorkerRunManager::GenerateEvent(i_event);
+
+    // Waiting sub-events go first since their parent events cannot finish without them
+    fSubEvent = subEventManager->ClaimBundle(false);
+    if (fSubEvent == nullptr && !fMasterEventsDone) {
+        G4Event *anEvent = G4WorkerRunManager::GenerateEvent(i_event);
+        if (anEvent != nullptr) return anEvent;
+        fMasterEventsDone = true;
+    }
+    if (fSubEvent == nullptr && !runAborted) fSubEvent = subEventManager->ClaimBundle(true);
+
+    eventLoopOnGoing = (fSubEvent != nullptr);
+    return eventLoopOnGoing ? BuildSubEvent() : nullptr;
+}
+
+void AmoreWorkerRunManager::AnalyzeEvent(G4Event *anEvent) {
+    if (fSubEvent != nullptr) {
+        fSubEvent.reset();
+        return;
+    }
+    G4WorkerRunManager::AnalyzeEvent(anEvent);
+}
+
+G4Event *AmoreWorkerRunManager::BuildSubEvent() {
+    // The sub-event carries the ID of its parent, so the records of both can be matched.
+    // Its random numbers continue from the engine state of this thread.
+    G4Event *anEvent = new G4Event(fSubEvent->fParentEventID);
+    for (const auto &nowTrack : fSubEvent->fTracks) {
+        G4PrimaryParticle *nowParticle = new G4PrimaryParticle(nowTrack.fDefinition);
+        nowParticle->SetKineticEnergy(nowTrack.fKineticEnergy);
+        nowParticle->SetMomentumDirection(nowTrack.fMomentumDirection);
+        nowParticle->SetPolarization(nowTrack.fPolarization);
+        nowParticle->SetWeight(nowTrack.fWeight);
+
+        G4PrimaryVertex *nowVertex = new G4PrimaryVertex(nowTrack.fPosition, nowTrack.fGlobalTime);
+        nowVertex->SetPrimary(nowParticle);
+        anEvent->AddPrimaryVertex(nowVertex);
+    }
+    AmoreSubEventManager::SetCurrentSubEvent(fSubEvent.get());
+    return anEvent;
+}
+
+#endif
@@ -1150,7 +1150,7 @@ void AmoreDetectorConstruction::ConstructAMoRE10() {
 
     G4Region *PmtRegion = new G4Region("MLCS");
     PmtRegion->AddRootLogicalVolume(logiGeWafer);
-    CupPMTOpticalModel *pmtOpticalModel = new CupPMTOpticalModel("MLCS_optical_model", physGeWafer);
+    AddPMTOpticalModel("MLCS_optical_model", physGeWafer);
 
   // EJ added
   //////////////////////////////
@@ -1,6 +1,7 @@
 #include "globals.hh"
 
 #include "AmoreSim/AmoreDetectorConstruction.hh" // the DetectorConstruction class header
+#include "AmoreSim/AmoreStartupProfiler.hh"
 #include "CupSim/CupPMTSD.hh"
 #include "CupSim/CupParam.hh"
 #include "CupSim/CupScintSD.hh"            // for making sensitive photocathodes
@@ -45,9 +46,14 @@
 // uses parameters from database or file
 void AmoreDetectorConstruction::ConstructAMoRE200() {
     // --- put in the Inner Detector tanks, PMTs, and details
-    G4LogicalVolume* odLV = ConstructAMoRE200_OD();
+    G4LogicalVolume *odLV;
+    {
+        AmoreStartupProfiler::Scope nowScope("ConstructAMoRE200_OD");
+        odLV = ConstructAMoRE200_OD();
+    }
 
     // --- put in the Inner Detector tanks, PMTs, and details
+    AmoreStartupProfiler::Scope nowScope("ConstructAMoRE200_ID");
     ConstructAMoRE200_ID(odLV);
 }
 
@@ -3894,7 +3894,7 @@ void AmoreDetectorConstruction::ConstructAMoREPilot() {
 
     G4Region *PmtRegion = new G4Region("MLCS");
     PmtRegion->AddRootLogicalVolume(logicPMT);
-    new CupPMTOpticalModel("MLCS_optical_model", physiPMT);
+    AddPMTOpticalModel("MLCS_optical_model", physiPMT);
 
     /////////////////////////////////////////////////////////////////
     //  Set Region
@@ -3182,8 +3182,7 @@ void AmoreDetectorConstruction::ConstructAMoREPilotRUN5() {
 
   G4Region *PmtRegion = new G4Region("MLCS");
   PmtRegion->AddRootLogicalVolume(logicPMT);
-  // CupPMTOpticalModel * pmtOpticalModel =
-  new CupPMTOpticalModel("MLCS_optical_model", physiPMT);
+  AddPMTOpticalModel("MLCS_optical_model", physiPMT);
 
   /////////////////////////////////////////////////////////////////
   //  Set Region
@@ -4,6 +4,7 @@
 #include "AmoreSim/AmoreDetectorStaticInfo.hh"
 #include "AmoreSim/AmoreModuleHit.hh"
 #include "AmoreSim/AmoreModuleSD.hh"
+#include "AmoreSim/AmoreStartupProfiler.hh"
 #include "CupSim/CupPMTOpticalModel.hh"    // for same PMT optical model as main sim
 #include "CupSim/CupPMTSD.hh"              // for making sensitive photocathodes
 #include "CupSim/CupVetoSD.hh"             // for making sensitive photocathodes
@@ -953,6 +954,7 @@ G4LogicalVolume *AmoreDetectorConstruction::Build_I_DetectorArray(G4int aType,
     using namespace std;
     using namespace AmoreDetectorStaticInfo;
     using namespace AmoreDetectorStaticInfo::AMoRE_I;
+    AmoreStartupProfiler::Scope nowScope("Build_I_DetectorArray");
 
     G4LogicalVolume *resultLV;
 
@@ -6026,7 +6028,7 @@ G4LogicalVolume *AmoreDetectorConstruction::Build_I_MuonVetoPMT(G4Material *aShi
 
         G4Region *PmtRegion = new G4Region("MLCS");
         PmtRegion->AddRootLogicalVolume(fI_logicPMT);
-        new CupPMTOpticalModel("MLCS_optical_model", physiPMT);
+        AddPMTOpticalModel("MLCS_optical_model", physiPMT);
     }
 
     return resultLV;
@@ -0,0 +1,498 @@
+#include "globals.hh"
+
+#include "AmoreSim/AmoreDetectorConstruction.hh" // the DetectorConstruction class header
+#include "AmoreSim/AmoreHash.hh"
+#include "CupSim/CupPMTOpticalModel.hh"
+#include "CupSim/CupParam.hh"
+
+#include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4Material.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4ProductionCuts.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4SolidStore.hh"
+#include "G4UIcommand.hh"
+#include "G4UIcommandTree.hh"
+#include "G4UImanager.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4Version.hh"
+
+#include "G4ios.hh"
+
+#ifdef AMORESIM_USE_GDML
+#include "G4GDMLParser.hh"
+#endif
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    G4String DataFilePath(const G4String &aFileName) {
+        if (getenv("AmoreDATA") != NULL) return G4String(getenv("AmoreDATA")) + "/" + aFileName;
+        return "data/" + aFileName;
+    }
+
+#ifdef AMORESIM_USE_GDML
+    // The settings file ConstructAmoreDetector() reads into CupParam for this geometry
+    G4String GeometrySettingsFile(AmoreDetectorConstruction::eDetGeometry aGeometry) {
+        switch (aGeometry) {
+            case AmoreDetectorConstruction::kDetector_AMoRE200:
+                return "settings_amore200.dat";
+            case AmoreDetectorConstruction::kDetector_AMoRE_I:
+                return "settings_amoreI.dat";
+            default:
+                return "";
+        }
+    }
+
+    const char *kGDMLFileName    = "world.gdml";
+    const char *kBindingFileName = "bindings.dat";
+    const char *kKeyFileName     = "snapshot_key.txt";
+
+    constexpr int kPilotCMOCellNum = 6; // as in ConstructAMoREPilot(RUN5)
+
+    // GDML appends the address of every object to its name, which identifies the objects
+    // of the binding table after reading.
+    std::string AddressOf(const void *aPtr) {
+        if (aPtr == nullptr) return "0";
+        std::ostringstream addrStr;
+        addrStr << aPtr;
+        return addrStr.str();
+    }
+
+    std::string AddressInName(const G4String &aName) {
+        size_t pos = aName.rfind("0x");
+        return (pos == std::string::npos) ? std::string() : aName.substr(pos);
+    }
+
+    std::string RestOf(std::istringstream &aLine) {
+        std::string rest;
+        std::getline(aLine >> std::ws, rest);
+        return rest;
+    }
+
+    G4bool IsWrittenByGDML(const G4VSolid *aSolid) {
+        static const std::set<G4String> writableTypes = {
+            "G4Box",          "G4Cons",           "G4CutTubs",         "G4DisplacedSolid",
+            "G4Ellipsoid",    "G4EllipticalCone", "G4EllipticalTube",  "G4ExtrudedSolid",
+            "G4GenericPolycone", "G4GenericTrap", "G4Hype",            "G4IntersectionSolid",
+            "G4MultiUnion",   "G4Orb",            "G4Para",            "G4Paraboloid",
+            "G4Polycone",     "G4Polyhedra",      "G4ReflectedSolid",  "G4ScaledSolid",
+            "G4Sphere",       "G4SubtractionSolid", "G4TessellatedSolid", "G4Tet",
+            "G4Torus",        "G4Trap",           "G4Trd",             "G4Tubs",
+            "G4TwistedBox",   "G4TwistedTrap",    "G4TwistedTrd",      "G4TwistedTubs",
+            "G4UnionSolid"};
+        return writableTypes.count(aSolid->GetEntityType()) > 0;
+    }
+#endif
+} // namespace
+
+void AmoreDetectorConstruction::AddPMTOpticalModel(const G4String &aName,
+                                                   G4VPhysicalVolume *aEnvelopePV) {
+    new CupPMTOpticalModel(aName, aEnvelopePV);
+    fPMTOpticalModelPVs.emplace_back(aName, aEnvelopePV);
+}
+
+G4String AmoreDetectorConstruction::MakeGeometrySnapshotKey() {
+    std::ostringstream key;
+    key << "Geant4 " << G4VERSION_NUMBER << "\n";
+    key << "Detector " << GetDetectorTypeName(whichDetector) << "\n";
+
+    // Every /detGeometry/ setting except the ones of the snapshot and the overlap check
+    G4UImanager *UImanager = G4UImanager::GetUIpointer();
+    std::function<void(G4UIcommandTree *)> addSettingsOf = [&](G4UIcommandTree *aTree) {
+        if (aTree->GetPathName() == "/detGeometry/snapshot/" ||
+            aTree->GetPathName() == "/detGeometry/overlap/")
+            return;
+        for (G4int i = 1; i <= aTree->GetCommandEntry(); i++) {
+            G4String nowPath = aTree->GetCommand(i)->GetCommandPath();
+            if (nowPath == "/detGeometry/OverlapCheck") continue;
+            key << nowPath << " " << UImanager->GetCurrentValues(nowPath) << "\n";
+        }
+        for (G4int i = 1; i <= aTree->GetTreeEntry(); i++)
+            addSettingsOf(aTree->GetTree(i));
+    };
+    G4UIcommandTree *geometryTree = UImanager->GetTree()->FindCommandTree("/detGeometry/");
+    if (geometryTree != nullptr) addSettingsOf(geometryTree);
+
+    for (const char *nowFile :
+         {"amore_materials.dat", "settings_amore200.dat", "settings_amoreI.dat"}) {
+        std::ifstream nowStream(DataFilePath(nowFile).c_str());
+        key << "File " << nowFile << "\n";
+        if (nowStream.good()) key << nowStream.rdbuf() << "\n";
+    }
+    return key.str();
+}
+
+void AmoreDetectorConstruction::CollectGeometrySnapshotSlots(
+    std::map<G4String, G4LogicalVolume **> &aLVs, std::map<G4String, G4VPhysicalVolume **> &aPVs,
+    std::map<G4String, G4int *> &aInts,
+    std::map<G4String, std::set<G4LogicalVolume *> *> &aLVSets) {
+#define AMORE_SNAPSHOT_SLOT(MAP, MEMBER) MAP[#MEMBER] = &MEMBER
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_TopScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideFBScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideLRScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_TopScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideFBScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideLRScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideFBScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_TopScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_SideLRScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_logicPMT);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_logicPMTVacu);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_logiGOLDa);
+    AMORE_SNAPSHOT_SLOT(aLVs, fPilot_logiGOLDb);
+
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_TopScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideFBScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerFBScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerLRScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideLRScint_BoxLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_TopScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideFBScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerFBScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerLRScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideLRScint_FlatTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_TopScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideFBScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerFBScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_MufflerLRScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_SideLRScint_PMTTrapLogical);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_logicPMT);
+    AMORE_SNAPSHOT_SLOT(aLVs, fI_logicPMTVacu);
+
+    AMORE_SNAPSHOT_SLOT(aLVs, f200_logiVetoPSO);
+    AMORE_SNAPSHOT_SLOT(aLVs, f200_logiVetoPSI);
+    AMORE_SNAPSHOT_SLOT(aLVs, f200_logiHatPSO);
+    AMORE_SNAPSHOT_SLOT(aLVs, f200_logiHatPSI);
+    for (int i = 0; i < 1000; i++)
+        aLVs["f200_logiCrystalCell[" + std::to_string(i) + "]"] = &f200_logiCrystalCell[i];
+    if (fPilot_logiCMOCell != nullptr) {
+        for (int i = 0; i < kPilotCMOCellNum; i++)
+            aLVs["fPilot_logiCMOCell[" + std::to_string(i) + "]"] = &fPilot_logiCMOCell[i];
+    }
+
+    AMORE_SNAPSHOT_SLOT(aPVs, fCavernPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, fRockPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, fFloorPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_physGeWafer);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_physVacDisk);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_HatVetoMaterialPV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_PSO_PV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_PSI_PV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_HatPSO_PV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_HatPSI_PV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_VetoActiveMaterialPV);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_FloorPEPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_CeilingPEPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_RealPEPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_VetoMaterialPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_AirBufferPhysical);
+    AMORE_SNAPSHOT_SLOT(aPVs, f200_OVCPhysical);
+
+    AMORE_SNAPSHOT_SLOT(aInts, f200_VetoTotCNum);
+    AMORE_SNAPSHOT_SLOT(aInts, f200_HatVetoTotCNum);
+    AMORE_SNAPSHOT_SLOT(aInts, f200_TotalVetoCNum);
+    AMORE_SNAPSHOT_SLOT(aInts, f200_TotCrystalNum);
+    AMORE_SNAPSHOT_SLOT(aInts, f200_TotTowerNum);
+    AMORE_SNAPSHOT_SLOT(aInts, fNeutShieldingConf);
+
+    AMORE_SNAPSHOT_SLOT(aLVSets, fI_CrystalLVs);
+    AMORE_SNAPSHOT_SLOT(aLVSets, fI_GeWaferLVs);
+    AMORE_SNAPSHOT_SLOT(aLVSets, fI_GeWaferGoldFilmLVs);
+    AMORE_SNAPSHOT_SLOT(aLVSets, fI_CrystalGoldFilmLVs);
+#undef AMORE_SNAPSHOT_SLOT
+}
+
+G4bool AmoreDetectorConstruction::RestoreGeometrySnapshot() {
+    fGeomSnapshotKey   = MakeGeometrySnapshotKey();
+    fGeomSnapshotEntry = fGeomSnapshotDir + "/" + AmoreHash::HexDigest(fGeomSnapshotKey);
+#ifndef AMORESIM_USE_GDML
+    G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_NOGDML", JustWarning,
+                "Geant4 has been built without GDML. The geometry snapshot is not available.");
+    fGeomSnapshotOn = false;
+    return false;
+#else
+    std::ifstream keyFile((fGeomSnapshotEntry + "/" + kKeyFileName).c_str());
+    std::ostringstream storedKey;
+    if (keyFile.good()) storedKey << keyFile.rdbuf();
+    std::ifstream bindingFile((fGeomSnapshotEntry + "/" + kBindingFileName).c_str());
+    if (!keyFile.good() || !bindingFile.good() || storedKey.str() != fGeomSnapshotKey) {
+        G4cout << "Geometry snapshot: no snapshot for this configuration. The world will be "
+                  "stored to "
+               << fGeomSnapshotEntry << G4endl;
+        return false;
+    }
+    std::vector<std::string> bindingLines;
+    for (std::string nowLine; std::getline(bindingFile, nowLine);)
+        bindingLines.push_back(nowLine);
+
+    G4GDMLParser parser;
+    parser.SetStripFlag(false);
+    parser.Read(fGeomSnapshotEntry + "/" + kGDMLFileName, false);
+    world_phys = parser.GetWorldVolume();
+    if (world_phys == nullptr) {
+        G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_READ_FAIL", JustWarning,
+                    ("Reading the geometry snapshot " + fGeomSnapshotEntry +
+                     " has been failed. The world will be built.")
+                        .c_str());
+        return false;
+    }
+
+    std::map<std::string, G4LogicalVolume *> LVOf;
+    std::map<std::string, G4VPhysicalVolume *> PVOf;
+    std::map<std::string, G4Material *> materialOf;
+    for (auto nowLV : *G4LogicalVolumeStore::GetInstance())
+        LVOf[AddressInName(nowLV->GetName())] = nowLV;
+    for (auto nowPV : *G4PhysicalVolumeStore::GetInstance())
+        PVOf[AddressInName(nowPV->GetName())] = nowPV;
+    for (auto nowMaterial : *G4Material::GetMaterialTable())
+        materialOf[AddressInName(nowMaterial->GetName())] = nowMaterial;
+    auto findLV = [&](const std::string &aAddr) -> G4LogicalVolume * {
+        auto found = LVOf.find(aAddr);
+        return (aAddr == "0" || found == LVOf.end()) ? nullptr : found->second;
+    };
+    auto findPV = [&](const std::string &aAddr) -> G4VPhysicalVolume * {
+        auto found = PVOf.find(aAddr);
+        return (aAddr == "0" || found == PVOf.end()) ? nullptr : found->second;
+    };
+    auto findMaterial = [&](const std::string &aAddr) -> G4Material * {
+        auto found = materialOf.find(aAddr);
+        return (aAddr == "0" || found == materialOf.end()) ? nullptr : found->second;
+    };
+
+    for (const auto &nowLine : bindingLines) {
+        if (nowLine.find("fPilot_logiCMOCell") == std::string::npos) continue;
+        if (fPilot_logiCMOCell == nullptr)
+            fPilot_logiCMOCell = new G4LogicalVolume *[kPilotCMOCellNum]();
+        break;
+    }
+    std::map<G4String, G4LogicalVolume **> LVSlots;
+    std::map<G4String, G4VPhysicalVolume **> PVSlots;
+    std::map<G4String, G4int *> intSlots;
+    std::map<G4String, std::set<G4LogicalVolume *> *> LVSetSlots;
+    CollectGeometrySnapshotSlots(LVSlots, PVSlots, intSlots, LVSetSlots);
+    for (auto &nowSlot : LVSlots)
+        *nowSlot.second = nullptr;
+    for (auto &nowSlot : PVSlots)
+        *nowSlot.second = nullptr;
+    for (auto &nowSlot : LVSetSlots)
+        nowSlot.second->clear();
+    fModuleSDInfos.clear();
+    fPMTOpticalModelPVs.clear();
+
+    for (const auto &nowLine : bindingLines) {
+        std::istringstream nowStream(nowLine);
+        std::string tag, slot, addr;
+        nowStream >> tag;
+        if (tag == "name") {
+            // GDML drops some characters of the names, so the original ones are set back
+            std::string kind;
+            nowStream >> kind >> addr;
+            G4String originalName = RestOf(nowStream);
+            if (kind == "lv" && findLV(addr) != nullptr)
+                findLV(addr)->SetName(originalName);
+            else if (kind == "pv" && findPV(addr) != nullptr)
+                findPV(addr)->SetName(originalName);
+            else if (kind == "material" && findMaterial(addr) != nullptr)
+                findMaterial(addr)->SetName(originalName);
+        } else if (tag == "lv") {
+            nowStream >> slot >> addr;
+            if (LVSlots.count(slot)) *LVSlots[slot] = findLV(addr);
+        } else if (tag == "pv") {
+            nowStream >> slot >> addr;
+            if (PVSlots.count(slot)) *PVSlots[slot] = findPV(addr);
+        } else if (tag == "int") {
+            G4int value = 0;
+            nowStream >> slot >> value;
+            if (intSlots.count(slot)) *intSlots[slot] = value;
+        } else if (tag == "lvset") {
+            nowStream >> slot >> addr;
+            if (LVSetSlots.count(slot) && findLV(addr) != nullptr)
+                LVSetSlots[slot]->insert(findLV(addr));
+        } else if (tag == "module") {
+            AmoreModuleSDInfo nowInfo;
+            std::string PVAddr, crystalAddr, waferAddr, crystalFilmAddr, waferFilmAddr;
+            nowStream >> nowInfo.fModuleID >> nowInfo.fCrystalPosIdx[0] >>
+                nowInfo.fCrystalPosIdx[1] >> PVAddr >> crystalAddr >> waferAddr >>
+                crystalFilmAddr >> waferFilmAddr;
+            nowInfo.fModuleName        = RestOf(nowStream);
+            nowInfo.fModulePV          = findPV(PVAddr);
+            nowInfo.fCrystalLV         = findLV(crystalAddr);
+            nowInfo.fGeWaferLV         = findLV(waferAddr);
+            nowInfo.fCrystalGoldFilmLV = findLV(crystalFilmAddr);
+            nowInfo.fGeWaferGoldFilmLV = findLV(waferFilmAddr);
+            fModuleSDInfos.insert(nowInfo);
+        } else if (tag == "birks") {
+            G4double birksConstant = 0;
+            nowStream >> addr >> birksConstant;
+            if (findMaterial(addr) != nullptr)
+                findMaterial(addr)->GetIonisation()->SetBirksConstant(birksConstant);
+        } else if (tag == "region") {
+            G4int hasCuts = 0;
+            G4double cuts[NumberOfG4CutIndex];
+            nowStream >> hasCuts;
+            for (G4int i = 0; i < NumberOfG4CutIndex; i++)
+                nowStream >> cuts[i];
+            G4String regionName = RestOf(nowStream);
+            G4Region *nowRegion = G4RegionStore::GetInstance()->GetRegion(regionName, false);
+            if (nowRegion == nullptr) nowRegion = new G4Region(regionName);
+            if (hasCuts) {
+                G4ProductionCuts *nowCuts = new G4ProductionCuts;
+                for (G4int i = 0; i < NumberOfG4CutIndex; i++)
+                    nowCuts->SetProductionCut(cuts[i], i);
+                nowRegion->SetProductionCuts(nowCuts);
+            }
+        } else if (tag == "regionroot") {
+            nowStream >> addr;
+            G4Region *nowRegion = G4RegionStore::GetInstance()->GetRegion(RestOf(nowStream), false);
+            if (nowRegion != nullptr && findLV(addr) != nullptr)
+                nowRegion->AddRootLogicalVolume(findLV(addr));
+        } else if (tag == "regionslot") {
+            nowStream >> slot;
+            G4Region *nowRegion = G4RegionStore::GetInstance()->GetRegion(RestOf(nowStream), false);
+            if (slot == "fI_DetectorModuleRegion") fI_DetectorModuleRegion = nowRegion;
+            if (slot == "fI_crystalsRegion") fI_crystalsRegion = nowRegion;
+        } else if (tag == "pmtmodel") {
+            nowStream >> addr;
+            G4String modelName = RestOf(nowStream);
+            if (findPV(addr) != nullptr) AddPMTOpticalModel(modelName, findPV(addr));
+        }
+    }
+    // Elements, solids and surfaces only lose the addresses
+    parser.StripNames();
+
+    G4String settingsFile = GeometrySettingsFile(whichDetGeometry);
+    if (settingsFile.length() > 0) CupParam::GetDB().ReadFile(DataFilePath(settingsFile).c_str());
+
+    G4cout << "Geometry snapshot: the world has been restored from " << fGeomSnapshotEntry
+           << G4endl;
+    return true;
+#endif
+}
+
+// The snapshot is written to a temporary directory which is renamed at the end, so that jobs
+// running at the same time never see a half-written one.
+void AmoreDetectorConstruction::StoreGeometrySnapshot() {
+#ifdef AMORESIM_USE_GDML
+    for (auto nowSolid : *G4SolidStore::GetInstance()) {
+        if (IsWrittenByGDML(nowSolid)) continue;
+        G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_UNSUPPORTED", JustWarning,
+                    ("Solid " + nowSolid->GetName() + " of type " + nowSolid->GetEntityType() +
+                     " cannot be written to GDML. No geometry snapshot has been stored.")
+                        .c_str());
+        return;
+    }
+    for (auto nowPV : *G4PhysicalVolumeStore::GetInstance()) {
+        if (!nowPV->IsParameterised()) continue;
+        G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_UNSUPPORTED", JustWarning,
+                    ("Parameterised volume " + nowPV->GetName() +
+                     " cannot be restored. No geometry snapshot has been stored.")
+                        .c_str());
+        return;
+    }
+
+    G4String tempDir = fGeomSnapshotEntry + ".tmp" + std::to_string(getpid());
+    std::error_code fsError;
+    fs::remove_all(tempDir, fsError);
+    fs::create_directories(tempDir, fsError);
+    if (fsError) {
+        G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_STORE_FAIL", JustWarning,
+                    ("Directory " + tempDir + " cannot be created.").c_str());
+        return;
+    }
+
+    G4GDMLParser parser;
+    parser.Write(tempDir + "/" + kGDMLFileName, world_phys, true);
+
+    std::ofstream bindings((tempDir + "/" + kBindingFileName).c_str());
+    bindings << std::setprecision(17);
+    for (auto nowLV : *G4LogicalVolumeStore::GetInstance())
+        bindings << "name lv " << AddressOf(nowLV) << " " << nowLV->GetName() << "\n";
+    for (auto nowPV : *G4PhysicalVolumeStore::GetInstance())
+        bindings << "name pv " << AddressOf(nowPV) << " " << nowPV->GetName() << "\n";
+    for (auto nowMaterial : *G4Material::GetMaterialTable()) {
+        bindings << "name material " << AddressOf(nowMaterial) << " " << nowMaterial->GetName()
+                 << "\n";
+        G4double birksConstant = nowMaterial->GetIonisation()->GetBirksConstant();
+        if (birksConstant != 0)
+            bindings << "birks " << AddressOf(nowMaterial) << " " << birksConstant << "\n";
+    }
+
+    std::map<G4String, G4LogicalVolume **> LVSlots;
+    std::map<G4String, G4VPhysicalVolume **> PVSlots;
+    std::map<G4String, G4int *> intSlots;
+    std::map<G4String, std::set<G4LogicalVolume *> *> LVSetSlots;
+    CollectGeometrySnapshotSlots(LVSlots, PVSlots, intSlots, LVSetSlots);
+    for (auto &nowSlot : LVSlots)
+        if (*nowSlot.second != nullptr)
+            bindings << "lv " << nowSlot.first << " " << AddressOf(*nowSlot.second) << "\n";
+    for (auto &nowSlot : PVSlots)
+        if (*nowSlot.second != nullptr)
+            bindings << "pv " << nowSlot.first << " " << AddressOf(*nowSlot.second) << "\n";
+    for (auto &nowSlot : intSlots)
+        bindings << "int " << nowSlot.first << " " << *nowSlot.second << "\n";
+    for (auto &nowSlot : LVSetSlots)
+        for (auto nowLV : *nowSlot.second)
+            bindings << "lvset " << nowSlot.first << " " << AddressOf(nowLV) << "\n";
+
+    for (auto &nowInfo : fModuleSDInfos) {
+        bindings << "module " << nowInfo.fModuleID << " " << nowInfo.fCrystalPosIdx[0] << " "
+                 << nowInfo.fCrystalPosIdx[1] << " " << AddressOf(nowInfo.fModulePV) << " "
+                 << AddressOf(nowInfo.fCrystalLV) << " " << AddressOf(nowInfo.fGeWaferLV) << " "
+                 << AddressOf(nowInfo.fCrystalGoldFilmLV) << " "
+                 << AddressOf(nowInfo.fGeWaferGoldFilmLV) << " " << nowInfo.fModuleName << "\n";
+    }
+
+    // Regions are not a part of GDML. They go before the PMT optical models which need them.
+    for (auto nowRegion : *G4RegionStore::GetInstance()) {
+        const G4String &regionName = nowRegion->GetName();
+        if (regionName == "DefaultRegionForTheWorld" ||
+            regionName == "DefaultRegionForParallelWorld")
+            continue;
+        G4ProductionCuts *nowCuts = nowRegion->GetProductionCuts();
+        bindings << "region " << (nowCuts != nullptr);
+        for (G4int i = 0; i < NumberOfG4CutIndex; i++)
+            bindings << " " << ((nowCuts != nullptr) ? nowCuts->GetProductionCut(i) : 0.);
+        bindings << " " << regionName << "\n";
+
+        auto rootLVIter = nowRegion->GetRootLogicalVolumeIterator();
+        for (size_t i = 0; i < nowRegion->GetNumberOfRootVolumes(); i++, rootLVIter++)
+            bindings << "regionroot " << AddressOf(*rootLVIter) << " " << regionName << "\n";
+    }
+    if (fI_DetectorModuleRegion != nullptr)
+        bindings << "regionslot fI_DetectorModuleRegion " << fI_DetectorModuleRegion->GetName()
+                 << "\n";
+    if (fI_crystalsRegion != nullptr)
+        bindings << "regionslot fI_crystalsRegion " << fI_crystalsRegion->GetName() << "\n";
+    for (auto &nowModel : fPMTOpticalModelPVs)
+        bindings << "pmtmodel " << AddressOf(nowModel.second) << " " << nowModel.first << "\n";
+
+    bindings.close();
+    std::ofstream((tempDir + "/" + kKeyFileName).c_str()) << fGeomSnapshotKey;
+    if (!bindings) {
+        G4Exception(__PRETTY_FUNCTION__, "GEOM_SNAPSHOT_STORE_FAIL", JustWarning,
+                    ("Writing the binding table to " + tempDir + " has been failed.").c_str());
+        fs::remove_all(tempDir, fsError);
+        return;
+    }
+
+    fs::rename(tempDir, fGeomSnapshotEntry, fsError);
+    if (fsError) {
+        // Another job has stored the same snapshot in the meantime
+        fs::remove_all(tempDir, fsError);
+        return;
+    }
+    G4cout << "Geometry snapshot: the world has been stored to " << fGeomSnapshotEntry << G4endl;
+#endif
+}
@@ -9,7 +9,14 @@
 
 #if G4VERSION_NUMBER >= 1000
 #include "AmoreSim/AmoreActionInitialization.hh"
+#include "AmoreSim/AmoreWorkerRunManager.hh"
 #include "G4MTRunManager.hh"
+#if G4VERSION_NUMBER >= 1070
+#include "G4RunManagerFactory.hh"
+#ifdef G4MULTITHREADED
+#include "G4TaskRunManager.hh"
+#endif
+#endif
 #else
 #include "CupSim/CupPhysicsList.hh"
 #endif
@@ -21,6 +28,7 @@
 #include "G4UIterminal.hh"
 #include "G4VisExecutive.hh"
 
+#include "AmoreSim/AmoreCampaignMessenger.hh"
 #include "AmoreSim/AmoreDetectorConstruction.hh"
 #include "AmoreSim/AmoreSimGitRevision.hh"
 #include "AmoreSim/AmoreSteppingAction.hh"
@@ -40,11 +48,19 @@
 #include "G4VisExecutive.hh"
 #endif
 #include "G4Run.hh"
+#include "G4Threading.hh"
 #include <cstdlib>
+#include <vector>
 
 #include "AmoreSim/AmoreEventAction.hh"
+#include "AmoreSim/AmoreForkRunManager.hh"
 #include "AmoreSim/AmorePLManager.hh"
 #include "AmoreSim/AmoreRootNtuple.hh"
+#include "AmoreSim/AmoreLog.hh"
+#include "AmoreSim/AmoreOutputFlusher.hh"
+#include "AmoreSim/AmoreRunMessenger.hh"
+#include "AmoreSim/AmoreStartupProfiler.hh"
+#include "AmoreSim/AmoreSubEventManager.hh"
 #include "CupSim/CupRecorderBase.hh"
 #include "CupSim/CupRunAction.hh"
 #include "CupSim/CupSimGitRevision.hh"
@@ -55,8 +71,40 @@
 using namespace std;
 
 int main(int argc, char **argv) {
+    // The startup stages are timed from here and reported in <output>_startup.json
+    AmoreStartupProfiler::GetInstance();
     ROOT::EnableThreadSafety();
 
+    // The number of worker threads is taken from "-t N" (or "--threads N") on the command line,
+    // then from the AMORESIM_NTHREADS environment variable. N = 0 uses every core of the node.
+    // /run/numberOfThreads in a macro before /run/initialize overrides both of them.
+    // The run manager backend is chosen by "--runmanager serial|mt|tasking" or by the
+    // AMORESIM_RUNMANAGER environment variable. The tasking backend pulls events from a shared
+    // task queue with work stealing, which suits runs with very different event costs.
+    G4int nThreads = 1;
+    if (getenv("AMORESIM_NTHREADS") != NULL) nThreads = atoi(getenv("AMORESIM_NTHREADS"));
+    G4String rmTypeName = "mt";
+    if (getenv("AMORESIM_RUNMANAGER") != NULL) rmTypeName = getenv("AMORESIM_RUNMANAGER");
+    // "--fork N" (or AMORESIM_NFORKS) runs N processes instead of threads: see
+    // AmoreForkRunManager. It is only used for batch jobs and replaces the options above.
+    G4int nForks = 0;
+    if (getenv("AMORESIM_NFORKS") != NULL) nForks = atoi(getenv("AMORESIM_NFORKS"));
+
+    std::vector<char *> restArgs(argv, argv + 1);
+    for (int iarg = 1; iarg < argc; iarg++) {
+        if ((strcmp(argv[iarg], "-t") == 0 || strcmp(argv[iarg], "--threads") == 0) &&
+            iarg + 1 < argc) {
+            nThreads = atoi(argv[++iarg]);
+        } else if (strcmp(argv[iarg], "--runmanager") == 0 && iarg + 1 < argc) {
+            rmTypeName = argv[++iarg];
+        } else if (strcmp(argv[iarg], "--fork") == 0 && iarg + 1 < argc) {
+            nForks = atoi(argv[++iarg]);
+        } else
+            restArgs.push_back(argv[iarg]);
+    }
+    argc = restArgs.size();
+    argv = restArgs.data();
+
     cout << "Version information for amoresim:" << endl;
     cout << "AmoreSim executable: "
          << " <Branch: " << TOSTRING(AmoreSim_GIT_BRANCH)
@@ -67,28 +115,67 @@ int main(int argc, char **argv) {
     cout << endl;
     if (argc == 2 && strcmp(argv[1], "git") == 0) return 0;
 
-        // Run manager
-#ifdef G4MULTITHREADED
-    G4MTRunManager *theRunManager = new G4MTRunManager;
-    theRunManager->SetNumberOfThreads(1);
+    // Run manager
+    G4bool isInteractive =
+        argc == 1 || strcmp(argv[1], "gui.mac") == 0 || strcmp(argv[1], "gui") == 0;
+    if (nForks > 1 && isInteractive) {
+        G4cout << "The fork mode needs a batch macro. Running without forking." << G4endl;
+        nForks = 0;
+    }
+    G4RunManager *theRunManager            = nullptr;
+    AmoreForkRunManager *theForkRunManager = nullptr;
+    if (nForks > 1) {
+        // Each child process is a sequential run manager
+        theRunManager = theForkRunManager = new AmoreForkRunManager(nForks);
+    } else {
+#if G4VERSION_NUMBER >= 1070
+        G4RunManagerType rmType = G4RunManagerType::MT;
+        if (rmTypeName == "serial")
+            rmType = G4RunManagerType::Serial;
+        else if (rmTypeName == "tasking")
+            rmType = G4RunManagerType::Tasking;
+        else if (rmTypeName != "mt")
+            G4cout << "Unknown run manager type \"" << rmTypeName << "\". Using the MT backend."
+                   << G4endl;
+        // Falls back to the sequential run manager if Geant4 has been built without MT
+        theRunManager = G4RunManagerFactory::CreateRunManager(
+            rmType, static_cast<G4VUserTaskQueue *>(nullptr), false);
+        if (nThreads <= 0) nThreads = G4Threading::G4GetNumberOfCores();
+        theRunManager->SetNumberOfThreads(nThreads);
+#elif defined(G4MULTITHREADED)
+        G4MTRunManager *theMTRunManager = new G4MTRunManager;
+        if (nThreads <= 0) nThreads = G4Threading::G4GetNumberOfCores();
+        theMTRunManager->SetNumberOfThreads(nThreads);
+        theRunManager = theMTRunManager;
 #else
-    G4RunManager *theRunManager = new G4RunManager;
+        theRunManager = new G4RunManager;
+        if (nThreads != 1)
+            G4cout << "Geant4 was built without multi-threading. Running in sequential mode."
+                   << G4endl;
 #endif
+    }
 
     // -- database
     CupParam &db(CupParam::GetDB());
-    if (getenv("AmoreDATA") != NULL)
-        db.ReadFile((G4String(getenv("AmoreDATA")) + "/settings.dat").c_str());
-    else
-        db.ReadFile("data/settings.dat");
+    {
+        AmoreStartupProfiler::Scope nowScope("CupParam::ReadFile settings.dat");
+        if (getenv("AmoreDATA") != NULL)
+            db.ReadFile((G4String(getenv("AmoreDATA")) + "/settings.dat").c_str());
+        else
+            db.ReadFile("data/settings.dat");
+    }
 
     // UserInitialization classes
     AmoreDetectorConstruction *theAmoreDetectorConstruction = new AmoreDetectorConstruction;
     theRunManager->SetUserInitialization(theAmoreDetectorConstruction);
 
 #if G4VERSION_NUMBER >= 1000
-    AmorePLManager *thePLManager = new AmorePLManager();
-    thePLManager->BuildPhysicsList();
+    AmorePLManager *thePLManager;
+    {
+        AmoreStartupProfiler::Scope nowScope("BuildPhysicsList");
+        thePLManager = new AmorePLManager();
+        thePLManager->BuildPhysicsList();
+    }
     theRunManager->SetUserInitialization(thePLManager->GetPhysicsList());
 #else
     theRunManager->SetUserInitialization(new CupPhysicsList());
@@ -100,10 +187,27 @@ int main(int argc, char **argv) {
 
     // Create the AmoreRecorderBase object
     AmoreRootNtuple *myRecords = new AmoreRootNtuple; // EJ
+    if (theForkRunManager != nullptr) {
+        myRecords->SetForkParent(nForks);
+        theForkRunManager->SetRecorder(myRecords);
+    }
 
 #if G4VERSION_NUMBER >= 1000
     theRunManager->SetUserInitialization(
         new AmoreActionInitialization(myRecords, theAmoreDetectorConstruction));
+
+#ifdef G4MULTITHREADED
+    // Sub-events (/event/subEvent/) are processed by our own worker run manager, which is
+    // only available for the MT backend.
+    G4MTRunManager *theMTRunManager = dynamic_cast<G4MTRunManager *>(theRunManager);
+#if G4VERSION_NUMBER >= 1070
+    if (dynamic_cast<G4TaskRunManager *>(theRunManager) != nullptr) theMTRunManager = nullptr;
+#endif
+    if (theMTRunManager != nullptr) {
+        theMTRunManager->SetUserInitialization(new AmoreWorkerThreadInitialization);
+        AmoreSubEventManager::GetInstance()->SetWorkerSupport(true);
+    }
+#endif
 #else
     // UserAction classes
     CupPrimaryGeneratorAction *PGA = new CupPrimaryGeneratorAction(theAmoreDetectorConstruction);
@@ -120,6 +224,11 @@ int main(int argc, char **argv) {
 
     // an additional "messenger" class for user diagnostics
     CupDebugMessenger theDebugMessenger(theAmoreDetectorConstruction);
+    AmoreRunMessenger theRunMessenger(theRunManager);
+    AmoreCampaignMessenger theCampaignMessenger(myRecords);
+    AmoreSubEventManager::GetInstance(); // Creates the /event/subEvent/ commands
+    AmoreOutputFlusher::GetInstance();   // Creates the /ntuple/io/ commands
+    AmoreLog::GetInstance();             // Creates the /amore/log/ commands
 
     // Visualization, only if you choose to have it!
 #ifdef G4VIS_USE
@@ -162,10 +271,25 @@ int main(int argc, char **argv) {
     delete theVisMessenger;
 #endif
 
+    // In MT mode this also closes the files of the worker recorders. The worker recorders
+    // themselves are deleted together with the worker threads. The parent of the fork mode
+    // merges the files of its children here, so it has to wait for them first.
+    if (theForkRunManager != nullptr && !theForkRunManager->IsChild())
+        theForkRunManager->WaitForChildren();
     myRecords->CloseFile();
 
+    // A child of the fork mode has the startup of its parent, which writes the report
+    if ((theForkRunManager == nullptr || !theForkRunManager->IsChild()) &&
+        !myRecords->GetOutputBaseName().empty())
+        AmoreStartupProfiler::GetInstance()->WriteReport(myRecords->GetOutputBaseName() +
+                                                         "_startup.json");
+
     delete theRunManager;
     delete myRecords; // EJ
+    // The recorders close their files again when deleted, so these go last. The flusher waits
+    // for the flushes still in the background.
+    delete AmoreOutputFlusher::GetInstance();
+    delete AmoreLog::GetInstance();
 
     return 0;
 }
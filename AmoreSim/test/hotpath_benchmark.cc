@@ -0,0 +1,99 @@
+//
+// hotpath_benchmark.cc
+//
+// Micro-benchmark of the per-step checks of AmoreScintSD, AmoreModuleSD and
+// AmoreTrackingAction. It compares the old checks by name with the checks by pointer:
+//   particle: copy of the particle name compared with "opticalphoton" / definition pointer
+//   envelope: copy of the mother volume name searched for "Envelope" / set of envelope PVs
+// The particle definitions and volumes are modeled by structs holding their names, like
+// G4ParticleDefinition and G4VPhysicalVolume, so the benchmark needs neither Geant4 nor ROOT.
+// Built with -DAMORESIM_BUILD_BENCHMARKS=ON.
+//   amoresim_hotpath_benchmark [nSteps]
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    struct Definition {
+        std::string fName;
+    };
+    struct Volume {
+        std::string fName;
+    };
+
+    template <typename Check>
+    double NanosecondsPerStep(size_t aNSteps, long &aSink, Check aCheck) {
+        auto startTime = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < aNSteps; i++)
+            aSink += aCheck(i);
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - startTime;
+        return elapsed.count() / aNSteps;
+    }
+
+    void Report(const char *aName, double aByName, double aByPointer) {
+        std::printf("%-9s by name %6.2f ns/step, by pointer %6.2f ns/step, saved %6.2f ns/step\n",
+                    aName, aByName, aByPointer, aByName - aByPointer);
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t nSteps = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 20000000;
+
+    // Optical photons make most of the steps in the scintillators
+    std::vector<Definition> definitions = {{"opticalphoton"}, {"e-"},  {"gamma"},  {"e+"},
+                                           {"mu-"},           {"mu+"}, {"neutron"}, {"alpha"}};
+    const std::vector<double> weights   = {60, 20, 12, 2, 2, 2, 1, 1};
+    const Definition *opticalPhoton     = &definitions[0];
+
+    std::vector<Volume> volumes = {{"Envelope_MuonTopScintillator_PV"},
+                                   {"Envelope_MuonSideFBScintillator_PV"},
+                                   {"Envelope_MuonSideLRScintillator_PV"},
+                                   {"Envelope_MuonGroundScintillator_PV"},
+                                   {"Envelope_MuonMufflerFBScintillator_PV"},
+                                   {"Envelope_MuonMufflerLRScintillator_PV"},
+                                   {"InnerDetector_PV"},
+                                   {"LeadShield_PV"},
+                                   {"BoricAcidShield_PV"},
+                                   {"World"}};
+    std::unordered_set<const Volume *> envelopePVs;
+    for (auto &nowVolume : volumes)
+        if (std::strstr(nowVolume.fName.c_str(), "Envelope") != nullptr)
+            envelopePVs.insert(&nowVolume);
+
+    // The same sequence of steps for both checks
+    std::mt19937 engine(12345);
+    std::discrete_distribution<size_t> pickDefinition(weights.begin(), weights.end());
+    std::uniform_int_distribution<size_t> pickVolume(0, volumes.size() - 1);
+    std::vector<const Definition *> stepDefinitions(nSteps);
+    std::vector<const Volume *> stepMothers(nSteps);
+    for (size_t i = 0; i < nSteps; i++) {
+        stepDefinitions[i] = &definitions[pickDefinition(engine)];
+        stepMothers[i]     = &volumes[pickVolume(engine)];
+    }
+
+    long sink = 0;
+    double particleByName = NanosecondsPerStep(nSteps, sink, [&](size_t i) {
+        std::string particleName = stepDefinitions[i]->fName;
+        return particleName == "opticalphoton";
+    });
+    double particleByPointer = NanosecondsPerStep(
+        nSteps, sink, [&](size_t i) { return stepDefinitions[i] == opticalPhoton; });
+    double envelopeByName = NanosecondsPerStep(nSteps, sink, [&](size_t i) {
+        std::string motherVolName = stepMothers[i]->fName;
+        return std::strstr(motherVolName.c_str(), "Envelope") != nullptr;
+    });
+    double envelopeByPointer = NanosecondsPerStep(
+        nSteps, sink, [&](size_t i) { return envelopePVs.count(stepMothers[i]) > 0; });
+
+    std::printf("%zu steps (checksum %ld)\n", nSteps, sink);
+    Report("particle", particleByName, particleByPointer);
+    Report("envelope", envelopeByName, envelopeByPointer);
+    return 0;
+}